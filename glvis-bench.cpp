@@ -0,0 +1,876 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+
+// GLVis benchmark - times the preparation and drawing of the GLVis scenes on
+// synthetic meshes
+//
+// For every combination of mesh type, mesh size, solution order and field type
+// (scalar or vector) a scene is created in its own window, all of its layers
+// are shown and then rebuilt and drawn a few times. The report has one line
+// per timed stage, in a fixed order, so the reports of two builds can be
+// compared with diff. The option -nt leaves out the times and the memory,
+// which then gives an exact comparison of the number of drawn triangles. With
+// -sw the frames are drawn by the software renderer, whose capture and
+// rasterization stages are then reported too.
+//
+// A window is needed; on a machine without a display run the benchmark under
+// a virtual X server, e.g. "xvfb-run ./glvis-bench".
+//
+// With the option -si, the socket ingest of a running GLVis server is timed
+// instead: threads imitating the ranks of a parallel application send a
+// sequence of solutions, see IngestBenchmark().
+
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mfem.hpp"
+#include "lib/visual.hpp"
+
+using namespace std;
+using namespace mfem;
+
+// Required by libglvis, see glvis.cpp
+string plot_caption;
+string extra_caption;
+GeometryRefiner GLVisGeometryRefiner;
+
+// Used only by the input stream threads, which are not started here
+void Extrude1DMeshAndSolution(Mesh **, GridFunction **, Vector *) { }
+void SetMeshSolution(Mesh *, GridFunction *&, bool) { }
+
+extern VisualizationScene *locscene; // defined in aux_vis.cpp
+
+const char *string_none = "(none)";
+
+// Global variables for command line arguments
+const char *mesh_file   = string_none;
+const char *case_filter = string_none;
+int         levels      = 3;
+int         max_order   = 2;
+int         repeat      = 5;
+bool        timings     = true;
+int         window_w    = 800;
+int         window_h    = 600;
+bool        soft_render = false;
+bool        ingest      = false;
+int         num_procs   = 4;
+int         portnum     = 19916;
+int         ing_size    = 32;
+int         ing_order   = 2;
+int         ing_dim     = 2;
+int         ing_updates = 100;
+double      ing_rate    = 0.0;
+int         ing_digits  = 8;
+int         ing_sync    = 1;
+
+struct MeshKind
+{
+   const char *name;
+   int dim;
+   Element::Type type;
+   bool curved;
+};
+
+const MeshKind mesh_kinds[] =
+{
+   { "quad",        2, Element::QUADRILATERAL, false },
+   { "tri",         2, Element::TRIANGLE,      false },
+   { "quad-curved", 2, Element::QUADRILATERAL, true  },
+   { "tet",         3, Element::TETRAHEDRON,   false },
+   { "hex",         3, Element::HEXAHEDRON,    false },
+   { "wedge",       3, Element::WEDGE,         false },
+   { "hex-curved",  3, Element::HEXAHEDRON,    true  }
+};
+const int num_mesh_kinds = sizeof(mesh_kinds)/sizeof(mesh_kinds[0]);
+
+// number of elements per side of the smallest 2D and 3D meshes
+const int base_size[4] = { 0, 0, 16, 4 };
+
+// One line of the report
+struct Row
+{
+   string name, stage;
+   double time;       // seconds, negative if not measured
+   long   triangles;  // negative if not counted
+   double mbytes;     // negative if not measured
+};
+
+vector<Row> report;
+
+void AddRow(const string &name, const string &stage, double time,
+            long triangles = -1, double mbytes = -1.0)
+{
+   Row row = { name, stage, time, triangles, mbytes };
+   report.push_back(row);
+}
+
+// The resident memory of the process in MB, 0 if not available
+double ResidentMB()
+{
+   FILE *statm = fopen("/proc/self/statm", "r");
+   long size, resident;
+   int n = statm ? fscanf(statm, "%ld %ld", &size, &resident) : 0;
+   if (statm) { fclose(statm); }
+   return (n == 2) ? resident*double(sysconf(_SC_PAGESIZE))/(1024*1024) : 0.0;
+}
+
+// A smooth distortion of the unit square/cube, for the curved meshes
+void Bend(const Vector &x, Vector &y)
+{
+   const int dim = x.Size();
+   y = x;
+   for (int d = 0; d < dim; d++)
+   {
+      y(d) += 0.1*sin(2.0*M_PI*x((d+1)%dim));
+   }
+}
+
+double ScalarFunction(const Vector &x)
+{
+   double s = 0.0;
+   for (int d = 0; d < x.Size(); d++)
+   {
+      s += sin(M_PI*(d+2)*x(d));
+   }
+   return s;
+}
+
+void VectorFunction(const Vector &x, Vector &v)
+{
+   const int dim = x.Size();
+   for (int d = 0; d < dim; d++)
+   {
+      v(d) = cos(M_PI*(d+2)*x((d+1)%dim));
+   }
+}
+
+// MFEM has no Cartesian constructor for wedges: split each cell of an n x n x n
+// grid in the unit cube into two wedges.
+Mesh *MakeWedgeMesh(int n)
+{
+   const int n1 = n+1;
+   Mesh *mesh = new Mesh(3, n1*n1*n1, 2*n*n*n, 8*n*n, 3);
+
+   for (int k = 0; k <= n; k++)
+      for (int j = 0; j <= n; j++)
+         for (int i = 0; i <= n; i++)
+         {
+            double v[3] = { double(i)/n, double(j)/n, double(k)/n };
+            mesh->AddVertex(v);
+         }
+
+#define VTX(i, j, k) ((i) + n1*((j) + n1*(k)))
+   for (int k = 0; k < n; k++)
+      for (int j = 0; j < n; j++)
+         for (int i = 0; i < n; i++)
+         {
+            const int a = VTX(i,j,k), b = VTX(i+1,j,k);
+            const int c = VTX(i+1,j+1,k), d = VTX(i,j+1,k);
+            const int s = n1*n1;
+            const int w1[6] = { a, b, c, a+s, b+s, c+s };
+            const int w2[6] = { a, c, d, a+s, c+s, d+s };
+            mesh->AddWedge(w1);
+            mesh->AddWedge(w2);
+         }
+
+   // the boundary attributes follow the numbering of the hex mesh faces
+   for (int j = 0; j < n; j++)
+      for (int i = 0; i < n; i++)
+      {
+         int t[4][3] =
+         {
+            { VTX(i,j,0), VTX(i+1,j+1,0), VTX(i+1,j,0) },
+            { VTX(i,j,0), VTX(i,j+1,0), VTX(i+1,j+1,0) },
+            { VTX(i,j,n), VTX(i+1,j,n), VTX(i+1,j+1,n) },
+            { VTX(i,j,n), VTX(i+1,j+1,n), VTX(i,j+1,n) }
+         };
+         mesh->AddBdrTriangle(t[0], 1);
+         mesh->AddBdrTriangle(t[1], 1);
+         mesh->AddBdrTriangle(t[2], 6);
+         mesh->AddBdrTriangle(t[3], 6);
+
+         // (i,j) runs over the sides as (x or y, z)
+         int q[4][4] =
+         {
+            { VTX(i,0,j), VTX(i+1,0,j), VTX(i+1,0,j+1), VTX(i,0,j+1) },
+            { VTX(n,i,j), VTX(n,i+1,j), VTX(n,i+1,j+1), VTX(n,i,j+1) },
+            { VTX(i,n,j), VTX(i,n,j+1), VTX(i+1,n,j+1), VTX(i+1,n,j) },
+            { VTX(0,i,j), VTX(0,i,j+1), VTX(0,i+1,j+1), VTX(0,i+1,j) }
+         };
+         for (int f = 0; f < 4; f++)
+         {
+            mesh->AddBdrQuad(q[f], f+2);
+         }
+      }
+#undef VTX
+
+   mesh->FinalizeTopology();
+   mesh->Finalize(false, true);
+   return mesh;
+}
+
+Mesh *MakeMesh(const MeshKind &kind, int n, int order)
+{
+   Mesh *mesh;
+   if (kind.dim == 2)
+   {
+      mesh = new Mesh(n, n, kind.type, 1);
+   }
+   else if (kind.type == Element::WEDGE)
+   {
+      mesh = MakeWedgeMesh(n);
+   }
+   else
+   {
+      mesh = new Mesh(n, n, n, kind.type, 1);
+   }
+   if (kind.curved)
+   {
+      mesh->SetCurvature(std::max(order, 2));
+      mesh->Transform(Bend);
+   }
+   return mesh;
+}
+
+// The number of triangles drawn in a frame of the current scene, counted in
+// the feedback mode of OpenGL, i.e. after clipping. Returns -1 if the frame
+// is too large to count.
+long CountTriangles()
+{
+   for (GLint size = 1 << 20; size <= (1 << 27); size *= 4)
+   {
+      vector<GLfloat> buffer(size);
+      glFeedbackBuffer(size, GL_2D, &buffer[0]);
+      glRenderMode(GL_FEEDBACK);
+      locscene->Draw(); // MyExpose() may capture in feedback mode itself
+      const GLint n = glRenderMode(GL_RENDER);
+      if (n < 0)
+      {
+         continue; // overflow
+      }
+      long triangles = 0;
+      for (GLint i = 0; i < n; )
+      {
+         const GLint token = GLint(buffer[i]);
+         if (token == GL_POLYGON_TOKEN)
+         {
+            const GLint nv = GLint(buffer[i+1]);
+            triangles += nv - 2;
+            i += 2 + 2*nv;
+         }
+         else if (token == GL_POINT_TOKEN || token == GL_BITMAP_TOKEN ||
+                  token == GL_DRAW_PIXEL_TOKEN ||
+                  token == GL_COPY_PIXEL_TOKEN)
+         {
+            i += 3;
+         }
+         else if (token == GL_LINE_TOKEN || token == GL_LINE_RESET_TOKEN)
+         {
+            i += 5;
+         }
+         else // GL_PASS_THROUGH_TOKEN
+         {
+            i += 2;
+         }
+      }
+      return triangles;
+   }
+   return -1;
+}
+
+// The stages timed for each type of scene; the layers are marked dirty with
+// the public Prepare methods and rebuilt by the next Draw().
+const char *stages_2d[] =
+{ "Solution::Prepare", "Solution::PrepareLines", NULL };
+const char *stages_2d_vec[] =
+{
+   "Solution::Prepare", "Solution::PrepareLines",
+   "Vector::PrepareVectorField", NULL
+};
+const char *stages_3d[] =
+{
+   "Solution3d::Prepare", "Solution3d::PrepareLines",
+   "Solution3d::PrepareLevelSurf", "Solution3d::CuttingPlaneFunc", NULL
+};
+const char *stages_3d_vec[] =
+{
+   "Vector3d::Prepare", "Vector3d::PrepareLines",
+   "Vector3d::PrepareVectorField", NULL
+};
+
+void DirtyLayers(VisualizationSceneScalarData *vs, int dim, bool vector)
+{
+   vs->Prepare();
+   vs->PrepareLines();
+   if (dim == 2 && vector)
+   {
+      ((VisualizationSceneVector *)vs)->PrepareVectorField();
+   }
+   else if (dim == 3 && vector)
+   {
+      ((VisualizationSceneVector3d *)vs)->PrepareVectorField();
+   }
+   else if (dim == 3)
+   {
+      VisualizationSceneSolution3d *vss = (VisualizationSceneSolution3d *)vs;
+      vss->PrepareLevelSurf();
+      vss->PrepareCuttingPlane();
+   }
+}
+
+// Benchmark the scalar or the vector field of the given order on 'mesh'.
+void RunCase(const string &name, Mesh *mesh, int order, bool vector)
+{
+   const int dim = mesh->Dimension();
+   const double mem0 = ResidentMB();
+
+   if (InitVisualization(name.c_str(), 0, 0, window_w, window_h))
+   {
+      cerr << "Initializing the visualization failed." << endl;
+      return;
+   }
+
+   H1_FECollection fec(order, dim);
+   FiniteElementSpace fes(mesh, &fec, vector ? dim : 1);
+   GridFunction gf(&fes);
+   Vector sol;
+   if (vector)
+   {
+      VectorFunctionCoefficient coeff(dim, VectorFunction);
+      gf.ProjectCoefficient(coeff);
+   }
+   else
+   {
+      FunctionCoefficient coeff(ScalarFunction);
+      gf.ProjectCoefficient(coeff);
+      gf.GetNodalValues(sol);
+   }
+
+   // create the scene as glvis does and show all of the timed layers
+   const double t0 = ProfilerTime();
+   VisualizationSceneScalarData *vs;
+   const char **stages;
+   if (dim == 2 && !vector)
+   {
+      VisualizationSceneSolution *vss =
+         new VisualizationSceneSolution(*mesh, sol);
+      vss->SetGridFunction(gf);
+      vss->ToggleDrawMesh();
+      vs = vss;
+      stages = stages_2d;
+   }
+   else if (dim == 2)
+   {
+      VisualizationSceneVector *vsv = new VisualizationSceneVector(gf);
+      vsv->ToggleDrawMesh();
+      vsv->ToggleVectorField();
+      vs = vsv;
+      stages = stages_2d_vec;
+   }
+   else if (!vector)
+   {
+      VisualizationSceneSolution3d *vss =
+         new VisualizationSceneSolution3d(*mesh, sol);
+      vss->SetGridFunction(&gf);
+      vss->ToggleDrawMesh();
+      vss->MoveLevelSurf(1);
+      vss->ToggleCuttingPlane();
+      vss->ToggleCPAlgorithm(); // use CuttingPlaneFunc()
+      vs = vss;
+      stages = stages_3d;
+   }
+   else
+   {
+      VisualizationSceneVector3d *vsv = new VisualizationSceneVector3d(gf);
+      vsv->ToggleDrawMesh();
+      vsv->ToggleVectorField(1);
+      vs = vsv;
+      stages = stages_3d_vec;
+   }
+   vs->AutoRefine();
+   vs->SetShading(2, true);
+
+   locscene = vs;
+   vs->view = 3;
+   vs->CenterObject();
+
+   // the first frame, including the refined values computed in the background
+   MyExpose();
+   if (vs->FinishPrepare())
+   {
+      MyExpose();
+   }
+   glFinish();
+   AddRow(name, "setup", ProfilerTime() - t0, -1, ResidentMB() - mem0);
+
+   ProfilerReset();
+   for (int r = 0; r < repeat; r++)
+   {
+      DirtyLayers(vs, dim, vector);
+      MyExpose();
+      glFinish();
+   }
+   for (int s = 0; stages[s]; s++)
+   {
+      double total;
+      int count = ProfilerGetStage(stages[s], &total);
+      AddRow(name, stages[s], count ? total/count : -1.0);
+   }
+
+   const double t1 = ProfilerTime();
+   for (int r = 0; r < repeat; r++)
+   {
+      MyExpose();
+      glFinish();
+   }
+   const double frame = (ProfilerTime() - t1)/repeat;
+   AddRow(name, "frame", frame, CountTriangles());
+   if (soft_render)
+   {
+      // per frame: lit scenes are captured twice
+      double capture, raster;
+      ProfilerGetStage("SoftwareRender::Capture", &capture);
+      int frames = ProfilerGetStage("SoftwareRender::Rasterize", &raster);
+      AddRow(name, "SoftwareRender::Capture", frames ? capture/frames : -1.0);
+      AddRow(name, "SoftwareRender::Rasterize", frames ? raster/frames : -1.0);
+   }
+
+   KillVisualization(); // deletes vs
+   locscene = NULL;
+}
+
+void PrintReport(ostream &out)
+{
+   size_t nw = 4, sw = 5;
+   for (size_t i = 0; i < report.size(); i++)
+   {
+      nw = std::max(nw, report[i].name.size());
+      sw = std::max(sw, report[i].stage.size());
+   }
+   out << left << setw(nw) << "case" << "  " << setw(sw) << "stage" << right
+       << setw(12) << "time_ms" << setw(12) << "triangles" << setw(10)
+       << "Mtri/s" << setw(10) << "MB" << '\n' << fixed;
+   for (size_t i = 0; i < report.size(); i++)
+   {
+      const Row &row = report[i];
+      out << left << setw(nw) << row.name << "  " << setw(sw) << row.stage
+          << right << setprecision(3) << setw(12);
+      if (timings && row.time >= 0.0) { out << 1e3*row.time; }
+      else { out << '-'; }
+      out << setw(12);
+      if (row.triangles >= 0) { out << row.triangles; }
+      else { out << '-'; }
+      out << setprecision(2) << setw(10);
+      if (timings && row.triangles >= 0 && row.time > 0.0)
+      {
+         out << 1e-6*row.triangles/row.time;
+      }
+      else { out << '-'; }
+      out << setprecision(1) << setw(10);
+      if (timings && row.mbytes >= 0.0) { out << row.mbytes; }
+      else { out << '-'; }
+      out << '\n';
+   }
+   out << flush;
+}
+
+// The time dependent solution sent by the ingest benchmark
+double IngestFunction(const Vector &x, double t)
+{
+   double s = 0.0;
+   for (int d = 0; d < x.Size(); d++)
+   {
+      s += sin(M_PI*(d+2)*(x(d) - t));
+   }
+   return s;
+}
+
+// Stops the sender threads until all of them have reached it
+class Barrier
+{
+private:
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int size, count, generation;
+
+public:
+   Barrier(int n) : size(n), count(0), generation(0)
+   {
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond, NULL);
+   }
+
+   void Wait()
+   {
+      pthread_mutex_lock(&mutex);
+      const int gen = generation;
+      if (++count == size)
+      {
+         count = 0;
+         generation++;
+         pthread_cond_broadcast(&cond);
+      }
+      while (gen == generation)
+      {
+         pthread_cond_wait(&cond, &mutex);
+      }
+      pthread_mutex_unlock(&mutex);
+   }
+
+   ~Barrier()
+   {
+      pthread_cond_destroy(&cond);
+      pthread_mutex_destroy(&mutex);
+   }
+};
+
+// State shared by the sender threads; 'latency', 'dropped', 'start' and 'end'
+// are written by rank 0 only.
+struct IngestData
+{
+   Barrier *barrier;
+   Array<socketstream *> socks;
+   Array<long> bytes; // per rank
+   vector<double> latency;
+   int dropped;
+   double start, end;
+   bool failed;
+};
+
+struct IngestRank
+{
+   IngestData *data;
+   int rank;
+};
+
+// Sends the updates of one rank: its piece of the domain is the unit square
+// or cube shifted by 'rank' in x. Every update is preceded by a barrier, so
+// all ranks start sending at the same time. After every ing_sync-th update
+// the ranks send "sync" and rank 0 waits for the reply of the server.
+void *IngestThread(void *arg)
+{
+   IngestData &data = *((IngestRank *)arg)->data;
+   const int rank = ((IngestRank *)arg)->rank;
+   socketstream &sock = *data.socks[rank];
+
+   Mesh *mesh = (ing_dim == 2) ?
+                new Mesh(ing_size, ing_size, Element::QUADRILATERAL, 1) :
+                new Mesh(ing_size, ing_size, ing_size, Element::HEXAHEDRON, 1);
+   for (int i = 0; i < mesh->GetNV(); i++)
+   {
+      mesh->GetVertex(i)[0] += rank;
+   }
+   H1_FECollection fec(ing_order, ing_dim);
+   FiniteElementSpace fes(mesh, &fec);
+   GridFunction gf(&fes);
+   FunctionCoefficient coeff(IngestFunction);
+
+   ostringstream mesh_text;
+   mesh_text.precision(ing_digits);
+   mesh->Print(mesh_text);
+   const string mesh_str = mesh_text.str();
+
+   for (int u = 0; u < ing_updates; u++)
+   {
+      // format the update before the timing starts
+      coeff.SetTime(0.01*u);
+      gf.ProjectCoefficient(coeff);
+      ostringstream msg;
+      msg.precision(ing_digits);
+      msg << "parallel " << num_procs << ' ' << rank << '\n'
+          << "solution\n" << mesh_str;
+      gf.Save(msg);
+      const bool sync = ((u+1) % ing_sync == 0 || u+1 == ing_updates);
+      if (sync)
+      {
+         msg << "sync\n";
+      }
+      const string text = msg.str();
+
+      if (rank == 0 && u > 0 && ing_rate > 0.0)
+      {
+         const double wait = data.start + u/ing_rate - ProfilerTime();
+         if (wait > 0.0)
+         {
+            usleep((useconds_t)(1e6*wait));
+         }
+      }
+      data.barrier->Wait();
+      if (data.failed)
+      {
+         break;
+      }
+      const double t_send = ProfilerTime();
+      if (u == 0 && rank == 0)
+      {
+         data.start = t_send;
+      }
+
+      sock.write(text.data(), text.size());
+      sock.flush();
+      data.bytes[rank] += text.size();
+
+      if (rank == 0 && sync)
+      {
+         string word;
+         int dropped;
+         sock >> word >> dropped;
+         if (!sock || word != "sync")
+         {
+            cout << "No reply to the sync command from the server." << endl;
+            data.failed = true;
+         }
+         else
+         {
+            data.end = ProfilerTime();
+            data.latency.push_back(data.end - t_send);
+            data.dropped = dropped;
+         }
+      }
+   }
+
+   delete mesh;
+   return NULL;
+}
+
+// Time the ingest of the GLVis server listening on 'portnum' at localhost:
+// end-to-end latency from the start of sending an update to the reply of the
+// "sync" command, i.e. after the frame showing it was drawn, and the sustained
+// number of updates per second.
+int IngestBenchmark()
+{
+   IngestData data;
+   data.dropped = 0;
+   data.start = data.end = 0.0;
+   data.failed = false;
+   data.bytes.SetSize(num_procs);
+   data.bytes = 0;
+
+   // the server assembles the ranks in the order of their connections
+   for (int p = 0; p < num_procs; p++)
+   {
+      socketstream *sock = new socketstream("localhost", portnum);
+      if (!sock->is_open())
+      {
+         cout << "Can not connect to localhost:" << portnum << endl;
+         delete sock;
+         for (int i = 0; i < data.socks.Size(); i++) { delete data.socks[i]; }
+         return 2;
+      }
+      data.socks.Append(sock);
+   }
+
+   Barrier barrier(num_procs);
+   data.barrier = &barrier;
+   vector<IngestRank> ranks(num_procs);
+   vector<pthread_t> threads(num_procs);
+   for (int p = 0; p < num_procs; p++)
+   {
+      ranks[p].data = &data;
+      ranks[p].rank = p;
+      pthread_create(&threads[p], NULL, IngestThread, &ranks[p]);
+   }
+   for (int p = 0; p < num_procs; p++)
+   {
+      pthread_join(threads[p], NULL);
+   }
+   for (int p = 0; p < num_procs; p++)
+   {
+      data.socks[p]->close();
+      delete data.socks[p];
+   }
+   if (data.failed || data.latency.empty())
+   {
+      return 3;
+   }
+
+   long bytes = 0;
+   for (int p = 0; p < num_procs; p++)
+   {
+      bytes += data.bytes[p];
+   }
+   const double elapsed = data.end - data.start;
+   vector<double> &lat = data.latency;
+   sort(lat.begin(), lat.end());
+   double avg = 0.0;
+   for (size_t i = 0; i < lat.size(); i++)
+   {
+      avg += lat[i]/lat.size();
+   }
+
+   cout << fixed << setprecision(3)
+        << "ranks          " << num_procs << '\n'
+        << "mesh           " << ing_dim << "D, " << ing_size << "^" << ing_dim
+        << " elements of order " << ing_order << " per rank, " << ing_digits
+        << " digits\n"
+        << "bytes/update   " << bytes/ing_updates << '\n'
+        << "updates        " << ing_updates << " in " << elapsed << " s\n"
+        << "updates/s      " << ing_updates/elapsed << '\n'
+        << "MB/s           " << bytes/elapsed/(1024*1024) << '\n'
+        << "dropped        " << data.dropped << '\n'
+        << "latency_ms     min " << 1e3*lat[0] << ", avg " << 1e3*avg
+        << ", p50 " << 1e3*lat[lat.size()/2]
+        << ", p95 " << 1e3*lat[(95*lat.size())/100]
+        << ", max " << 1e3*lat.back() << " (" << lat.size() << " samples)"
+        << endl;
+   return 0;
+}
+
+bool Selected(const string &name)
+{
+   return (case_filter == string_none ||
+           name.find(case_filter) != string::npos);
+}
+
+int main (int argc, char *argv[])
+{
+   OptionsParser args(argc, argv);
+
+   args.AddOption(&mesh_file, "-m", "--mesh",
+                  "Benchmark also this mesh file.");
+   args.AddOption(&levels, "-l", "--levels",
+                  "Number of mesh sizes, each one refined twice in every"
+                  " direction.");
+   args.AddOption(&max_order, "-o", "--max-order",
+                  "Benchmark the solutions of orders 1 to this order.");
+   args.AddOption(&repeat, "-r", "--repeat",
+                  "Number of times each stage is timed.");
+   args.AddOption(&case_filter, "-c", "--cases",
+                  "Run only the cases whose names contain this string,"
+                  " e.g. 'hex' or '-p2-vector'.");
+   args.AddOption(&timings, "-t", "--timings",
+                  "-nt", "--no-timings",
+                  "Report the times and the memory, or only the drawn"
+                  " triangles.");
+   args.AddOption(&window_w, "-ww", "--window-width",
+                  "Set the window width.");
+   args.AddOption(&window_h, "-wh", "--window-height",
+                  "Set the window height.");
+   args.AddOption(&soft_render, "-sw", "--software-render",
+                  "-no-sw", "--no-software-render",
+                  "Draw the frames with the built-in software renderer.");
+   args.AddOption(&ingest, "-si", "--socket-ingest",
+                  "-no-si", "--no-socket-ingest",
+                  "Time the socket ingest of a running GLVis server instead"
+                  " of the scenes.");
+   args.AddOption(&num_procs, "-np", "--num-proc",
+                  "Ingest: number of sender ranks (connections).");
+   args.AddOption(&portnum, "-p", "--port",
+                  "Ingest: port of the GLVis server.");
+   args.AddOption(&ing_size, "-is", "--ingest-size",
+                  "Ingest: number of elements per side of each rank's mesh.");
+   args.AddOption(&ing_order, "-io", "--ingest-order",
+                  "Ingest: order of the solution.");
+   args.AddOption(&ing_dim, "-id", "--ingest-dim",
+                  "Ingest: dimension of the mesh, 2 or 3.");
+   args.AddOption(&ing_updates, "-iu", "--ingest-updates",
+                  "Ingest: number of solution updates to send.");
+   args.AddOption(&ing_rate, "-ir", "--ingest-rate",
+                  "Ingest: updates per second (0 = as fast as possible).");
+   args.AddOption(&ing_digits, "-idg", "--ingest-digits",
+                  "Ingest: number of digits of the numbers sent.");
+   args.AddOption(&ing_sync, "-isy", "--ingest-sync",
+                  "Ingest: wait for the server to draw every n-th update;"
+                  " the updates in between are pipelined.");
+   args.Parse();
+   if (!args.Good())
+   {
+      if (!args.Help())
+      {
+         args.PrintError(cout);
+         cout << endl;
+      }
+      args.PrintHelp(cout);
+      return 1;
+   }
+   if (repeat < 1)
+   {
+      repeat = 1;
+   }
+   if (ingest)
+   {
+      if (num_procs < 1 || ing_updates < 1 || ing_sync < 1 ||
+          (ing_dim != 2 && ing_dim != 3))
+      {
+         cout << "Invalid ingest options." << endl;
+         return 1;
+      }
+      return IngestBenchmark();
+   }
+
+   tkSetFrameRate(0.0);
+   SetSoftwareRendering(soft_render);
+
+   for (int k = 0; k < num_mesh_kinds; k++)
+   {
+      const MeshKind &kind = mesh_kinds[k];
+      for (int l = 0; l < levels; l++)
+      {
+         const int n = base_size[kind.dim] << l;
+         for (int order = 1; order <= max_order; order++)
+         {
+            for (int vector = 0; vector < 2; vector++)
+            {
+               ostringstream name;
+               name << kind.name << "-n" << n << "-p" << order
+                    << (vector ? "-vector" : "-scalar");
+               if (!Selected(name.str())) { continue; }
+
+               Mesh *mesh = MakeMesh(kind, n, order);
+               RunCase(name.str(), mesh, order, vector);
+               delete mesh;
+            }
+         }
+      }
+   }
+
+   if (mesh_file != string_none)
+   {
+      Mesh *mesh = new Mesh(mesh_file, 1, 1);
+      if (mesh->Dimension() < 2 ||
+          mesh->Dimension() != mesh->SpaceDimension())
+      {
+         cout << "Can not benchmark mesh file: " << mesh_file << endl;
+      }
+      else
+      {
+         for (int order = 1; order <= max_order; order++)
+         {
+            for (int vector = 0; vector < 2; vector++)
+            {
+               ostringstream name;
+               name << "file-p" << order << (vector ? "-vector" : "-scalar");
+               if (Selected(name.str()))
+               {
+                  RunCase(name.str(), mesh, order, vector);
+               }
+            }
+         }
+      }
+      delete mesh;
+   }
+
+   cout << endl;
+   PrintReport(cout);
+   return 0;
+}
@@ -16,6 +16,7 @@
 #include <limits>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <cstdio>
 #include <cstring>
@@ -46,6 +47,7 @@ int         gf_component    = -1;
 bool        fix_elem_orient = false;
 bool        save_coloring   = false;
 bool        keep_attr       = false;
+bool        coalesce        = false;
 int         window_x        = 0; // not a command line option
 int         window_y        = 0; // not a command line option
 int         window_w        = 400;
@@ -74,6 +76,10 @@ int scr_running = 0;
 int scr_level = 0;
 Vector *init_nodes = NULL;
 double scr_min_val, scr_max_val;
+TimeSeriesWriter *ts_writer = NULL; // see the script command timeseries_save
+TimeSeriesReader *ts_reader = NULL; // see the script command timeseries
+// the next and the last frame to show, the stride and the frames shown so far
+int ts_frame = 0, ts_last = 0, ts_step = 1, ts_shown = 0;
 
 Array<istream *> input_streams;
 
@@ -366,7 +372,7 @@ void StartVisualization(int field_type)
    {
       auxModKeyFunc(XK_space, ThreadsPauseFunc);
       glvis_command = new GLVisCommand(&vs, &mesh, &grid_f, &sol, &keep_attr,
-                                       &fix_elem_orient);
+                                       &fix_elem_orient, &coalesce);
       comm_thread = new communication_thread(input_streams);
    }
 
@@ -638,6 +644,141 @@ int ScriptReadDisplMesh(istream &scr, Mesh **mp, GridFunction **sp)
    return 0;
 }
 
+// Replace the mesh and the solution during a script; 'new_m' and 'new_g' may
+// also be the current mesh and solution with updated values. Returns false if
+// the type of the new data does not match.
+bool ScriptSetMeshAndSolution(Mesh *new_m, GridFunction *new_g)
+{
+   if (new_m->SpaceDimension() == mesh->SpaceDimension() &&
+       new_g->VectorDim() == grid_f->VectorDim())
+   {
+      if (new_m->SpaceDimension() == 2)
+      {
+         if (new_g->VectorDim() == 1)
+         {
+            VisualizationSceneSolution *vss =
+               dynamic_cast<VisualizationSceneSolution *>(vs);
+            new_g->GetNodalValues(sol);
+            vss->NewMeshAndSolution(new_m, &sol, new_g);
+         }
+         else
+         {
+            VisualizationSceneVector *vsv =
+               dynamic_cast<VisualizationSceneVector *>(vs);
+            vsv->NewMeshAndSolution(*new_g);
+         }
+      }
+      else
+      {
+         if (new_g->VectorDim() == 1)
+         {
+            VisualizationSceneSolution3d *vss =
+               dynamic_cast<VisualizationSceneSolution3d *>(vs);
+            new_g->GetNodalValues(sol);
+            vss->NewMeshAndSolution(new_m, &sol, new_g);
+         }
+         else
+         {
+            if (new_g != grid_f)
+            {
+               new_g = ProjectVectorFEGridFunction(new_g);
+            }
+            VisualizationSceneVector3d *vss =
+               dynamic_cast<VisualizationSceneVector3d *>(vs);
+            vss->NewMeshAndSolution(new_m, new_g);
+         }
+      }
+      if (new_g != grid_f) { delete grid_f; grid_f = new_g; }
+      if (new_m != mesh) { delete mesh; mesh = new_m; }
+
+      if (ts_writer && ts_writer->AddFrame(*grid_f))
+      {
+         cout << "Script: timeseries_save: stopped." << endl;
+         delete ts_writer; ts_writer = NULL;
+      }
+
+      vs->Draw();
+      return true;
+   }
+   cout << "Different type of mesh / solution." << endl;
+   if (new_g != grid_f) { delete new_g; }
+   if (new_m != mesh) { delete new_m; }
+   return false;
+}
+
+// Show the next frame of the time series opened by the timeseries or the
+// timeseries_range command
+void ScriptTimeSeriesFrame()
+{
+   if (ts_shown == 0)
+   {
+      Mesh *new_m;
+      GridFunction *new_g;
+      ts_reader->NewMeshAndGridFunction(&new_m, &new_g, fix_elem_orient);
+      if (ts_reader->ReadFrame(ts_frame, *new_g))
+      {
+         cout << "Script: timeseries: error reading frame " << ts_frame
+              << endl;
+         delete new_g;
+         delete new_m;
+         delete ts_reader; ts_reader = NULL;
+         return;
+      }
+      if (!ScriptSetMeshAndSolution(new_m, new_g))
+      {
+         delete ts_reader; ts_reader = NULL;
+         return;
+      }
+   }
+   else
+   {
+      if (ts_reader->ReadFrame(ts_frame, *grid_f))
+      {
+         cout << "Script: timeseries: error reading frame " << ts_frame
+              << endl;
+         delete ts_reader; ts_reader = NULL;
+         return;
+      }
+      ScriptSetMeshAndSolution(mesh, grid_f);
+   }
+   ts_shown++;
+   if (ts_frame == ts_last)
+   {
+      cout << "Script: timeseries: " << ts_shown << " frames done." << endl;
+      delete ts_reader; ts_reader = NULL;
+   }
+   ts_frame += ts_step;
+}
+
+// Open a time series and show its frames 'first', 'first + step', ... up to
+// 'last' (the last frame of the series if negative), one per script step.
+void ScriptTimeSeriesOpen(const char *fname, int first, int last, int step)
+{
+   delete ts_reader;
+   ts_reader = new TimeSeriesReader(fname);
+   if (!ts_reader->good())
+   {
+      delete ts_reader; ts_reader = NULL;
+      return;
+   }
+   const int nf = ts_reader->NumFrames();
+   cout << "Script: timeseries: " << nf << " frames" << endl;
+   if (last < 0) { last = nf - 1; }
+   if (first < 0 || first >= nf || last >= nf || step == 0 ||
+       (last - first)*step < 0)
+   {
+      cout << "Script: timeseries: invalid frame range: " << first << ' '
+           << last << ' ' << step << endl;
+      delete ts_reader; ts_reader = NULL;
+      return;
+   }
+   ts_frame = first;
+   ts_last = first + (last - first)/step*step;
+   ts_step = step;
+   ts_shown = 0;
+   ScriptTimeSeriesFrame();
+}
+
 void ExecuteScriptCommand()
 {
    if (!script)
@@ -646,6 +787,12 @@ void ExecuteScriptCommand()
       return;
    }
 
+   if (ts_reader)
+   {
+      ScriptTimeSeriesFrame();
+      return;
+   }
+
    istream &scr = *script;
    string word;
    int done_one_command = 0;
@@ -656,6 +803,7 @@ void ExecuteScriptCommand()
       {
          cout << "End of script." << endl;
          scr_level = 0;
+         delete ts_writer; ts_writer = NULL;
          return;
       }
       if (scr.peek() == '#')
@@ -712,52 +860,45 @@ void ExecuteScriptCommand()
             }
          }
 
-         if (new_m->SpaceDimension() == mesh->SpaceDimension() &&
-             new_g->VectorDim() == grid_f->VectorDim())
-         {
-            if (new_m->SpaceDimension() == 2)
-            {
-               if (new_g->VectorDim() == 1)
-               {
-                  VisualizationSceneSolution *vss =
-                     dynamic_cast<VisualizationSceneSolution *>(vs);
-                  new_g->GetNodalValues(sol);
-                  vss->NewMeshAndSolution(new_m, &sol, new_g);
-               }
-               else
-               {
-                  VisualizationSceneVector *vsv =
-                     dynamic_cast<VisualizationSceneVector *>(vs);
-                  vsv->NewMeshAndSolution(*new_g);
-               }
-            }
-            else
+         ScriptSetMeshAndSolution(new_m, new_g);
+      }
+      else if (word == "timeseries")
+      {
+         scr >> ws >> word;
+         cout << "Script: timeseries: " << word << endl;
+         ScriptTimeSeriesOpen(word.c_str(), 0, -1, 1);
+         done_one_command = 1;
+      }
+      else if (word == "timeseries_range")
+      {
+         int first, last, step;
+         scr >> ws >> word >> first >> last >> step;
+         cout << "Script: timeseries_range: " << word << ' ' << first << ' '
+              << last << ' ' << step << endl;
+         ScriptTimeSeriesOpen(word.c_str(), first, last, step);
+         done_one_command = 1;
+      }
+      else if (word == "timeseries_save")
+      {
+         scr >> ws >> word;
+         cout << "Script: timeseries_save: " << word;
+         delete ts_writer; ts_writer = NULL;
+         if (word != "off")
+         {
+            int bits;
+            scr >> bits;
+            cout << ' ' << bits << endl;
+            ts_writer = new TimeSeriesWriter(word.c_str(), *mesh, *grid_f,
+                                             bits);
+            if (!ts_writer->good())
             {
-               if (new_g->VectorDim() == 1)
-               {
-                  VisualizationSceneSolution3d *vss =
-                     dynamic_cast<VisualizationSceneSolution3d *>(vs);
-                  new_g->GetNodalValues(sol);
-                  vss->NewMeshAndSolution(new_m, &sol, new_g);
-               }
-               else
-               {
-                  new_g = ProjectVectorFEGridFunction(new_g);
-                  VisualizationSceneVector3d *vss =
-                     dynamic_cast<VisualizationSceneVector3d *>(vs);
-                  vss->NewMeshAndSolution(new_m, new_g);
-               }
+               cout << "Can not open time series file: " << word << endl;
+               delete ts_writer; ts_writer = NULL;
             }
-            delete grid_f; grid_f = new_g;
-            delete mesh; mesh = new_m;
-
-            vs->Draw();
          }
          else
          {
-            cout << "Different type of mesh / solution." << endl;
-            delete new_g;
-            delete new_m;
+            cout << endl;
          }
       }
       else if (word == "screenshot")
@@ -783,6 +924,40 @@ void ExecuteScriptCommand()
             scr_max_val = vs->GetMaxV();
          }
       }
+      else if (word == "print")
+      {
+         scr >> ws >> word;
+
+         cout << "Script: print: " << flush;
+         if (PrintFigure(word.c_str()))
+         {
+            cout << "PrintFigure(" << word << ") failed." << endl;
+            done_one_command = 1;
+            continue;
+         }
+         cout << "-> " << word << endl;
+      }
+      else if (word == "probe")
+      {
+         double pt[3];
+         scr >> pt[0] >> pt[1] >> pt[2];
+         cout << "Script: probe: ";
+         vs->PrintProbe(pt);
+      }
+      else if (word == "stats")
+      {
+         cout << "Script: stats:" << endl;
+         ProfilerPrint(cout);
+      }
+      else if (word == "streamlines")
+      {
+         string args;
+         getline(scr, args);
+         cout << "Script: streamlines:" << args << endl;
+         istringstream in(args);
+         vs->StreamlineCommand(in);
+         MyExpose();
+      }
       else if (word == "viewcenter")
       {
          scr >> vs->ViewCenterX >> vs->ViewCenterY;
@@ -1138,6 +1313,9 @@ void PlayScript(istream &scr)
    cout << "Script: min_val = " << scr_min_val
         << ", max_val = " << scr_max_val << endl;
 
+   delete ts_writer; ts_writer = NULL;
+   delete ts_reader; ts_reader = NULL;
+
    script = NULL;
 }
 
@@ -1148,6 +1326,9 @@ int main (int argc, char *argv[])
    bool        multi_session = true;   // not added as option
    bool        mac           = false;
    const char *stream_file   = string_none;
+   const char *record_prefix = string_none;
+   const char *replay_file   = string_none;
+   bool        replay_rt     = true;
    const char *script_file   = string_none;
    const char *font_name     = string_default;
    int         portnum       = 19916;
@@ -1155,6 +1336,12 @@ int main (int argc, char *argv[])
    int         multisample   = GetMultisample();
    double      line_width    = Get_LineWidth();
    double      ms_line_width = Get_MS_LineWidth();
+   double      frame_rate    = tkGetFrameRate();
+   const char *trace_file    = string_none;
+   bool        soft_render   = GetSoftwareRendering();
+   double      lsurf_simp    = VisualizationSceneSolution3d::lsurf_simplify;
+   double      lsurf_error   =
+      VisualizationSceneSolution3d::lsurf_simplify_error;
    int         geom_ref_type = Quadrature1D::ClosedUniform;
 
    OptionsParser args(argc, argv);
@@ -1191,6 +1378,11 @@ int main (int argc, char *argv[])
    args.AddOption(&save_coloring, "-sc", "--save-coloring",
                   "-no-sc", "--dont-save-coloring",
                   "Save the mesh coloring generated when opening only a mesh.");
+   args.AddOption(&coalesce, "-co", "--coalesce-updates",
+                  "-no-co", "--dont-coalesce-updates",
+                  "When new solutions arrive faster than they can be drawn,"
+                  " skip all but the newest one instead of blocking the"
+                  " sender.");
    args.AddOption(&portnum, "-p", "--listen-port",
                   "Specify the port number on which to accept connections.");
    args.AddOption(&secure, "-sec", "--secure-sockets",
@@ -1202,6 +1394,16 @@ int main (int argc, char *argv[])
                   " visualization.");
    args.AddOption(&stream_file, "-saved", "--saved-stream",
                   "Load a GLVis stream saved to a file.");
+   args.AddOption(&record_prefix, "-rec", "--record-sessions",
+                  "In server mode, record the incoming data of each session,"
+                  " with timing, to the file <prefix>.<session-number>.");
+   args.AddOption(&replay_file, "-replay", "--replay-session",
+                  "Send a session recorded with -rec to the GLVis server on"
+                  " the port given by -p.");
+   args.AddOption(&replay_rt, "-rt", "--replay-realtime",
+                  "-no-rt", "--replay-fast",
+                  "Replay a session with its original timing or as fast as"
+                  " possible.");
    args.AddOption(&window_w, "-ww", "--window-width",
                   "Set the window width.");
    args.AddOption(&window_h, "-wh", "--window-height",
@@ -1218,6 +1420,22 @@ int main (int argc, char *argv[])
                   "Set the line width (multisampling off).");
    args.AddOption(&ms_line_width, "-mslw", "--multisample-line-width",
                   "Set the line width (multisampling on).");
+   args.AddOption(&frame_rate, "-fps", "--frame-rate",
+                  "Set the maximum number of redraws per second of the"
+                  " window (0 = no limit).");
+   args.AddOption(&trace_file, "-trace", "--trace-file",
+                  "Write the timed stages to this file in the Chrome trace"
+                  " format (JSON), or as CSV if the name ends with '.csv'.");
+   args.AddOption(&soft_render, "-sw", "--software-render",
+                  "-no-sw", "--no-software-render",
+                  "Rasterize the frames and the screenshots with the built-in"
+                  " software renderer (for displays without a GPU).");
+   args.AddOption(&lsurf_simp, "-lss", "--level-surface-simplify",
+                  "Keep this fraction of the triangles of the 3D level"
+                  " surfaces (1 = no simplification).");
+   args.AddOption(&lsurf_error, "-lsse", "--level-surface-simplify-error",
+                  "Simplify the 3D level surfaces up to this error in pixels"
+                  " (0 = no limit).");
 
    cout << endl
         << "       _/_/_/  _/      _/      _/  _/"          << endl
@@ -1283,6 +1501,17 @@ int main (int argc, char *argv[])
    {
       Set_MS_LineWidth(ms_line_width);
    }
+   if (frame_rate != tkGetFrameRate())
+   {
+      tkSetFrameRate(frame_rate);
+   }
+   if (trace_file != string_none && ProfilerOpenTrace(trace_file))
+   {
+      cout << "Can not open trace file: " << trace_file << endl;
+   }
+   SetSoftwareRendering(soft_render);
+   VisualizationSceneSolution3d::lsurf_simplify = lsurf_simp;
+   VisualizationSceneSolution3d::lsurf_simplify_error = lsurf_error;
    if (c_plot_caption != string_none)
    {
       plot_caption = c_plot_caption;
@@ -1308,6 +1537,12 @@ int main (int argc, char *argv[])
       return 0;
    }
 
+   // replay a recorded session to a running server
+   if (replay_file != string_none)
+   {
+      return ReplaySession(replay_file, "localhost", portnum, replay_rt);
+   }
+
    // check for script file
    if (script_file != string_none)
    {
@@ -1341,6 +1576,8 @@ int main (int argc, char *argv[])
 #endif
 
    int childPID, viscount = 0, nproc = 1, proc = 0;
+   int reccount = 0;
+   SessionRecorder *recorder = NULL;
 
    // server mode, read the mesh and the solution from a socket
    if (input == 1)
@@ -1417,6 +1654,25 @@ int main (int argc, char *argv[])
 #endif
          }
 
+         if (record_prefix != string_none)
+         {
+            char rec_file[256];
+            snprintf(rec_file, sizeof(rec_file), "%s.%04d", record_prefix,
+                     ++reccount);
+            recorder = new SessionRecorder(rec_file);
+            if (!recorder->good())
+            {
+               cout << "Can not open session file: " << rec_file << endl;
+               delete recorder;
+               recorder = NULL;
+            }
+            else
+            {
+               cout << "Recording session to " << rec_file << endl;
+               recorder->Record(*isock);
+            }
+         }
+
          *isock >> data_type >> ws;
 
          if (mac)
@@ -1432,6 +1688,10 @@ int main (int argc, char *argv[])
             do
             {
                *isock >> nproc >> proc;
+               if (recorder)
+               {
+                  recorder->SetRank(*isock, proc);
+               }
 #ifdef GLVIS_DEBUG
                cout << "new connection: parallel " << nproc << ' ' << proc
                     << endl;
@@ -1487,6 +1747,10 @@ int main (int argc, char *argv[])
                   cout << "GLVis: server.accept(...) failed." << endl;
 #endif
                }
+               if (recorder)
+               {
+                  recorder->Record(*isock);
+               }
                *isock >> data_type >> ws; // "parallel"
                if (data_type != "parallel")
                {
@@ -1525,6 +1789,10 @@ int main (int argc, char *argv[])
                ofs.close();
                cout << "Data saved in " << tmp_file << endl;
             }
+            if (recorder)
+            {
+               recorder->Flush();
+            }
             childPID = fork();
          }
          else
@@ -1553,6 +1821,10 @@ int main (int argc, char *argv[])
                   {
                      signal(SIGINT, SIG_IGN);
                   }
+                  if (recorder)
+                  {
+                     recorder->Start();
+                  }
                   int ft;
                   if (!par_data)
                   {
@@ -1565,11 +1837,23 @@ int main (int argc, char *argv[])
                      ft = ReadInputStreams();
                   }
                   StartVisualization(ft);
+                  if (recorder)
+                  {
+                     recorder->Detach();
+                  }
                   CloseInputStreams(false);
+                  delete recorder;
                   exit(0);
                }
 
             default :                     // This is the parent process
+               if (recorder)
+               {
+                  // the child process continues the recording
+                  recorder->Detach();
+                  delete recorder;
+                  recorder = NULL;
+               }
                if (!par_data)
                {
                   isock->rdbuf()->socketbuf::close();
@@ -1876,13 +2160,24 @@ void SetMeshSolution(Mesh *mesh, GridFunction *&grid_f, bool save_coloring)
       grid_f = new GridFunction(cfes);
       grid_f->MakeOwner(cfec);
       {
+         // above this number of elements, use the parallel coloring
+         const int min_parallel_coloring = 1000000;
          Array<int> coloring;
          srandom(time(0));
-         double a = double(random()) / (double(RAND_MAX) + 1.);
-         int el0 = (int)floor(a * mesh->GetNE());
-         cout << "Generating coloring starting with element " << el0+1
-              << " / " << mesh->GetNE() << endl;
-         mesh->GetElementColoring(coloring, el0);
+         if (mesh->GetNE() < min_parallel_coloring)
+         {
+            double a = double(random()) / (double(RAND_MAX) + 1.);
+            int el0 = (int)floor(a * mesh->GetNE());
+            cout << "Generating coloring starting with element " << el0+1
+                 << " / " << mesh->GetNE() << endl;
+            mesh->GetElementColoring(coloring, el0);
+         }
+         else
+         {
+            unsigned seed = (unsigned)random();
+            cout << "Generating parallel coloring with seed " << seed << endl;
+            GetElementColoringParallel(mesh, coloring, seed);
+         }
          for (int i = 0; i < coloring.Size(); i++)
          {
             (*grid_f)(i) = coloring[i];
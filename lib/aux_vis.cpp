@@ -13,7 +13,10 @@
 #include <sstream>
 #include <fstream>
 #include <cmath>
+#include <climits>
+#include <cstring>
 #include <ctime>
+#include <map>
 #include <X11/keysym.h>
 
 #include "mfem.hpp"
@@ -322,6 +325,11 @@ void CallKeySequence(const char *seq)
    {
       if (*key != '~')
       {
+         if (*key == 'S')
+         {
+            // redraw, so that the screenshot shows the keys before it
+            MyExpose();
+         }
          auxCallKeyFunc(*key, 0);
       }
       else
@@ -329,6 +337,9 @@ void CallKeySequence(const char *seq)
          key++;
          switch (*key)
          {
+            case 'e': // expose event
+               MyExpose();
+               break;
             case 'l': // left arrow
                auxCallKeyFunc(XK_Left, 0);
                break;
@@ -365,6 +376,16 @@ void CallKeySequence(const char *seq)
    disableSendExposeEvent = false;
 }
 
+static std::string initial_keys;
+
+// Apply the keys given to SetVisualizationScene() once the window is shown.
+static void InitialKeysIdleFunc()
+{
+   RemoveIdleFunc(InitialKeysIdleFunc);
+   CallKeySequence(initial_keys.c_str());
+   SendExposeEvent();
+}
+
 void InitIdleFuncs();
 
 void SetVisualizationScene(VisualizationScene * scene, int view,
@@ -390,7 +411,8 @@ void SetVisualizationScene(VisualizationScene * scene, int view,
 
    if (keys)
    {
-      SendKeySequence(keys);
+      initial_keys = keys;
+      AddIdleFunc(InitialKeysIdleFunc);
    }
 
    auxMainLoop(NULL);
@@ -398,6 +420,11 @@ void SetVisualizationScene(VisualizationScene * scene, int view,
    InitIdleFuncs();
 }
 
+void Free_Palette_Textures();
+#ifdef GLVIS_USE_FREETYPE
+void FreeFontTextures();
+#endif
+
 void KillVisualization()
 {
    delete locscene;
@@ -407,7 +434,11 @@ void KillVisualization()
       tkUnloadBitmapFont(fontbase);
       fontbase = 0;
    }
+#else
+   FreeFontTextures();
 #endif
+   // the textures belong to the GL context of the window
+   Free_Palette_Textures();
    auxCloseWindow();
 }
 
@@ -463,6 +494,12 @@ void MyReshape(GLsizei w, GLsizei h)
 void MyExpose(GLsizei w, GLsizei h)
 {
    MyReshape (w, h);
+   if (GetSoftwareRendering() && SoftwareRender(locscene, w, h) == 0)
+   {
+      DrawSoftwareImage();
+      auxSwapBuffers();
+      return;
+   }
    locscene -> Draw();
 }
 
@@ -575,8 +612,23 @@ inline void ComputeSphereAngles(int &newx, int &newy,
    new_sph_t = atan2(y, x);
 }
 
+// Redraw with the full display lists once the mouse stops moving the view,
+// see VisualizationSceneScalarData::ProxyActive().
+static void StopMoving()
+{
+   if (locscene->moving)
+   {
+      locscene->moving = 0;
+      SendExposeEvent();
+   }
+}
+
 void LeftButtonDown (AUX_EVENTREC *event)
 {
+   if (locscene -> spinning)
+   {
+      SendExposeEvent();
+   }
    locscene -> spinning = 0;
    RemoveIdleFunc(MainLoop);
 
@@ -647,6 +699,7 @@ void LeftButtonLoc (AUX_EVENTREC *event)
 
    oldx = newx;
    oldy = newy;
+   locscene->moving = 1;
 
    if (sendexpose)
    {
@@ -662,6 +715,8 @@ void LeftButtonUp (AUX_EVENTREC *event)
    xang = (newx-startx)/5.0;
    yang = (newy-starty)/5.0;
 
+   StopMoving();
+
    if ( (event->data[2] & ShiftMask) && (xang != 0.0 || yang != 0.0) )
    {
       locscene -> spinning = 1;
@@ -748,6 +803,7 @@ void MiddleButtonLoc (AUX_EVENTREC *event)
       }
    }
 
+   locscene->moving = 1;
    SendExposeEvent();
 
    oldx = newx;
@@ -755,7 +811,19 @@ void MiddleButtonLoc (AUX_EVENTREC *event)
 }
 
 void MiddleButtonUp (AUX_EVENTREC *event)
-{}
+{
+   GLint newx = event->data[AUX_MOUSEX];
+   GLint newy = event->data[AUX_MOUSEY];
+
+   StopMoving();
+
+   // Shift + click without moving the mouse: probe the point under the cursor
+   if ((event->data[2] & ShiftMask) && !(event->data[2] & ControlMask) &&
+       newx == startx && newy == starty)
+   {
+      locscene->ProbeWindowPoint(newx, newy);
+   }
+}
 
 void RightButtonDown (AUX_EVENTREC *event)
 {
@@ -806,6 +874,7 @@ void RightButtonLoc (AUX_EVENTREC *event)
       locscene -> Scale ( exp ( double (oldy-newy) / 50 ) );
    }
 
+   locscene->moving = 1;
    SendExposeEvent();
 
    oldx = newx;
@@ -813,7 +882,9 @@ void RightButtonLoc (AUX_EVENTREC *event)
 }
 
 void RightButtonUp (AUX_EVENTREC *event)
-{}
+{
+   StopMoving();
+}
 
 #if defined(GLVIS_USE_LIBTIFF)
 const char *glvis_screenshot_ext = ".tif";
@@ -823,8 +894,27 @@ const char *glvis_screenshot_ext = ".png";
 const char *glvis_screenshot_ext = ".xwd";
 #endif
 
+#if defined(GLVIS_USE_LIBTIFF) || defined(GLVIS_USE_LIBPNG)
+// Read the row 'y' of the window, from the software rendered image if there is
+// one.
+static void ReadScreenshotRow(int y, int w, unsigned char *pixels)
+{
+   if (!GetSoftwareImageRow(y, w, pixels))
+   {
+      glReadPixels(0, y, w, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+   }
+}
+#endif
+
 int Screenshot(const char *fname, bool convert)
 {
+   ProfileTimer timer("Screenshot");
+
+   if (locscene->FinishPrepare())
+   {
+      MyExpose();
+   }
+
 #ifdef GLVIS_DEBUG
    cout << "Screenshot: glXWaitX() ... " << flush;
 #endif
@@ -898,7 +988,7 @@ int Screenshot(const char *fname, bool convert)
    TIFFSetField(image, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
    for (int i = 0; i < h; i++)
    {
-      glReadPixels(0, h-i-1, w, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+      ReadScreenshotRow(h-i-1, w, pixels);
       if (TIFFWriteScanline(image, pixels, i, 0) < 0)
       {
          TIFFClose(image);
@@ -965,7 +1055,7 @@ int Screenshot(const char *fname, bool convert)
    png_write_info(png_ptr, info_ptr);
    for (int i = 0; i < h; i++)
    {
-      glReadPixels(0, h-1-i, w, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+      ReadScreenshotRow(h-1-i, w, pixels);
       png_write_row(png_ptr, pixels);
    }
    png_write_end(png_ptr, info_ptr);
@@ -1028,43 +1118,100 @@ void KeyS()
    }
 }
 
-void KeyCtrlP()
+// Size (in GLfloats) of the gl2ps feedback buffer that was sufficient for the
+// last printed figure. It is the starting guess for the next print, so that
+// printing the same scene again needs only one pass.
+static int print_buffsize = 1024*1024;
+
+// For feedback buffers larger than this, sort the primitives by depth
+// (GL2PS_SIMPLE_SORT) instead of building a BSP tree which is too slow and
+// needs too much memory for very large scenes.
+static const int max_bsp_sort_size = 64*1024*1024;
+
+// For feedback buffers larger than this, remove the hidden primitives from the
+// output (GL2PS_OCCLUSION_CULL) to keep the size of the file reasonable.
+static const int min_occlusion_cull_size = 16*1024*1024;
+
+int PrintFigure(const char *fname)
 {
-   int state, buffsize;
-   FILE * fp;
    GLint viewport[4];
 
-   cout << "Printing the figure to GLVis.pdf... " << flush;
+   // choose the format from the extension of 'fname', PDF by default
+   GLint format = GL2PS_PDF;
+   const char *ext = strrchr(fname, '.');
+   if (ext && !strcmp(ext, ".svg"))
+   {
+      format = GL2PS_SVG;
+   }
+   else if (ext && !strcmp(ext, ".eps"))
+   {
+      format = GL2PS_EPS;
+   }
+   else if (ext && !strcmp(ext, ".ps"))
+   {
+      format = GL2PS_PS;
+   }
 
-   fp = fopen("GLVis.pdf", "wb");
-   buffsize = 0;
-   state = GL2PS_OVERFLOW;
+   FILE *fp = fopen(fname, "wb");
+   if (fp == NULL)
+   {
+      return 1;
+   }
+   locscene->FinishPrepare();
+   int state = GL2PS_OVERFLOW;
    locscene -> print = 1;
    glGetIntegerv(GL_VIEWPORT, viewport);
    while (state == GL2PS_OVERFLOW)
    {
-      buffsize += 1024*1024;
-      gl2psBeginPage ( "GLVis.pdf", "GLVis", viewport,
-                       GL2PS_PDF, // or GL2PS_SVG, or GL2PS_EPS
-                       GL2PS_BSP_SORT,
+      GLint sort = (print_buffsize > max_bsp_sort_size) ?
+                   GL2PS_SIMPLE_SORT : GL2PS_BSP_SORT;
+      GLint cull = (print_buffsize > min_occlusion_cull_size) ?
+                   GL2PS_OCCLUSION_CULL : 0;
+      gl2psBeginPage ( fname, "GLVis", viewport,
+                       format,
+                       sort,
                        GL2PS_SIMPLE_LINE_OFFSET |
                        // GL2PS_NO_PS3_SHADING |
                        // GL2PS_NO_BLENDING |
-                       // GL2PS_OCCLUSION_CULL |
                        // GL2PS_BEST_ROOT |
+                       cull |
                        GL2PS_SILENT |
                        GL2PS_DRAW_BACKGROUND,
-                       GL_RGBA, 0, NULL, 16, 16, 16, buffsize, fp, "a" );
+                       GL_RGBA, 0, NULL, 16, 16, 16, print_buffsize, fp,
+                       "a" );
       gl2psPointSize(.4);
       gl2psLineWidth(.2);
       locscene -> Draw();
       state = gl2psEndPage();
+      if (state == GL2PS_OVERFLOW)
+      {
+         // grow geometrically: the scene is redrawn O(log(size)) times
+         if (print_buffsize > INT_MAX/2)
+         {
+            break;
+         }
+         print_buffsize *= 2;
+      }
    }
    locscene -> print = 0;
    fclose(fp);
 
-   cout << "done" << endl;
    locscene -> Draw();
+   return (state == GL2PS_SUCCESS) ? 0 : 2;
+}
+
+void KeyCtrlP()
+{
+   cout << "Printing the figure to GLVis.pdf... " << flush;
+
+   if (PrintFigure("GLVis.pdf"))
+   {
+      cout << "failed" << endl;
+   }
+   else
+   {
+      cout << "done" << endl;
+   }
 }
 
 void KeyQPressed()
@@ -1125,6 +1272,7 @@ void CheckSpin()
    {
       locscene->spinning = 0;
       RemoveIdleFunc(MainLoop);
+      SendExposeEvent();
    }
    cout << "Spin angle: " << xang << " degrees / frame" << endl;
 }
@@ -1148,6 +1296,7 @@ void KeyDeletePressed()
       xang = yang = 0.;
       locscene -> spinning = 0;
       RemoveIdleFunc(MainLoop);
+      SendExposeEvent();
       constrained_spinning = 1;
    }
    else
@@ -1612,9 +1761,24 @@ void Make_Texture_From_Palette_2()
    }
 }
 
+// Fill Texture_Image for the current palette settings
+void Make_Texture_Image()
+{
+   if (UseTexture == 1)
+   {
+      Make_Texture_From_Palette_2();
+   }
+   else
+   {
+      Make_Texture_From_Palette();
+   }
+}
+
 void Write_Texture_To_File()
 {
    const char ppm_fname[] = "GLVis_texture.ppm";
+   // the texture may have been bound from the cache without building the image
+   Make_Texture_Image();
    cout << "Saving texture image --> " << flush;
    ofstream ppm_file(ppm_fname);
    ppm_file << "P3\n" << Texture_Size << " 1\n255\n";
@@ -1627,16 +1791,70 @@ void Write_Texture_To_File()
    cout << ppm_fname << endl;
 }
 
+// Palette textures uploaded to the GL, keyed by everything that determines the
+// texture image, so that switching back to a previously used palette, repeat
+// or discretization binds the texture instead of uploading it again.
+struct PaletteTextureKey
+{
+   const double *palette;
+   int palette_size, use_texture, repeat, num_colors;
+
+   bool operator<(const PaletteTextureKey &k) const
+   {
+      if (palette != k.palette) { return palette < k.palette; }
+      if (palette_size != k.palette_size)
+      {
+         return palette_size < k.palette_size;
+      }
+      if (use_texture != k.use_texture) { return use_texture < k.use_texture; }
+      if (repeat != k.repeat) { return repeat < k.repeat; }
+      return num_colors < k.num_colors;
+   }
+};
+
+const size_t Max_Palette_Textures = 64;
+map<PaletteTextureKey, GLuint> Palette_Textures;
+
+void Free_Palette_Textures()
+{
+   map<PaletteTextureKey, GLuint>::iterator it;
+   for (it = Palette_Textures.begin(); it != Palette_Textures.end(); ++it)
+   {
+      glDeleteTextures(1, &it->second);
+   }
+   Palette_Textures.clear();
+}
+
 void Set_Texture_Image()
 {
-   if (UseTexture == 1)
+   PaletteTextureKey key;
+   key.palette = RGB_Palette;
+   key.palette_size = RGB_Palette_Size;
+   key.use_texture = (UseTexture == 1);
+   key.repeat = RepeatPaletteTimes;
+   // only Make_Texture_From_Palette_2() uses the number of colors
+   key.num_colors = (UseTexture == 1) ? PaletteNumColors : 0;
+
+   glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+   // glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+   map<PaletteTextureKey, GLuint>::iterator it = Palette_Textures.find(key);
+   if (it != Palette_Textures.end())
    {
-      Make_Texture_From_Palette_2();
+      glBindTexture(GL_TEXTURE_1D, it->second);
+      return;
    }
-   else
+
+   Make_Texture_Image();
+
+   if (Palette_Textures.size() >= Max_Palette_Textures)
    {
-      Make_Texture_From_Palette();
+      Free_Palette_Textures();
    }
+   GLuint tex;
+   glGenTextures(1, &tex);
+   glBindTexture(GL_TEXTURE_1D, tex);
+   Palette_Textures[key] = tex;
 
    glTexImage1D(GL_TEXTURE_1D, // GLenum target,
                 0,             // GLint level,
@@ -1647,8 +1865,6 @@ void Set_Texture_Image()
                 GL_FLOAT,      // GLenum type,
                 Texture_Image  // const GLvoid *pixels
                );
-   glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-   // glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
    // glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
    // glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -1713,6 +1929,31 @@ private:
    int            image_width, image_height;
    unsigned char *image;
 
+public:
+   // Placement of a character in the glyph atlas, see BuildAtlas()
+   struct AtlasGlyph
+   {
+      int x, y, w, h;  // position and size of the bitmap in the atlas
+      int left, top;   // bitmap offset from the pen position
+      int advance;     // horizontal pen advance
+   };
+
+private:
+   static const int atlas_first = 32, atlas_last = 126;
+
+   AtlasGlyph     atlas_glyph[atlas_last - atlas_first + 1];
+   int            atlas_width, atlas_height;
+   unsigned char *atlas_image;
+   GLuint         atlas_tex;
+   int            generation;
+
+   void FreeAtlas()
+   {
+      delete [] atlas_image;
+      atlas_image = NULL;
+      FreeAtlasTexture();
+   }
+
    void LoadSequence(const char *text)
    {
       int          err;
@@ -1892,7 +2133,13 @@ private:
    }
 
 public:
-   GLVisFont() { init = 0; }
+   GLVisFont()
+   {
+      init = 0;
+      atlas_image = NULL;
+      atlas_tex = 0;
+      generation = 0;
+   }
 
    int Initialized() const { return init; }
 
@@ -1943,8 +2190,10 @@ public:
       {
          FreeSeq();
          delete [] image;
+         FreeAtlas();
          FT_Done_Face(face);
       }
+      generation++;
 
       err = FT_New_Face(library, font_file, 0, &face);
       if (err)
@@ -2111,6 +2360,133 @@ public:
    int GetImageWidth() const { return image_width; }
    int GetImageHeight() const { return image_height; }
 
+   // Rasterize the printable ASCII characters once into a single alpha image,
+   // packed in rows. Returns 0 on success.
+   int BuildAtlas()
+   {
+      const int pad = 1;
+      int x = pad, y = pad, row_h = 0;
+
+      if (init <= 0)
+      {
+         return 1;
+      }
+      if (atlas_image)
+      {
+         return 0;
+      }
+
+      atlas_width = 256;
+      for (int c = atlas_first; c <= atlas_last; c++)
+      {
+         AtlasGlyph &ag = atlas_glyph[c - atlas_first];
+
+         if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+         {
+            ag.x = ag.y = ag.w = ag.h = ag.left = ag.top = ag.advance = 0;
+            continue;
+         }
+
+         FT_GlyphSlot slot = face->glyph;
+         ag.w = slot->bitmap.width;
+         ag.h = slot->bitmap.rows;
+         ag.left = slot->bitmap_left;
+         ag.top = slot->bitmap_top;
+         ag.advance = (slot->advance.x + 32) >> 6;
+
+         if (x + ag.w + pad > atlas_width)
+         {
+            x = pad;
+            y += row_h + pad;
+            row_h = 0;
+         }
+         ag.x = x;
+         ag.y = y;
+         x += ag.w + pad;
+         if (ag.h > row_h)
+         {
+            row_h = ag.h;
+         }
+      }
+
+      atlas_height = 1;
+      while (atlas_height < y + row_h + pad)
+      {
+         atlas_height *= 2;
+      }
+
+      atlas_image = new unsigned char[atlas_width*atlas_height];
+      memset(atlas_image, 0, atlas_width*atlas_height);
+
+      for (int c = atlas_first; c <= atlas_last; c++)
+      {
+         const AtlasGlyph &ag = atlas_glyph[c - atlas_first];
+
+         if (ag.w == 0 || ag.h == 0 || FT_Load_Char(face, c, FT_LOAD_RENDER))
+         {
+            continue;
+         }
+
+         const FT_Bitmap &bitmap = face->glyph->bitmap;
+         for (int j = 0; j < ag.h; j++)
+         {
+            for (int i = 0; i < ag.w; i++)
+            {
+               atlas_image[(ag.x + i) + (ag.y + j)*atlas_width] =
+                  bitmap.buffer[i + j*bitmap.pitch];
+            }
+         }
+      }
+
+      return 0;
+   }
+
+   // Delete the atlas texture (the image is kept) before the GL context goes
+   // away; it is uploaded again on next use.
+   void FreeAtlasTexture()
+   {
+      if (atlas_tex)
+      {
+         glDeleteTextures(1, &atlas_tex);
+         atlas_tex = 0;
+      }
+   }
+
+   // The atlas texture is created on first use, with the current GL context.
+   GLuint GetAtlasTexture()
+   {
+      if (!atlas_tex && atlas_image)
+      {
+         glGenTextures(1, &atlas_tex);
+         glBindTexture(GL_TEXTURE_2D, atlas_tex);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+         glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+         glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, atlas_width, atlas_height, 0,
+                      GL_ALPHA, GL_UNSIGNED_BYTE, atlas_image);
+         glPopClientAttrib();
+      }
+      return atlas_tex;
+   }
+
+   const AtlasGlyph *GetAtlasGlyph(unsigned char c) const
+   {
+      if (!atlas_image || c < atlas_first || c > atlas_last)
+      {
+         return NULL;
+      }
+      return &atlas_glyph[c - atlas_first];
+   }
+
+   int GetAtlasWidth() const { return atlas_width; }
+   int GetAtlasHeight() const { return atlas_height; }
+
+   // Incremented every time the font changes
+   int GetGeneration() const { return generation; }
+
    ~GLVisFont()
    {
       if (init <= 0)
@@ -2121,6 +2497,8 @@ public:
       FreeSeq();
 
       delete [] image;
+      // the GL context may already be gone, so the atlas texture is not freed
+      delete [] atlas_image;
 
       FT_Done_Face(face);
       FT_Done_FreeType(library);
@@ -2150,7 +2528,7 @@ int font_size = 12;
 
 GLVisFont glvis_font;
 
-int RenderBitmapText(const char *text, int &width, int &height)
+static int InitBitmapFont()
 {
    if (!glvis_font.Initialized())
    {
@@ -2176,6 +2554,13 @@ int RenderBitmapText(const char *text, int &width, int &height)
               " edit 'fc_font_patterns' in lib/aux_vis.cpp" << endl;
    }
 
+   return glvis_font.Initialized() > 0;
+}
+
+int RenderBitmapText(const char *text, int &width, int &height)
+{
+   InitBitmapFont();
+
    int fail = glvis_font.Render(text);
 
    if (!fail)
@@ -2226,6 +2611,11 @@ int SetFontFile(const char *font_file, int height)
    return glvis_font.SetFontFile(font_file, height);
 }
 
+void FreeFontTextures()
+{
+   glvis_font.FreeAtlasTexture();
+}
+
 int SetFont(const char *font_patterns[], int num_patterns, int height)
 {
    return glvis_font.SetFont(font_patterns, num_patterns, height);
@@ -2271,3 +2661,398 @@ void SetFont(const char *fn)
    }
 #endif
 }
+
+void BitmapTextBatch::Clear()
+{
+   anchors.clear();
+   offsets.assign(1, 0);
+   chars.clear();
+   boxes.clear();
+   bucket_offsets.clear();
+   bucket_labels.clear();
+   font_id = -1;
+}
+
+void BitmapTextBatch::Add(const double x[3], const char *text)
+{
+   anchors.push_back(x[0]);
+   anchors.push_back(x[1]);
+   anchors.push_back(x[2]);
+   chars += text;
+   offsets.push_back((int)chars.size());
+   boxes.clear();
+   bucket_offsets.clear();
+}
+
+// Compute the box of each label in pixels relative to its anchor. As with
+// DrawBitmapText(), the lower left corner of the text box (with a padding of 2
+// pixels) is placed at the anchor. Kerning is not applied.
+void BitmapTextBatch::Layout()
+{
+   boxes.resize(4*Size());
+#ifdef GLVIS_USE_FREETYPE
+   const int pad = 2;
+   for (int i = 0; i < Size(); i++)
+   {
+      int pen = 0;
+      int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN;
+      for (int k = offsets[i]; k < offsets[i+1]; k++)
+      {
+         const GLVisFont::AtlasGlyph *g = glvis_font.GetAtlasGlyph(chars[k]);
+         if (!g) { continue; }
+         if (g->w > 0 && g->h > 0)
+         {
+            xmin = std::min(xmin, pen + g->left);
+            xmax = std::max(xmax, pen + g->left + g->w);
+            ymin = std::min(ymin, g->top - g->h);
+            ymax = std::max(ymax, g->top);
+         }
+         pen += g->advance;
+      }
+      if (xmin > xmax)
+      {
+         xmin = xmax = ymin = ymax = 0;
+      }
+      boxes[4*i+0] = pad - xmin;
+      boxes[4*i+1] = pad - ymin;
+      boxes[4*i+2] = xmax - xmin + 2*pad;
+      boxes[4*i+3] = ymax - ymin + 2*pad;
+   }
+   font_id = glvis_font.GetGeneration();
+#else
+   // the size of the X bitmap font is not known here, assume the default one
+   for (int i = 0; i < Size(); i++)
+   {
+      boxes[4*i+0] = 0;
+      boxes[4*i+1] = 0;
+      boxes[4*i+2] = 9*(offsets[i+1] - offsets[i]);
+      boxes[4*i+3] = 14;
+   }
+   font_id = 0;
+#endif
+}
+
+void BitmapTextBatch::BuildBuckets()
+{
+   const int n = Size();
+
+   for (int d = 0; d < 3; d++)
+   {
+      bmin[d] = bmax[d] = anchors[d];
+   }
+   for (int i = 1; i < n; i++)
+      for (int d = 0; d < 3; d++)
+      {
+         bmin[d] = std::min(bmin[d], anchors[3*i+d]);
+         bmax[d] = std::max(bmax[d], anchors[3*i+d]);
+      }
+
+   // about 16 labels per bucket
+   nbx = nby = std::max(1, std::min(256, (int)ceil(sqrt(n/16.0))));
+
+   std::vector<int> bucket(n);
+   bucket_offsets.assign(nbx*nby + 1, 0);
+   for (int i = 0; i < n; i++)
+   {
+      const double *x = &anchors[3*i];
+      int bx = 0, by = 0;
+      if (bmax[0] > bmin[0])
+      {
+         bx = (int)(nbx*(x[0] - bmin[0])/(bmax[0] - bmin[0]));
+         bx = std::min(nbx - 1, bx);
+      }
+      if (bmax[1] > bmin[1])
+      {
+         by = (int)(nby*(x[1] - bmin[1])/(bmax[1] - bmin[1]));
+         by = std::min(nby - 1, by);
+      }
+      bucket[i] = bx + nbx*by;
+      bucket_offsets[bucket[i] + 1]++;
+   }
+   for (int b = 0; b < nbx*nby; b++)
+   {
+      bucket_offsets[b + 1] += bucket_offsets[b];
+   }
+   bucket_labels.resize(n);
+   std::vector<int> pos(bucket_offsets.begin(), bucket_offsets.end() - 1);
+   for (int i = 0; i < n; i++)
+   {
+      bucket_labels[pos[bucket[i]]++] = i;
+   }
+}
+
+// Select the labels to draw. 'pm' is the product of the projection and the
+// modelview matrices. Each placed label marks the cells of an occupancy grid
+// with 'cell' pixels per side, and labels touching a marked cell are skipped.
+// Buckets whose screen rectangle is already covered are skipped as a whole and
+// the search stops when the grid is full, so dense views do not visit every
+// label.
+void BitmapTextBatch::Place(const double pm[16], const int vp[4])
+{
+   const int cell = 8;
+   const int gw = (vp[2] + cell - 1)/cell, gh = (vp[3] + cell - 1)/cell;
+
+   placed.clear();
+   if (gw <= 0 || gh <= 0)
+   {
+      return;
+   }
+   occupied.assign(gw*gh, 0);
+   int num_free = gw*gh;
+
+   for (int by = 0; by < nby; by++)
+      for (int bx = 0; bx < nbx; bx++)
+      {
+         const int b = bx + nbx*by;
+         if (bucket_offsets[b] == bucket_offsets[b+1]) { continue; }
+
+         // skip the bucket if its box is outside one of the clip planes
+         const double lo[3] =
+         {
+            bmin[0] + (bmax[0] - bmin[0])*bx/nbx,
+            bmin[1] + (bmax[1] - bmin[1])*by/nby,
+            bmin[2]
+         };
+         const double hi[3] =
+         {
+            bmin[0] + (bmax[0] - bmin[0])*(bx + 1)/nbx,
+            bmin[1] + (bmax[1] - bmin[1])*(by + 1)/nby,
+            bmax[2]
+         };
+         int outside[6] = { 1, 1, 1, 1, 1, 1 };
+         bool behind = false;
+         double wmin[2] = { HUGE_VAL, HUGE_VAL };
+         double wmax[2] = { -HUGE_VAL, -HUGE_VAL };
+         for (int v = 0; v < 8; v++)
+         {
+            const double x[3] =
+            {
+               (v & 1) ? hi[0] : lo[0],
+               (v & 2) ? hi[1] : lo[1],
+               (v & 4) ? hi[2] : lo[2]
+            };
+            double c[4];
+            for (int r = 0; r < 4; r++)
+            {
+               c[r] = pm[r]*x[0] + pm[r+4]*x[1] + pm[r+8]*x[2] + pm[r+12];
+            }
+            for (int d = 0; d < 3; d++)
+            {
+               if (c[d] <= c[3]) { outside[2*d] = 0; }
+               if (c[d] >= -c[3]) { outside[2*d+1] = 0; }
+            }
+            if (c[3] <= 0.0) { behind = true; continue; }
+            for (int d = 0; d < 2; d++)
+            {
+               double w = vp[2+d]*(c[d]/c[3] + 1.0)/2;
+               w = std::max(-1.0, std::min(vp[2+d] + 1.0, w));
+               wmin[d] = std::min(wmin[d], w);
+               wmax[d] = std::max(wmax[d], w);
+            }
+         }
+         if (outside[0] || outside[1] || outside[2] ||
+             outside[3] || outside[4] || outside[5])
+         {
+            continue;
+         }
+
+         // the anchors of the bucket project inside its screen rectangle
+         // (rounded as below, with some slack), and a label whose anchor cell
+         // is marked can not be placed
+         if (!behind)
+         {
+            const double eps = 1e-3;
+            const int cx0 = std::max(0, (int)floor(wmin[0] + 0.5 - eps)/cell);
+            const int cy0 = std::max(0, (int)floor(wmin[1] + 0.5 - eps)/cell);
+            const int cx1 =
+               std::min(gw - 1, (int)floor(wmax[0] + 0.5 + eps)/cell);
+            const int cy1 =
+               std::min(gh - 1, (int)floor(wmax[1] + 0.5 + eps)/cell);
+            bool covered = true;
+            for (int cy = cy0; cy <= cy1 && covered; cy++)
+               for (int cx = cx0; cx <= cx1; cx++)
+               {
+                  if (!occupied[cx + gw*cy]) { covered = false; break; }
+               }
+            if (covered) { continue; }
+         }
+
+         for (int j = bucket_offsets[b]; j < bucket_offsets[b+1]; j++)
+         {
+            const int i = bucket_labels[j];
+            const double *x = &anchors[3*i];
+            double c[4];
+            for (int r = 0; r < 4; r++)
+            {
+               c[r] = pm[r]*x[0] + pm[r+4]*x[1] + pm[r+8]*x[2] + pm[r+12];
+            }
+            // labels with anchors outside the view volume are skipped, like
+            // glRasterPos does
+            if (c[3] <= 0.0 ||
+                fabs(c[0]) > c[3] || fabs(c[1]) > c[3] || fabs(c[2]) > c[3])
+            {
+               continue;
+            }
+            const double wx = floor(vp[2]*(c[0]/c[3] + 1.0)/2 + 0.5);
+            const double wy = floor(vp[3]*(c[1]/c[3] + 1.0)/2 + 0.5);
+
+            const int cx0 = std::min(gw - 1, (int)wx/cell);
+            const int cy0 = std::min(gh - 1, (int)wy/cell);
+            const int cx1 = std::min(gw - 1, (int)(wx + boxes[4*i+2])/cell);
+            const int cy1 = std::min(gh - 1, (int)(wy + boxes[4*i+3])/cell);
+            bool free_box = true;
+            for (int cy = cy0; cy <= cy1 && free_box; cy++)
+               for (int cx = cx0; cx <= cx1; cx++)
+               {
+                  if (occupied[cx + gw*cy]) { free_box = false; break; }
+               }
+            if (!free_box) { continue; }
+            for (int cy = cy0; cy <= cy1; cy++)
+               for (int cx = cx0; cx <= cx1; cx++)
+               {
+                  occupied[cx + gw*cy] = 1;
+               }
+            num_free -= (cx1 - cx0 + 1)*(cy1 - cy0 + 1);
+
+            placed.push_back(i);
+            placed.push_back(wx);
+            placed.push_back(wy);
+            placed.push_back(c[2]/c[3]);
+            if (num_free == 0)
+            {
+               return;
+            }
+         }
+      }
+}
+
+void BitmapTextBatch::Draw()
+{
+   if (Size() == 0)
+   {
+      return;
+   }
+
+#ifdef GLVIS_USE_FREETYPE
+   if (!InitBitmapFont() || glvis_font.BuildAtlas())
+   {
+      return;
+   }
+   if (font_id != glvis_font.GetGeneration())
+   {
+      Layout();
+   }
+#endif
+   if ((int)boxes.size() != 4*Size())
+   {
+      Layout();
+   }
+   if (bucket_offsets.empty())
+   {
+      BuildBuckets();
+   }
+
+   GLdouble mv[16], pr[16], pm[16];
+   GLint vp[4];
+   glGetDoublev(GL_MODELVIEW_MATRIX, mv);
+   glGetDoublev(GL_PROJECTION_MATRIX, pr);
+   glGetIntegerv(GL_VIEWPORT, vp);
+   for (int j = 0; j < 4; j++)
+      for (int i = 0; i < 4; i++)
+      {
+         pm[i+4*j] = 0.0;
+         for (int k = 0; k < 4; k++)
+         {
+            pm[i+4*j] += pr[i+4*k]*mv[k+4*j];
+         }
+      }
+
+   Place(pm, vp);
+
+#ifndef GLVIS_USE_FREETYPE
+   glPushAttrib(GL_LIST_BIT);
+   glListBase(fontbase);
+   for (size_t p = 0; p < placed.size(); p += 4)
+   {
+      const int i = (int)placed[p];
+      glRasterPos3dv(&anchors[3*i]);
+      glCallLists(offsets[i+1] - offsets[i], GL_UNSIGNED_BYTE,
+                  chars.data() + offsets[i]);
+   }
+   glPopAttrib();
+#else
+   // emit the glyph quads of the placed labels in normalized device
+   // coordinates
+   const float aw = glvis_font.GetAtlasWidth();
+   const float ah = glvis_font.GetAtlasHeight();
+   verts.clear();
+   for (size_t p = 0; p < placed.size(); p += 4)
+   {
+      const int i = (int)placed[p];
+      const double wx = placed[p+1] + boxes[4*i+0];
+      const double wy = placed[p+2] + boxes[4*i+1];
+      const float z = placed[p+3];
+
+      int pen = 0;
+      for (int k = offsets[i]; k < offsets[i+1]; k++)
+      {
+         const GLVisFont::AtlasGlyph *g = glvis_font.GetAtlasGlyph(chars[k]);
+         if (!g) { continue; }
+         if (g->w > 0 && g->h > 0)
+         {
+            const double gx = wx + pen + g->left, gy = wy + g->top - g->h;
+            float x0 = 2*gx/vp[2] - 1, x1 = 2*(gx + g->w)/vp[2] - 1;
+            float y0 = 2*gy/vp[3] - 1, y1 = 2*(gy + g->h)/vp[3] - 1;
+            float s0 = g->x/aw, s1 = (g->x + g->w)/aw;
+            float t0 = (g->y + g->h)/ah, t1 = g->y/ah;
+            const float v[20] =
+            {
+               s0, t0, x0, y0, z,
+               s1, t0, x1, y0, z,
+               s1, t1, x1, y1, z,
+               s0, t1, x0, y1, z
+            };
+            verts.insert(verts.end(), v, v + 20);
+         }
+         pen += g->advance;
+      }
+   }
+   if (verts.empty())
+   {
+      return;
+   }
+
+   glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                GL_TEXTURE_BIT);
+   glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+   glDisable(GL_LIGHTING);
+   glDisable(GL_TEXTURE_1D);
+   glEnable(GL_TEXTURE_2D);
+   glBindTexture(GL_TEXTURE_2D, glvis_font.GetAtlasTexture());
+   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   glDepthMask(GL_FALSE);
+   MarkRenderState();
+
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glInterleavedArrays(GL_T2F_V3F, 0, &verts[0]);
+   glDrawArrays(GL_QUADS, 0, (GLsizei)verts.size()/5);
+
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+
+   glPopClientAttrib();
+   glPopAttrib();
+   MarkRenderState();
+#endif
+}
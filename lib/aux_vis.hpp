@@ -12,6 +12,9 @@
 #ifndef GLVIS_AUX_VIS
 #define GLVIS_AUX_VIS
 
+#include <string>
+#include <vector>
+
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <GL/glx.h>
@@ -55,6 +58,8 @@ void RightButtonDown (AUX_EVENTREC *event);
 void RightButtonLoc  (AUX_EVENTREC *event);
 void RightButtonUp   (AUX_EVENTREC *event);
 
+/// Print the scene to a PDF, SVG, EPS or PS file (based on the file extension)
+int PrintFigure(const char *fname);
 void KeyCtrlP();
 void KeyS();
 void KeyQPressed();
@@ -105,8 +110,9 @@ void SendKeySequence(const char *seq);
 // Directly call the functions assigned to the given keys. Unlike the above
 // function, SendKeySequence(), this function does not send X events and
 // actually disables the function SendExposeEvent() used by many of the
-// functions assigned to keys. Call MyExpose() after calling this function to
-// update the visualization window.
+// functions assigned to keys. The display lists changed by the keys are
+// rebuilt once, by the next redraw. Call MyExpose() after calling this
+// function to update the visualization window.
 void CallKeySequence(const char *seq);
 
 void Cone();
@@ -130,4 +136,47 @@ int SetFont(const char *font_patterns[], int num_patterns, int height);
 
 void SetFont(const char *fn);
 
+/// A set of text labels anchored at 3D points. The anchors are projected on
+/// every Draw(), so the labels follow the view without being rasterized again.
+/// With FreeType, all labels are drawn from a cached glyph atlas texture as a
+/// single array of textured quads.
+///
+/// Only labels whose anchor is inside the view and whose box does not overlap
+/// an already placed label are drawn. The anchors are bucketed in a uniform
+/// grid in (x,y), so buckets outside the view are skipped as a whole, and the
+/// overlap test uses an occupancy grid in screen space.
+class BitmapTextBatch
+{
+private:
+   std::vector<double> anchors; // x, y, z of each label
+   std::vector<int>    offsets; // label i is chars[offsets[i]..offsets[i+1])
+   std::string         chars;
+   std::vector<float>  boxes;   // x, y offset and width, height of each label
+   int                 font_id; // font generation used by 'boxes'
+
+   int nbx, nby;                // object space buckets
+   double bmin[3], bmax[3];
+   std::vector<int> bucket_offsets, bucket_labels;
+
+   std::vector<unsigned char> occupied; // screen space grid, see Place()
+   std::vector<double> placed;          // label, window x, y, z per label
+#ifdef GLVIS_USE_FREETYPE
+   std::vector<float>  verts;   // scratch buffer for Draw()
+#endif
+
+   void Layout();
+   void BuildBuckets();
+   void Place(const double pm[16], const int vp[4]);
+
+public:
+   BitmapTextBatch() { Clear(); }
+
+   void Clear();
+   void Add(const double x[3], const char *text);
+   int Size() const { return (int)offsets.size() - 1; }
+
+   /// Draw the labels using the current matrices, viewport and color
+   void Draw();
+};
+
 #endif
@@ -0,0 +1,236 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "coloring.hpp"
+#include "workers.hpp"
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace mfem;
+
+// The elements are colored in rounds. An element is ready once all of its
+// neighbors with higher priority are colored; it then takes the smallest color
+// not used by them. Ready elements are never neighbors, so each round can be
+// colored in parallel. In the next round, an element is added to the ready list
+// by the neighbor, colored in the current round, with the smallest index.
+class JonesPlassmann
+{
+private:
+   const int *I, *J;
+   unsigned seed;
+   vector<unsigned> prio;
+   vector<int> round;
+   int *color;
+
+   // the number of threads that run Work() is known once they start
+   int max_threads;
+   vector<int> ready;
+   vector<vector<int> > next;
+   int cur_round;
+   bool done;
+
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int barrier_count, barrier_gen;
+
+   bool Higher(int i, int j) const
+   {
+      return (prio[i] > prio[j]) || (prio[i] == prio[j] && i > j);
+   }
+
+   void Barrier(int num_threads)
+   {
+      pthread_mutex_lock(&mutex);
+      int gen = barrier_gen;
+      if (++barrier_count == num_threads)
+      {
+         barrier_count = 0;
+         barrier_gen++;
+         pthread_cond_broadcast(&cond);
+      }
+      else
+      {
+         while (gen == barrier_gen)
+         {
+            pthread_cond_wait(&cond, &mutex);
+         }
+      }
+      pthread_mutex_unlock(&mutex);
+   }
+
+   void ColorElement(int i)
+   {
+      // the number of neighbors is small, so a linear search is fine
+      int c = 0;
+      for (bool used = true; used; )
+      {
+         used = false;
+         for (int k = I[i]; k < I[i+1]; k++)
+         {
+            if (Higher(J[k], i) && color[J[k]] == c)
+            {
+               used = true;
+               c++;
+               break;
+            }
+         }
+      }
+      color[i] = c;
+      round[i] = cur_round;
+   }
+
+   bool IsReady(int i) const
+   {
+      for (int k = I[i]; k < I[i+1]; k++)
+      {
+         if (Higher(J[k], i) && round[J[k]] < 0) { return false; }
+      }
+      return true;
+   }
+
+   // Returns the neighbor of 'i', colored in the current round, with the
+   // smallest index
+   int FirstColoredNow(int i) const
+   {
+      int first = -1;
+      for (int k = I[i]; k < I[i+1]; k++)
+      {
+         int j = J[k];
+         if (round[j] == cur_round && (first < 0 || j < first)) { first = j; }
+      }
+      return first;
+   }
+
+   void Merge(int num_threads)
+   {
+      ready.clear();
+      for (int t = 0; t < num_threads; t++)
+      {
+         ready.insert(ready.end(), next[t].begin(), next[t].end());
+      }
+      done = ready.empty();
+   }
+
+   void Work(int id, int num_threads)
+   {
+      const int n = prio.size();
+      const int i_beg = (long)n*id/num_threads;
+      const int i_end = (long)n*(id+1)/num_threads;
+
+      for (int i = i_beg; i < i_end; i++)
+      {
+         // 32-bit integer hash of the index and the seed
+         unsigned h = (unsigned)i ^ (seed*0x9e3779b9u);
+         h ^= h >> 16; h *= 0x7feb352du;
+         h ^= h >> 15; h *= 0x846ca68bu;
+         h ^= h >> 16;
+         prio[i] = h;
+      }
+      Barrier(num_threads);
+
+      next[id].clear();
+      for (int i = i_beg; i < i_end; i++)
+      {
+         if (IsReady(i)) { next[id].push_back(i); }
+      }
+      Barrier(num_threads);
+
+      if (id == 0) { Merge(num_threads); }
+      Barrier(num_threads);
+
+      while (!done)
+      {
+         const int n = ready.size();
+         const int beg = (long)n*id/num_threads;
+         const int end = (long)n*(id+1)/num_threads;
+
+         for (int r = beg; r < end; r++)
+         {
+            ColorElement(ready[r]);
+         }
+         Barrier(num_threads);
+
+         vector<int> &my_next = next[id];
+         my_next.clear();
+         for (int r = beg; r < end; r++)
+         {
+            const int i = ready[r];
+            for (int k = I[i]; k < I[i+1]; k++)
+            {
+               const int j = J[k];
+               if (round[j] < 0 && IsReady(j) && FirstColoredNow(j) == i)
+               {
+                  my_next.push_back(j);
+               }
+            }
+         }
+         Barrier(num_threads);
+
+         if (id == 0)
+         {
+            Merge(num_threads);
+            cur_round++;
+         }
+         Barrier(num_threads);
+      }
+   }
+
+   static void WorkerThread(void *arg, int id, int n)
+   {
+      ((JonesPlassmann *)arg)->Work(id, n);
+   }
+
+public:
+   JonesPlassmann(const Table &el_to_el, unsigned _seed, int *colors,
+                  int nthreads)
+      : I(el_to_el.GetI()), J(el_to_el.GetJ()), seed(_seed), color(colors),
+        max_threads(nthreads)
+   {
+      prio.resize(el_to_el.Size());
+      round.assign(el_to_el.Size(), -1);
+      next.resize(max_threads);
+      cur_round = 0;
+      done = false;
+      barrier_count = barrier_gen = 0;
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond, NULL);
+   }
+
+   void Run() { RunThreads(WorkerThread, this, max_threads); }
+
+   ~JonesPlassmann()
+   {
+      pthread_cond_destroy(&cond);
+      pthread_mutex_destroy(&mutex);
+   }
+};
+
+void GetElementColoringParallel(Mesh *mesh, Array<int> &colors,
+                                unsigned seed, int num_threads)
+{
+   if (num_threads <= 0)
+   {
+      num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   // at least 10000 elements per thread
+   num_threads = std::max(1, std::min(num_threads, mesh->GetNE()/10000 + 1));
+
+   const Table &el_to_el = mesh->ElementToElementTable();
+
+   colors.SetSize(mesh->GetNE());
+   colors = -1;
+
+   JonesPlassmann jp(el_to_el, seed, colors.GetData(), num_threads);
+   jp.Run();
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_COLORING
+#define GLVIS_COLORING
+
+#include <mfem.hpp>
+
+// Color the elements of the mesh so that face-neighbors have different colors,
+// using the Jones-Plassmann algorithm with 'num_threads' threads (0 means the
+// number of online processors). The element priorities are a hash of the
+// element index and 'seed', so for a given seed the result does not depend on
+// the number of threads. The number of colors is at most the maximal number of
+// face-neighbors plus one.
+void GetElementColoringParallel(mfem::Mesh *mesh, mfem::Array<int> &colors,
+                                unsigned seed, int num_threads = 0);
+
+#endif
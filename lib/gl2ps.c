@@ -50,6 +50,11 @@
 #include <png.h>
 #endif
 
+#if !defined(_WIN32) && !defined(GL2PS_NO_THREADS)
+#define GL2PS_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 /*********************************************************************
  *
  * Private definitions, data structures and prototypes
@@ -60,6 +65,14 @@
    coordinates is 10^3) */
 
 #define GL2PS_EPSILON       5.0e-3F
+
+/* Parallel sorting: lists with fewer primitives than GL2PS_PAR_MIN_PRIMS are
+   sorted serially; the BSP tree is built with up to 2^GL2PS_PAR_BSP_DEPTH
+   threads and the simple sort uses GL2PS_PAR_SORT_THREADS threads */
+
+#define GL2PS_PAR_MIN_PRIMS    20000
+#define GL2PS_PAR_BSP_DEPTH    3
+#define GL2PS_PAR_SORT_THREADS 8
 #define GL2PS_ZSCALE        1000.0F
 #define GL2PS_ZOFFSET       5.0e-2F
 #define GL2PS_ZOFFSET_LARGE 20.0F
@@ -588,6 +601,111 @@ static void gl2psListSort(GL2PSlist *list,
   qsort(list->array, list->n, list->size, fcmp);
 }
 
+#if defined(GL2PS_HAVE_PTHREADS)
+
+typedef struct {
+  char *array;
+  GLint n, size;
+  int (*fcmp)(const void *a, const void *b);
+} GL2PSsortchunk;
+
+static void *gl2psSortChunk(void *data)
+{
+  GL2PSsortchunk *chunk = (GL2PSsortchunk*)data;
+  qsort(chunk->array, chunk->n, chunk->size, chunk->fcmp);
+  return NULL;
+}
+
+/* Merge the sorted ranges [a, a+na) and [b, b+nb) into dest */
+static void gl2psMergeChunks(char *a, GLint na, char *b, GLint nb, char *dest,
+                             GLint size,
+                             int (*fcmp)(const void *a, const void *b))
+{
+  char *ea = a + na * size, *eb = b + nb * size;
+
+  while(a < ea && b < eb){
+    if(fcmp(b, a) < 0){
+      memcpy(dest, b, size);
+      b += size;
+    }
+    else{
+      memcpy(dest, a, size);
+      a += size;
+    }
+    dest += size;
+  }
+  if(a < ea) memcpy(dest, a, ea - a);
+  if(b < eb) memcpy(dest, b, eb - b);
+}
+
+/* Same as gl2psListSort, but large lists are cut into chunks which are sorted
+   in parallel and then merged */
+static void gl2psListSortParallel(GL2PSlist *list,
+                                  int (*fcmp)(const void *a, const void *b))
+{
+  GL2PSsortchunk chunks[GL2PS_PAR_SORT_THREADS];
+  pthread_t threads[GL2PS_PAR_SORT_THREADS];
+  int started[GL2PS_PAR_SORT_THREADS];
+  GLint offset[GL2PS_PAR_SORT_THREADS + 1];
+  GLint i, nchunks = GL2PS_PAR_SORT_THREADS, width, mid, end;
+  size_t size;
+  char *tmp, *src, *dst, *swap;
+
+  if(!list)
+    return;
+  if(list->n < GL2PS_PAR_MIN_PRIMS){
+    gl2psListSort(list, fcmp);
+    return;
+  }
+  size = list->size;
+  tmp = (char*)malloc((size_t)list->n * size);
+  if(!tmp){
+    gl2psListSort(list, fcmp);
+    return;
+  }
+
+  for(i = 0; i <= nchunks; i++){
+    offset[i] = (GLint)(((double)list->n * i) / nchunks);
+  }
+  for(i = 0; i < nchunks; i++){
+    chunks[i].array = list->array + offset[i] * size;
+    chunks[i].n = offset[i + 1] - offset[i];
+    chunks[i].size = list->size;
+    chunks[i].fcmp = fcmp;
+    started[i] = !pthread_create(&threads[i], NULL, gl2psSortChunk, &chunks[i]);
+    if(!started[i])
+      gl2psSortChunk(&chunks[i]);
+  }
+  for(i = 0; i < nchunks; i++){
+    if(started[i])
+      pthread_join(threads[i], NULL);
+  }
+
+  /* merge neighboring runs of sorted chunks, alternating between the list
+     array and the temporary buffer */
+  src = list->array;
+  dst = tmp;
+  for(width = 1; width < nchunks; width *= 2){
+    for(i = 0; i < nchunks; i += 2 * width){
+      mid = (i + width < nchunks) ? offset[i + width] : list->n;
+      end = (i + 2 * width < nchunks) ? offset[i + 2 * width] : list->n;
+      gl2psMergeChunks(src + offset[i] * size, mid - offset[i],
+                       src + mid * size, end - mid,
+                       dst + offset[i] * size, list->size, fcmp);
+    }
+    swap = src; src = dst; dst = swap;
+  }
+  if(src != list->array)
+    memcpy(list->array, src, (size_t)list->n * size);
+  free(tmp);
+}
+
+#else
+
+#define gl2psListSortParallel gl2psListSort
+
+#endif
+
 static void gl2psListAction(GL2PSlist *list, void (*action)(void *data))
 {
   GLint i;
@@ -1512,11 +1630,39 @@ static GLboolean gl2psLess(GLfloat f1, GLfloat f2)
   else return GL_FALSE;
 }
 
-static void gl2psBuildBspTree(GL2PSbsptree *tree, GL2PSlist *primitives)
+static void gl2psBuildBspTreeLevel(GL2PSbsptree *tree, GL2PSlist *primitives,
+                                   int level);
+
+#if defined(GL2PS_HAVE_PTHREADS)
+
+typedef struct {
+  GL2PSbsptree *tree;
+  GL2PSlist *primitives;
+  int level;
+} GL2PSbsptask;
+
+static void *gl2psBuildBspTreeTask(void *data)
+{
+  GL2PSbsptask *task = (GL2PSbsptask*)data;
+  gl2psBuildBspTreeLevel(task->tree, task->primitives, task->level);
+  return NULL;
+}
+
+#endif
+
+/* Build the BSP tree; the front and back subtrees of the first
+   GL2PS_PAR_BSP_DEPTH levels are built in parallel */
+static void gl2psBuildBspTreeLevel(GL2PSbsptree *tree, GL2PSlist *primitives,
+                                   int level)
 {
   GL2PSprimitive *prim, *frontprim = NULL, *backprim = NULL;
   GL2PSlist *frontlist, *backlist;
   GLint i, index;
+#if defined(GL2PS_HAVE_PTHREADS)
+  GL2PSbsptask front_task;
+  pthread_t front_thread;
+  int front_started = 0;
+#endif
 
   tree->front = NULL;
   tree->back = NULL;
@@ -1550,6 +1696,10 @@ static void gl2psBuildBspTree(GL2PSbsptree *tree, GL2PSlist *primitives)
     }
   }
 
+  /* all the primitives are now in the front/back lists: free the input list
+     before recursing so that it is not kept in memory for the whole build */
+  gl2psListDelete(primitives);
+
   if(gl2psListNbr(tree->primitives)){
     gl2psListSort(tree->primitives, gl2psTrianglesFirst);
   }
@@ -1557,7 +1707,19 @@ static void gl2psBuildBspTree(GL2PSbsptree *tree, GL2PSlist *primitives)
   if(gl2psListNbr(frontlist)){
     gl2psListSort(frontlist, gl2psTrianglesFirst);
     tree->front = (GL2PSbsptree*)gl2psMalloc(sizeof(GL2PSbsptree));
-    gl2psBuildBspTree(tree->front, frontlist);
+#if defined(GL2PS_HAVE_PTHREADS)
+    if(level < GL2PS_PAR_BSP_DEPTH &&
+       gl2psListNbr(frontlist) >= GL2PS_PAR_MIN_PRIMS &&
+       gl2psListNbr(backlist) >= GL2PS_PAR_MIN_PRIMS){
+      front_task.tree = tree->front;
+      front_task.primitives = frontlist;
+      front_task.level = level + 1;
+      front_started = !pthread_create(&front_thread, NULL,
+                                      gl2psBuildBspTreeTask, &front_task);
+    }
+    if(!front_started)
+#endif
+      gl2psBuildBspTreeLevel(tree->front, frontlist, level + 1);
   }
   else{
     gl2psListDelete(frontlist);
@@ -1566,13 +1728,21 @@ static void gl2psBuildBspTree(GL2PSbsptree *tree, GL2PSlist *primitives)
   if(gl2psListNbr(backlist)){
     gl2psListSort(backlist, gl2psTrianglesFirst);
     tree->back = (GL2PSbsptree*)gl2psMalloc(sizeof(GL2PSbsptree));
-    gl2psBuildBspTree(tree->back, backlist);
+    gl2psBuildBspTreeLevel(tree->back, backlist, level + 1);
   }
   else{
     gl2psListDelete(backlist);
   }
 
-  gl2psListDelete(primitives);
+#if defined(GL2PS_HAVE_PTHREADS)
+  if(front_started)
+    pthread_join(front_thread, NULL);
+#endif
+}
+
+static void gl2psBuildBspTree(GL2PSbsptree *tree, GL2PSlist *primitives)
+{
+  gl2psBuildBspTreeLevel(tree, primitives, 0);
 }
 
 static void gl2psTraverseBspTree(GL2PSbsptree *tree, GL2PSxyz eye, GLfloat epsilon,
@@ -5523,7 +5693,7 @@ static GLint gl2psPrintPrimitives(void)
     gl2psListReset(gl2ps->primitives);
     break;
   case GL2PS_SIMPLE_SORT :
-    gl2psListSort(gl2ps->primitives, gl2psCompareDepth);
+    gl2psListSortParallel(gl2ps->primitives, gl2psCompareDepth);
     if(gl2ps->options & GL2PS_OCCLUSION_CULL){
       gl2psListActionInverse(gl2ps->primitives, gl2psAddInImageTree);
       gl2psFreeBspImageTree(&gl2ps->imagetree);
@@ -18,6 +18,7 @@
 #endif
 
 #include "gl2ps.h"
+#include "softrender.hpp"
 
 extern int visualize;
 extern int GetMultisample();
@@ -355,6 +356,7 @@ void Set_Transparency()
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
    }
    glDepthMask(GL_FALSE);
+   MarkRenderState();
 }
 
 void Remove_Transparency()
@@ -365,6 +367,7 @@ void Remove_Transparency()
       gl2psDisable(GL2PS_BLEND);
    }
    glDepthMask(GL_TRUE);
+   MarkRenderState();
 }
 
 int Get_AntiAliasing()
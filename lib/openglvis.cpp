@@ -126,7 +126,7 @@ VisualizationScene::VisualizationScene()
    glRotatef(-40.0, 0.0f, 0.0f, 1.0f);
    glGetDoublev (GL_MODELVIEW_MATRIX, rotmat);
    xscale = yscale = zscale = 1;
-   spinning = print = movie = 0;
+   spinning = print = movie = moving = 0;
    OrthogonalProjection = 0;
    ViewAngle = 45;
    ViewScale = 1;
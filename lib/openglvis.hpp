@@ -110,6 +110,8 @@ public:
    virtual ~VisualizationScene();
 
    int spinning, OrthogonalProjection, print, movie;
+   // Set while the view is moved with the mouse.
+   int moving;
    double ViewAngle, ViewScale;
    double ViewCenterX, ViewCenterY;
 
@@ -139,6 +141,14 @@ public:
 
    void ModelView();
 
+   /// Show the data at the point drawn at the window coordinates (wx, wy) of
+   /// the last frame, with the origin at the top left corner of the window.
+   virtual void ProbeWindowPoint(int wx, int wy) { }
+
+   /// Wait for the parts of the scene which are prepared in the background,
+   /// e.g. before a screenshot. Returns true if the scene has to be redrawn.
+   virtual bool FinishPrepare() { return false; }
+
    /// This is set by SetVisualizationScene
    int view;
 };
@@ -0,0 +1,248 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "pointlocator.hpp"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+using namespace mfem;
+
+PointLocator::PointLocator(Mesh *mesh_)
+   : mesh(mesh_)
+{
+   dim = mesh->Dimension();
+   const int ne = mesh->GetNE();
+   if (dim != mesh->SpaceDimension() || ne == 0)
+   {
+      dim = 0;
+      return;
+   }
+
+   // bounding boxes of the elements; for curved elements use a refined set of
+   // points and pad the boxes since the element may bulge between them
+   const bool curved = (mesh->GetNodes() != NULL);
+   GeometryRefiner refiner;
+   IsoparametricTransformation T;
+   DenseMatrix pm;
+   Array<int> vertices;
+   double xmin[3], xmax[3];
+   for (int d = 0; d < dim; d++)
+   {
+      xmin[d] = numeric_limits<double>::infinity();
+      xmax[d] = -xmin[d];
+   }
+   boxes.SetSize(2*dim*ne);
+   for (int e = 0; e < ne; e++)
+   {
+      double *box = &boxes[2*dim*e];
+      if (curved)
+      {
+         RefinedGeometry *RefG =
+            refiner.Refine(mesh->GetElementBaseGeometry(e), 3);
+         mesh->GetElementTransformation(e, &T);
+         T.Transform(RefG->RefPts, pm);
+      }
+      else
+      {
+         mesh->GetPointMatrix(e, pm);
+      }
+      for (int d = 0; d < dim; d++)
+      {
+         double a = pm(d,0), b = pm(d,0);
+         for (int j = 1; j < pm.Width(); j++)
+         {
+            a = min(a, pm(d,j));
+            b = max(b, pm(d,j));
+         }
+         const double pad = 1e-8*(b - a) + (curved ? 0.05*(b - a) : 0.0);
+         box[2*d] = a - pad;
+         box[2*d+1] = b + pad;
+         xmin[d] = min(xmin[d], box[2*d]);
+         xmax[d] = max(xmax[d], box[2*d+1]);
+      }
+   }
+
+   // about one element per cell
+   double vol = 1.0;
+   for (int d = 0; d < dim; d++)
+   {
+      vol *= max(xmax[d] - xmin[d], 1e-300);
+   }
+   const double hc = pow(vol/ne, 1.0/dim);
+   int ncells = 1;
+   for (int d = 0; d < 3; d++)
+   {
+      if (d < dim)
+      {
+         nc[d] = (int) min(max(ceil((xmax[d] - xmin[d])/hc), 1.0), 1024.0);
+         x0[d] = xmin[d];
+         h[d] = (xmax[d] - xmin[d])/nc[d];
+         if (h[d] <= 0.0) { h[d] = 1.0; }
+      }
+      else
+      {
+         nc[d] = 1;
+         x0[d] = 0.0;
+         h[d] = 1.0;
+      }
+      ncells *= nc[d];
+   }
+
+   // bin the boxes in two passes: count, then fill
+   cell_offsets.SetSize(ncells+1);
+   cell_offsets = 0;
+   for (int pass = 0; pass < 2; pass++)
+   {
+      for (int e = 0; e < ne; e++)
+      {
+         const double *box = &boxes[2*dim*e];
+         double lo[3] = { 0.0, 0.0, 0.0 }, hi[3] = { 0.0, 0.0, 0.0 };
+         for (int d = 0; d < dim; d++)
+         {
+            lo[d] = box[2*d];
+            hi[d] = box[2*d+1];
+         }
+         int c0[3], c1[3];
+         GetCell(lo, c0);
+         GetCell(hi, c1);
+         for (int k = c0[2]; k <= c1[2]; k++)
+            for (int j = c0[1]; j <= c1[1]; j++)
+               for (int i = c0[0]; i <= c1[0]; i++)
+               {
+                  const int c = (k*nc[1] + j)*nc[0] + i;
+                  if (pass == 0)
+                  {
+                     cell_offsets[c+1]++;
+                  }
+                  else
+                  {
+                     cell_elements[cell_offsets[c+1]++] = e;
+                  }
+               }
+      }
+      if (pass == 0)
+      {
+         for (int c = 0; c < ncells; c++)
+         {
+            cell_offsets[c+1] += cell_offsets[c];
+         }
+         cell_elements.SetSize(cell_offsets[ncells]);
+         // shift the offsets so that cell_offsets[c+1] is the start of cell c
+         // during the second pass and its end afterwards
+         for (int c = ncells; c > 0; c--)
+         {
+            cell_offsets[c] = cell_offsets[c-1];
+         }
+      }
+   }
+}
+
+void PointLocator::GetCell(const double *x, int *c) const
+{
+   for (int d = 0; d < 3; d++)
+   {
+      if (d < dim)
+      {
+         int i = (int) floor((x[d] - x0[d])/h[d]);
+         c[d] = (i < 0) ? 0 : (i >= nc[d]) ? nc[d]-1 : i;
+      }
+      else
+      {
+         c[d] = 0;
+      }
+   }
+}
+
+bool PointLocator::InBox(int e, const double *x) const
+{
+   const double *box = &boxes[2*dim*e];
+   for (int d = 0; d < dim; d++)
+   {
+      if (x[d] < box[2*d] || x[d] > box[2*d+1])
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+void PointLocator::GetCandidates(const double *x, const int *&elems,
+                                 int &n) const
+{
+   n = 0;
+   elems = NULL;
+   if (dim == 0)
+   {
+      return;
+   }
+   for (int d = 0; d < dim; d++)
+   {
+      if (x[d] < x0[d] || x[d] > x0[d] + nc[d]*h[d])
+      {
+         return;
+      }
+   }
+   int c[3];
+   GetCell(x, c);
+   const int cell = (c[2]*nc[1] + c[1])*nc[0] + c[0];
+   n = cell_offsets[cell+1] - cell_offsets[cell];
+   elems = cell_elements.GetData() + cell_offsets[cell];
+}
+
+void PointLocator::GetBoundingBox(double *bmin, double *bmax) const
+{
+   for (int d = 0; d < dim; d++)
+   {
+      bmin[d] = x0[d];
+      bmax[d] = x0[d] + nc[d]*h[d];
+   }
+}
+
+bool PointLocator::InElement(int e, const double *x, IntegrationPoint &ip) const
+{
+   if (!InBox(e, x))
+   {
+      return false;
+   }
+
+   IsoparametricTransformation T;
+   mesh->GetElementTransformation(e, &T);
+   InverseElementTransformation inv_tr(&T);
+   Vector pt(const_cast<double*>(x), dim);
+   return (inv_tr.Transform(pt, ip) == InverseElementTransformation::Inside);
+}
+
+int PointLocator::FindPoint(const double *x, IntegrationPoint &ip,
+                            int hint) const
+{
+   if (dim == 0)
+   {
+      return -1;
+   }
+   if (hint >= 0 && hint < mesh->GetNE() && InElement(hint, x, ip))
+   {
+      return hint;
+   }
+
+   const int *elems;
+   int n;
+   GetCandidates(x, elems, n);
+   for (int k = 0; k < n; k++)
+   {
+      if (elems[k] != hint && InElement(elems[k], x, ip))
+      {
+         return elems[k];
+      }
+   }
+   return -1;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_POINTLOCATOR
+#define GLVIS_POINTLOCATOR
+
+#include <mfem.hpp>
+
+// Finds the element containing a given physical point. The bounding boxes of
+// the elements are binned in a uniform grid with about one element per cell,
+// so a query only inverts the transformations of the few elements whose boxes
+// contain the point. Only meshes with Dimension() == SpaceDimension() are
+// supported. The mesh must not be modified while the locator is in use.
+class PointLocator
+{
+private:
+   mfem::Mesh *mesh;
+   int dim;
+
+   // grid: nc[d] cells of size h[d] in direction d, starting at x0[d]
+   int nc[3];
+   double x0[3], h[3];
+   // the elements whose boxes intersect cell c are
+   // cell_elements[cell_offsets[c] ... cell_offsets[c+1]-1]
+   mfem::Array<int> cell_offsets, cell_elements;
+   // the bounding box of element e is boxes[2*dim*e ... 2*dim*e+2*dim-1],
+   // stored as (min_0, max_0, min_1, max_1, ...)
+   mfem::Array<double> boxes;
+
+   void GetCell(const double *x, int *c) const;
+
+public:
+   PointLocator(mfem::Mesh *mesh_);
+
+   // Returns true if the locator can be used with its mesh.
+   bool Valid() const { return (dim > 0); }
+
+   // Returns the index of an element containing the point 'x' (with
+   // SpaceDimension() coordinates) and the reference coordinates of the point
+   // in 'ip', or -1 if the point is outside the mesh. If 'hint' is a valid
+   // element index, that element is checked first.
+   int FindPoint(const double *x, mfem::IntegrationPoint &ip,
+                 int hint = -1) const;
+
+   // Check if the point 'x' is in element 'e', returning its reference
+   // coordinates in 'ip'.
+   bool InElement(int e, const double *x, mfem::IntegrationPoint &ip) const;
+
+   // The elements whose bounding boxes may contain the point 'x'. Together
+   // with InBox() this can be used with a custom (e.g. thread safe) test for
+   // points inside elements instead of FindPoint() and InElement().
+   void GetCandidates(const double *x, const int *&elems, int &n) const;
+   bool InBox(int e, const double *x) const;
+
+   // The box containing all elements.
+   void GetBoundingBox(double *bmin, double *bmax) const;
+
+   mfem::Mesh *GetMesh() const { return mesh; }
+};
+
+#endif
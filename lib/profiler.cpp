@@ -0,0 +1,211 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "profiler.hpp"
+#include <pthread.h>
+#include <sys/time.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+struct StageStats
+{
+   int count;
+   double total, max, last;
+};
+
+static pthread_mutex_t profiler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static map<string, StageStats> profiler_stats;
+
+static ofstream trace_file;
+static bool trace_csv = false, trace_first = true;
+
+// small sequential thread numbers for the trace, in the order in which the
+// threads record their first interval
+static pthread_key_t thread_num_key;
+static pthread_once_t thread_num_once = PTHREAD_ONCE_INIT;
+static long num_threads = 0;
+
+static double WallTime()
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static const double start_time = WallTime();
+
+static void InitThreadNum()
+{
+   pthread_key_create(&thread_num_key, NULL);
+}
+
+// called with profiler_mutex locked
+static long ThreadNum()
+{
+   pthread_once(&thread_num_once, InitThreadNum);
+   long num = (long)pthread_getspecific(thread_num_key);
+   if (num == 0)
+   {
+      num = ++num_threads;
+      pthread_setspecific(thread_num_key, (void *)num);
+   }
+   return num;
+}
+
+double ProfilerTime()
+{
+   return WallTime() - start_time;
+}
+
+void ProfilerRecord(const char *name, double start, double end)
+{
+   const double t = end - start;
+
+   pthread_mutex_lock(&profiler_mutex);
+   StageStats &s = profiler_stats[name];
+   if (s.count == 0 || t > s.max) { s.max = t; }
+   s.count++;
+   s.total += t;
+   s.last = t;
+
+   if (trace_file.is_open())
+   {
+      const long ts = (long)(1e6*start), dur = (long)(1e6*t);
+      if (trace_csv)
+      {
+         trace_file << name << ',' << ThreadNum() << ',' << ts << ',' << dur
+                    << '\n';
+      }
+      else
+      {
+         trace_file << (trace_first ? "" : ",\n")
+                    << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,"
+                    << "\"tid\":" << ThreadNum() << ",\"ts\":" << ts
+                    << ",\"dur\":" << dur << '}';
+      }
+      trace_first = false;
+   }
+   pthread_mutex_unlock(&profiler_mutex);
+}
+
+static bool ByTotal(const pair<string, StageStats> &a,
+                    const pair<string, StageStats> &b)
+{
+   return (a.second.total > b.second.total);
+}
+
+int ProfilerPrint(ostream &out, int max_rows)
+{
+   pthread_mutex_lock(&profiler_mutex);
+   vector<pair<string, StageStats> > rows(profiler_stats.begin(),
+                                          profiler_stats.end());
+   pthread_mutex_unlock(&profiler_mutex);
+
+   sort(rows.begin(), rows.end(), ByTotal);
+   if (max_rows >= 0 && (int)rows.size() > max_rows)
+   {
+      rows.resize(max_rows);
+   }
+
+   size_t w = 5;
+   for (size_t i = 0; i < rows.size(); i++)
+   {
+      w = max(w, rows[i].first.size());
+   }
+   ios::fmtflags flags = out.flags();
+   const streamsize prec = out.precision();
+   out << left << setw(w) << "stage" << right << setw(8) << "count"
+       << setw(12) << "total_ms" << setw(10) << "avg_ms" << setw(10)
+       << "max_ms" << setw(10) << "last_ms" << '\n'
+       << fixed << setprecision(3);
+   for (size_t i = 0; i < rows.size(); i++)
+   {
+      const StageStats &s = rows[i].second;
+      out << left << setw(w) << rows[i].first << right << setw(8) << s.count
+          << setw(12) << 1e3*s.total << setw(10) << 1e3*s.total/s.count
+          << setw(10) << 1e3*s.max << setw(10) << 1e3*s.last << '\n';
+   }
+   out.flags(flags);
+   out.precision(prec);
+   out << flush;
+   return (int)rows.size();
+}
+
+int ProfilerGetStage(const char *name, double *total, double *max)
+{
+   pthread_mutex_lock(&profiler_mutex);
+   map<string, StageStats>::const_iterator it = profiler_stats.find(name);
+   StageStats s = { 0, 0.0, 0.0, 0.0 };
+   if (it != profiler_stats.end())
+   {
+      s = it->second;
+   }
+   pthread_mutex_unlock(&profiler_mutex);
+
+   if (total) { *total = s.total; }
+   if (max) { *max = s.max; }
+   return s.count;
+}
+
+void ProfilerReset()
+{
+   pthread_mutex_lock(&profiler_mutex);
+   profiler_stats.clear();
+   pthread_mutex_unlock(&profiler_mutex);
+}
+
+int ProfilerOpenTrace(const char *fname)
+{
+   ProfilerCloseTrace();
+
+   pthread_mutex_lock(&profiler_mutex);
+   const size_t len = strlen(fname);
+   trace_csv = (len >= 4 && strcmp(fname + len - 4, ".csv") == 0);
+   trace_first = true;
+   trace_file.open(fname);
+   const bool good = trace_file.good();
+   if (good)
+   {
+      trace_file << (trace_csv ? "name,thread,start_us,duration_us\n" : "[\n");
+   }
+   else
+   {
+      trace_file.close();
+   }
+   pthread_mutex_unlock(&profiler_mutex);
+
+   static bool registered = false;
+   if (good && !registered)
+   {
+      atexit(ProfilerCloseTrace);
+      registered = true;
+   }
+   return good ? 0 : 1;
+}
+
+void ProfilerCloseTrace()
+{
+   pthread_mutex_lock(&profiler_mutex);
+   if (trace_file.is_open())
+   {
+      if (!trace_csv) { trace_file << "\n]\n"; }
+      trace_file.close();
+   }
+   pthread_mutex_unlock(&profiler_mutex);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_PROFILER
+#define GLVIS_PROFILER
+
+#include <iostream>
+#include <cstddef>
+
+// Wall-clock timing of the main stages of GLVis: preparing and drawing the
+// scenes, screenshots, parsing the input streams and executing the commands
+// received from them. The statistics of each named stage are kept in memory.
+// If a trace file is open, every timed interval is also written to it. All
+// functions can be called from any thread.
+
+// Seconds since the start of the program
+double ProfilerTime();
+
+// Record the interval from 'start' to 'end' (in ProfilerTime() seconds) under
+// the name 'name', which is copied.
+void ProfilerRecord(const char *name, double start, double end);
+
+// Times its own lifetime. The name is not copied until the timer is
+// destroyed, so it is usually a string literal.
+class ProfileTimer
+{
+private:
+   const char *name;
+   double start;
+
+public:
+   ProfileTimer(const char *name_) : name(name_), start(ProfilerTime()) { }
+   ~ProfileTimer() { ProfilerRecord(name, start, ProfilerTime()); }
+};
+
+// Print a table with the name, the number of calls and the total, average,
+// maximal and last time in milliseconds of the stages, sorted by the total
+// time, with at most 'max_rows' rows (all if negative). The names contain no
+// spaces, so the columns can be split at whitespace. Returns the number of
+// rows.
+int ProfilerPrint(std::ostream &out, int max_rows = -1);
+
+// Return the number of calls of the stage 'name' and, if not NULL, their total
+// and maximal time in seconds.
+int ProfilerGetStage(const char *name, double *total = NULL,
+                     double *max = NULL);
+
+// Clear the statistics.
+void ProfilerReset();
+
+// Write every timed interval to the file 'fname': in the Chrome trace event
+// format (JSON, for chrome://tracing or Perfetto) or, if the name ends with
+// ".csv", as lines of "name,thread,start,duration" in microseconds. The file
+// is completed at exit. Returns 0 on success.
+int ProfilerOpenTrace(const char *fname);
+void ProfilerCloseTrace();
+
+#endif
@@ -0,0 +1,275 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "refinedvalues.hpp"
+#include <sys/time.h>
+#include <cerrno>
+
+using namespace mfem;
+
+RefinedValues::RefinedValues()
+   : gf(NULL), times(0), etimes(0), fec(NULL), nfec(NULL), state(NONE),
+     finished(false), cancel(false)
+{
+   for (int g = 0; g < Geometry::NumGeom; g++) { refs[g] = NULL; }
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&cond, NULL);
+}
+
+RefinedValues::~RefinedValues()
+{
+   Clear();
+   pthread_cond_destroy(&cond);
+   pthread_mutex_destroy(&mutex);
+}
+
+bool RefinedValues::Supported(GridFunction *gf)
+{
+   FiniteElementSpace *fes = gf->FESpace();
+   Mesh *mesh = fes->GetMesh();
+   if (mesh->Dimension() != 2 || mesh->SpaceDimension() != 2 ||
+       mesh->GetNE() == 0 || mesh->NURBSext || fes->GetNURBSext() ||
+       fes->GetVDim() != 1)
+   {
+      return false;
+   }
+   for (int i = 0; i < mesh->GetNE(); i++)
+   {
+      if (mesh->GetElementBaseGeometry(i) != Geometry::TRIANGLE)
+      {
+         return false;
+      }
+   }
+   const FiniteElement *fe = fes->GetFE(0);
+   return (fe->GetRangeType() == FiniteElement::SCALAR &&
+           fe->GetMapType() == FiniteElement::VALUE);
+}
+
+void RefinedValues::Start(GridFunction *gf_, GeometryRefiner &refiner,
+                          int times_, int etimes_)
+{
+   Clear();
+
+   gf = gf_;
+   times = times_;
+   etimes = etimes_;
+
+   // the refiner is not thread safe, so refine the geometries here
+   Mesh *mesh = gf->FESpace()->GetMesh();
+   const int ne = mesh->GetNE();
+   offsets.SetSize(ne+1);
+   offsets[0] = 0;
+   for (int i = 0; i < ne; i++)
+   {
+      const int geom = mesh->GetElementBaseGeometry(i);
+      if (refs[geom] == NULL)
+      {
+         refs[geom] = refiner.Refine(geom, times, etimes);
+      }
+      offsets[i+1] = offsets[i] + refs[geom]->RefPts.GetNPoints();
+   }
+   data.SetSize(5*offsets[ne]);
+
+   // The finite elements keep scratch data, so the thread uses copies of the
+   // collections. Their constructors fill the global caches of 1D bases and
+   // points, so create them here.
+   fec = FiniteElementCollection::New(gf->FESpace()->FEColl()->Name());
+   GridFunction *nodes = mesh->GetNodes();
+   if (nodes)
+   {
+      nfec = FiniteElementCollection::New(nodes->FESpace()->FEColl()->Name());
+   }
+   else
+   {
+      nfec = new H1_FECollection(1, 2);
+   }
+
+   finished = false;
+   cancel = false;
+   state = RUNNING;
+   if (pthread_create(&tid, NULL, ComputeThread, this))
+   {
+      // no thread available, compute the values now
+      Compute();
+      finished = true;
+      state = DONE;
+   }
+}
+
+void *RefinedValues::ComputeThread(void *arg)
+{
+   RefinedValues *rv = (RefinedValues *)arg;
+
+   rv->Compute();
+
+   pthread_mutex_lock(&rv->mutex);
+   rv->finished = true;
+   pthread_cond_broadcast(&rv->cond);
+   pthread_mutex_unlock(&rv->mutex);
+
+   return NULL;
+}
+
+void RefinedValues::Compute()
+{
+   Mesh *mesh = gf->FESpace()->GetMesh();
+   GridFunction *nodes = mesh->GetNodes();
+
+   IsoparametricTransformation T;
+   Array<int> dofs;
+   Vector loc, shape, x(2), gref(2), g(2);
+   DenseMatrix dshape, Jinv(2);
+
+   for (int i = 0; i < mesh->GetNE() && !cancel; i++)
+   {
+      const int geom = mesh->GetElementBaseGeometry(i);
+
+      // the transformation of element i, as in Mesh::GetElementTransformation
+      const FiniteElement *nfe = nfec->FiniteElementForGeometry(geom);
+      DenseMatrix &pm = T.GetPointMat();
+      if (nodes)
+      {
+         const int nd = nfe->GetDof();
+         nodes->FESpace()->GetElementVDofs(i, dofs);
+         nodes->GetSubVector(dofs, loc);
+         pm.SetSize(2, nd);
+         for (int d = 0; d < 2; d++)
+         {
+            for (int j = 0; j < nd; j++)
+            {
+               pm(d,j) = loc(d*nd + j);
+            }
+         }
+      }
+      else
+      {
+         mesh->GetPointMatrix(i, pm);
+      }
+      T.SetFE(nfe);
+      T.Attribute = mesh->GetAttribute(i);
+      T.ElementNo = i;
+
+      const FiniteElement *fe = fec->FiniteElementForGeometry(geom);
+      const int nd = fe->GetDof();
+      gf->FESpace()->GetElementVDofs(i, dofs);
+      gf->GetSubVector(dofs, loc);
+      shape.SetSize(nd);
+      dshape.SetSize(nd, 2);
+
+      const IntegrationRule &ir = refs[geom]->RefPts;
+      double *p = data.GetData() + 5*offsets[i];
+      for (int j = 0; j < ir.GetNPoints(); j++, p += 5)
+      {
+         const IntegrationPoint &ip = ir.IntPoint(j);
+         T.SetIntPoint(&ip);
+         T.Transform(ip, x);
+         fe->CalcShape(ip, shape);
+         fe->CalcDShape(ip, dshape);
+         dshape.MultTranspose(loc, gref);
+         CalcInverse(T.Jacobian(), Jinv);
+         Jinv.MultTranspose(gref, g);
+         p[0] = x(0);
+         p[1] = x(1);
+         p[2] = shape * loc;
+         p[3] = g(0);
+         p[4] = g(1);
+      }
+   }
+}
+
+bool RefinedValues::Wait(double seconds)
+{
+   if (state != RUNNING)
+   {
+      return (state == DONE);
+   }
+
+   pthread_mutex_lock(&mutex);
+   if (seconds < 0.0)
+   {
+      while (!finished)
+      {
+         pthread_cond_wait(&cond, &mutex);
+      }
+   }
+   else if (!finished && seconds > 0.0)
+   {
+      struct timeval now;
+      struct timespec until;
+      gettimeofday(&now, NULL);
+      double t = now.tv_sec + 1e-6*now.tv_usec + seconds;
+      until.tv_sec = (time_t)t;
+      until.tv_nsec = (long)(1e9*(t - until.tv_sec));
+      while (!finished &&
+             pthread_cond_timedwait(&cond, &mutex, &until) != ETIMEDOUT) { }
+   }
+   bool done = finished;
+   pthread_mutex_unlock(&mutex);
+
+   if (done)
+   {
+      pthread_join(tid, NULL);
+      state = DONE;
+   }
+   return done;
+}
+
+void RefinedValues::Clear()
+{
+   if (state == RUNNING)
+   {
+      cancel = true;
+      pthread_join(tid, NULL);
+   }
+   state = NONE;
+   delete nfec;
+   delete fec;
+   nfec = fec = NULL;
+   for (int g = 0; g < Geometry::NumGeom; g++) { refs[g] = NULL; }
+   offsets.DeleteAll();
+   data.DeleteAll();
+}
+
+bool RefinedValues::Lookup(int i, const IntegrationRule &ir, Vector &vals,
+                           DenseMatrix &tr, DenseMatrix *normals) const
+{
+   if (state != DONE || i >= offsets.Size()-1)
+   {
+      return false;
+   }
+   const int geom = gf->FESpace()->GetMesh()->GetElementBaseGeometry(i);
+   if (refs[geom] == NULL || &refs[geom]->RefPts != &ir)
+   {
+      return false;
+   }
+
+   const int npts = offsets[i+1] - offsets[i];
+   const double *p = data.GetData() + 5*offsets[i];
+   vals.SetSize(npts);
+   tr.SetSize(2, npts);
+   if (normals)
+   {
+      normals->SetSize(3, npts);
+   }
+   for (int j = 0; j < npts; j++, p += 5)
+   {
+      tr(0, j) = p[0];
+      tr(1, j) = p[1];
+      vals(j) = p[2];
+      if (normals)
+      {
+         (*normals)(0, j) = -p[3];
+         (*normals)(1, j) = -p[4];
+         (*normals)(2, j) = 1.;
+      }
+   }
+   return true;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_REFINEDVALUES
+#define GLVIS_REFINEDVALUES
+
+#include <mfem.hpp>
+#include <pthread.h>
+
+// The values and gradients of a scalar GridFunction on a 2D triangle mesh at
+// the points of the refined elements, computed by a background thread, so
+// that the window stays responsive while a large or highly refined solution is
+// prepared. The results are exactly what GridFunction::GetValues() and
+// GridFunction::GetGradients() return for the same points; they can be used
+// by the main thread once Wait() returns true. The mesh and the GridFunction
+// must not be modified or deleted while the computation is running, call
+// Clear() first.
+class RefinedValues
+{
+private:
+   mfem::GridFunction *gf;
+   int times, etimes;
+   // copies of the collections of 'gf' and of the mesh nodes for the thread
+   mfem::FiniteElementCollection *fec, *nfec;
+   // the refined geometries for each Geometry::Type present in the mesh
+   const mfem::RefinedGeometry *refs[mfem::Geometry::NumGeom];
+
+   // the data of the npts points of element i, 5 doubles per point (x, y,
+   // value, du/dx, du/dy), is data[5*offsets[i] ... 5*offsets[i+1]-1]
+   mfem::Array<int> offsets;
+   mfem::Array<double> data;
+
+   enum { NONE, RUNNING, DONE };
+   int state;
+   pthread_t tid;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   bool finished;
+   volatile bool cancel;
+
+   void Compute();
+   static void *ComputeThread(void *arg);
+
+public:
+   RefinedValues();
+   ~RefinedValues();
+
+   // Returns true if the values of 'gf' can be computed in the background:
+   // scalar, non-NURBS spaces with point values on planar triangle meshes.
+   // The triangle elements evaluate their 1D bases with the static
+   // Poly_1D::CalcBasis(); the tensor product elements of quadrilaterals use
+   // the bases shared with the main thread, which keep scratch data.
+   static bool Supported(mfem::GridFunction *gf);
+
+   // Start computing the values of 'gf' at the points of the geometries
+   // refined by 'refiner' with the factors 'times_' and 'etimes_'. A running
+   // computation is cancelled first.
+   void Start(mfem::GridFunction *gf_, mfem::GeometryRefiner &refiner,
+              int times_, int etimes_);
+
+   // True if the last Start() was for the given refinement factors.
+   bool Matches(int times_, int etimes_) const
+   { return (state != NONE && times == times_ && etimes == etimes_); }
+   bool Running() const { return (state == RUNNING); }
+
+   // Wait up to 'seconds' (forever if negative) for the computation to finish.
+   // Returns true if the values are available.
+   bool Wait(double seconds);
+
+   // Stop a running computation. The values of a finished one are kept.
+   void Cancel() { if (state == RUNNING) { Clear(); } }
+   // Stop a running computation and drop the values.
+   void Clear();
+
+   // Copy the values, the point coordinates and the normals (-du/dx, -du/dy,
+   // 1) of element i, if they were computed for the points 'ir'. Returns false
+   // if the values are not available.
+   bool Lookup(int i, const mfem::IntegrationRule &ir, mfem::Vector &vals,
+               mfem::DenseMatrix &tr, mfem::DenseMatrix *normals) const;
+};
+
+#endif
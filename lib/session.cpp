@@ -0,0 +1,347 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>  // gettimeofday
+#include <unistd.h>    // usleep
+
+#include "mfem.hpp"
+using namespace mfem;
+using namespace std;
+
+#include "session.hpp"
+
+static const char session_magic[] = "glvis-session";
+
+static double GetTime()
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+SessionRecorder::SessionRecorder(const char *fname)
+   : file(fname, ios::out | ios::binary)
+{
+   file << session_magic << '\n';
+   start_time = GetTime();
+   num_streams = 0;
+   pthread_mutex_init(&rec_mutex, NULL);
+}
+
+void SessionRecorder::Record(istream &is)
+{
+   recordbuf *rb = new recordbuf(this, is.rdbuf(), num_streams++);
+   streams.Append(&is);
+   bufs.Append(rb);
+   is.rdbuf(rb);
+}
+
+void SessionRecorder::SetRank(istream &is, int rank)
+{
+   for (int i = 0; i < streams.Size(); i++)
+   {
+      if (streams[i] == &is)
+      {
+         const int stream = bufs[i]->Id(), size = -1;
+         double t = GetTime() - start_time;
+         pthread_mutex_lock(&rec_mutex);
+         file.write((const char *)&t, sizeof(t));
+         file.write((const char *)&stream, sizeof(stream));
+         file.write((const char *)&size, sizeof(size));
+         file.write((const char *)&rank, sizeof(rank));
+         pthread_mutex_unlock(&rec_mutex);
+         return;
+      }
+   }
+}
+
+void SessionRecorder::Start()
+{
+   for (int i = 0; i < streams.Size(); i++)
+   {
+      bufs[i]->Start();
+   }
+}
+
+void SessionRecorder::Detach()
+{
+   for (int i = 0; i < streams.Size(); i++)
+   {
+      bufs[i]->Stop();
+      streams[i]->rdbuf(bufs[i]->source());
+   }
+   streams.DeleteAll();
+}
+
+void SessionRecorder::Write(int stream, const char *data, int size)
+{
+   double t = GetTime() - start_time;
+   pthread_mutex_lock(&rec_mutex);
+   file.write((const char *)&t, sizeof(t));
+   file.write((const char *)&stream, sizeof(stream));
+   file.write((const char *)&size, sizeof(size));
+   file.write(data, size);
+   pthread_mutex_unlock(&rec_mutex);
+}
+
+void SessionRecorder::Flush()
+{
+   pthread_mutex_lock(&rec_mutex);
+   file.flush();
+   pthread_mutex_unlock(&rec_mutex);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+   // the recorded streams must be deleted or detached by now
+   for (int i = 0; i < bufs.Size(); i++)
+   {
+      delete bufs[i];
+   }
+   file.close();
+   pthread_mutex_destroy(&rec_mutex);
+}
+
+SessionRecorder::recordbuf::recordbuf(SessionRecorder *r, streambuf *s,
+                                      int id)
+   : rec(r), src(s), stream(id), started(false), at_eof(false)
+{
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&cond, NULL);
+}
+
+SessionRecorder::recordbuf::~recordbuf()
+{
+   Stop();
+   pthread_cond_destroy(&cond);
+   pthread_mutex_destroy(&mutex);
+}
+
+streamsize SessionRecorder::recordbuf::Fetch(char *data, streamsize size)
+{
+   if (src->sgetc() == traits_type::eof())
+   {
+      return 0;
+   }
+   // take only what is already buffered, so that we never block waiting for
+   // more data than the sender has written
+   streamsize n = src->in_avail();
+   if (n <= 0 || n > size)
+   {
+      n = (n <= 0) ? 1 : size;
+   }
+   n = src->sgetn(data, n);
+   if (n > 0)
+   {
+      rec->Write(stream, data, n);
+   }
+   return (n > 0) ? n : 0;
+}
+
+void *SessionRecorder::recordbuf::ReadThread(void *arg)
+{
+   recordbuf *rb = (recordbuf *)arg;
+   char data[4096];
+
+   // Stop() cancels the thread only while it waits for data
+   pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+   streamsize n;
+   do
+   {
+      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+      rb->src->sgetc();
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+      n = rb->Fetch(data, sizeof(data));
+
+      pthread_mutex_lock(&rb->mutex);
+      rb->pending.insert(rb->pending.end(), data, data + n);
+      rb->at_eof = (n == 0);
+      pthread_cond_broadcast(&rb->cond);
+      pthread_mutex_unlock(&rb->mutex);
+   }
+   while (n > 0);
+
+   return NULL;
+}
+
+void SessionRecorder::recordbuf::Start()
+{
+   if (!started && !at_eof)
+   {
+      // without a thread the data is recorded when GLVis reads it
+      started = !pthread_create(&tid, NULL, ReadThread, this);
+   }
+}
+
+void SessionRecorder::recordbuf::Stop()
+{
+   if (started)
+   {
+      pthread_cancel(tid);
+      pthread_join(tid, NULL);
+      started = false;
+   }
+}
+
+static void UnlockMutex(void *mutex)
+{
+   pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+SessionRecorder::recordbuf::int_type SessionRecorder::recordbuf::underflow()
+{
+   if (!started)
+   {
+      const streamsize n = Fetch(buf, sizeof(buf));
+      if (n == 0)
+      {
+         at_eof = true;
+         return traits_type::eof();
+      }
+      setg(buf, buf, buf + n);
+      return traits_type::to_int_type(buf[0]);
+   }
+
+   // the reading thread may be cancelled while waiting here
+   size_t n;
+   pthread_mutex_lock(&mutex);
+   pthread_cleanup_push(UnlockMutex, &mutex);
+   while (pending.empty() && !at_eof)
+   {
+      pthread_cond_wait(&cond, &mutex);
+   }
+   n = min(pending.size(), sizeof(buf));
+   copy(pending.begin(), pending.begin() + n, buf);
+   pending.erase(pending.begin(), pending.begin() + n);
+   pthread_cleanup_pop(1);
+
+   if (n == 0)
+   {
+      return traits_type::eof();
+   }
+   setg(buf, buf, buf + n);
+   return traits_type::to_int_type(buf[0]);
+}
+
+SessionRecorder::recordbuf::int_type
+SessionRecorder::recordbuf::overflow(int_type c)
+{
+   if (traits_type::eq_int_type(c, traits_type::eof()))
+   {
+      return traits_type::not_eof(c);
+   }
+   return src->sputc(traits_type::to_char_type(c));
+}
+
+streamsize SessionRecorder::recordbuf::xsputn(const char *s,
+                                               streamsize n)
+{
+   return src->sputn(s, n);
+}
+
+int SessionRecorder::recordbuf::sync()
+{
+   return src->pubsync();
+}
+
+int ReplaySession(const char *fname, const char *host, int port,
+                  bool realtime)
+{
+   ifstream ifs(fname, ios::in | ios::binary);
+   string magic;
+   getline(ifs, magic);
+   if (!ifs || magic != session_magic)
+   {
+      cout << "Not a GLVis session file: " << fname << endl;
+      return 1;
+   }
+
+   Array<socketstream *> socks;
+   Array<int> ranks; // the processor of each connection, -1 if serial
+   vector<char> data;
+   double t, start_time = GetTime();
+   int stream, size;
+   long bytes = 0;
+   while (ifs.read((char *)&t, sizeof(t)) &&
+          ifs.read((char *)&stream, sizeof(stream)) &&
+          ifs.read((char *)&size, sizeof(size)))
+   {
+      if (stream < 0 || size < -1)
+      {
+         cout << "Corrupted session file: " << fname << endl;
+         break;
+      }
+      if (size == -1)
+      {
+         int rank;
+         if (!ifs.read((char *)&rank, sizeof(rank)))
+         {
+            break;
+         }
+         if (stream >= ranks.Size())
+         {
+            const int old_size = ranks.Size();
+            ranks.SetSize(stream+1);
+            for (int i = old_size; i < ranks.Size(); i++) { ranks[i] = -1; }
+         }
+         ranks[stream] = rank;
+         continue;
+      }
+      data.resize(size);
+      if (!ifs.read(&data[0], size))
+      {
+         break;
+      }
+      while (stream >= socks.Size())
+      {
+         socketstream *sock = new socketstream(host, port);
+         if (!sock->is_open())
+         {
+            cout << "Can not connect to " << host << ':' << port << endl;
+            delete sock;
+            for (int i = 0; i < socks.Size(); i++) { delete socks[i]; }
+            return 2;
+         }
+         socks.Append(sock);
+      }
+      if (realtime)
+      {
+         double wait = t - (GetTime() - start_time);
+         if (wait > 0.0)
+         {
+            usleep((useconds_t)(1e6*wait));
+         }
+      }
+      socks[stream]->write(&data[0], size);
+      socks[stream]->flush();
+      bytes += size;
+   }
+
+   double elapsed = GetTime() - start_time;
+   cout << "Replayed " << bytes << " bytes on " << socks.Size()
+        << " connection(s) in " << elapsed << " s" << endl;
+   for (int i = 0; i < ranks.Size(); i++)
+   {
+      if (ranks[i] >= 0)
+      {
+         cout << "   connection " << i << ": processor " << ranks[i] << endl;
+      }
+   }
+   for (int i = 0; i < socks.Size(); i++)
+   {
+      socks[i]->close();
+      delete socks[i];
+   }
+   return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_SESSION
+#define GLVIS_SESSION
+
+#include <mfem.hpp>
+#include <fstream>
+#include <streambuf>
+#include <deque>
+#include <pthread.h>
+
+// Records all the bytes read from the socket connections of one GLVis session
+// into a single file. The file starts with the line "glvis-session" followed
+// by records of the form
+//    <double time> <int stream> <int size> <size bytes>
+// where 'time' is the number of seconds since the start of the session and
+// 'stream' is the index of the connection in the order it was accepted. A
+// record with 'size' equal to -1 is followed by a single <int rank> instead:
+// the connection belongs to processor 'rank' of a parallel session.
+//
+// Once Start() is called, every connection is read by its own thread as soon
+// as the data arrives, so the recorded times are those of the sender even if
+// GLVis is busy. The data is kept in memory until GLVis reads it.
+class SessionRecorder
+{
+private:
+   std::ofstream file;
+   double start_time;
+   int num_streams;
+   pthread_mutex_t rec_mutex;
+
+   class recordbuf : public std::streambuf
+   {
+   private:
+      SessionRecorder *rec;
+      std::streambuf *src;
+      int stream;
+      char buf[4096];
+
+      // filled by the reader thread, see Start()
+      bool started, at_eof;
+      pthread_t tid;
+      pthread_mutex_t mutex;
+      pthread_cond_t cond;
+      std::deque<char> pending;
+
+      // read the available data from 'src', waiting for at least one byte,
+      // and record it; returns the number of bytes, 0 at the end of the data
+      std::streamsize Fetch(char *data, std::streamsize size);
+      static void *ReadThread(void *arg);
+
+   protected:
+      virtual int_type underflow();
+      // replies written to the socket go straight to the wrapped buffer
+      virtual int_type overflow(int_type c);
+      virtual std::streamsize xsputn(const char *s, std::streamsize n);
+      virtual int sync();
+
+   public:
+      recordbuf(SessionRecorder *r, std::streambuf *s, int id);
+
+      int Id() const { return stream; }
+      std::streambuf *source() { return src; }
+
+      // start and stop reading 'src' on a separate thread
+      void Start();
+      void Stop();
+
+      ~recordbuf();
+   };
+
+   mfem::Array<std::istream *> streams;
+   mfem::Array<recordbuf *> bufs;
+
+public:
+   SessionRecorder(const char *fname);
+
+   bool good() { return file.good(); }
+
+   // Redirect the reading from 'is' through the recorder. The original stream
+   // buffer of 'is' is still used to read the data and must outlive 'is'.
+   void Record(std::istream &is);
+
+   // Note that the recorded stream 'is' comes from processor 'rank'.
+   void SetRank(std::istream &is, int rank);
+
+   // Read all recorded streams on separate threads from now on. Threads do not
+   // survive fork(), so call this in the process that shows the session.
+   void Start();
+
+   // Stop the threads and restore the original stream buffers of all recorded
+   // streams. Data that has been received but not read is dropped.
+   void Detach();
+
+   void Write(int stream, const char *data, int size);
+
+   // Flush the file, e.g. before fork()
+   void Flush();
+
+   ~SessionRecorder();
+};
+
+// Send the data recorded in a session file to a GLVis server, opening one
+// connection for each recorded stream. If 'realtime' is true, the original
+// timing of the session is reproduced, otherwise the data is sent as fast as
+// possible. Returns 0 on success.
+int ReplaySession(const char *fname, const char *host, int port,
+                  bool realtime);
+
+#endif
@@ -0,0 +1,618 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "simplify.hpp"
+#include <unistd.h>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+
+using namespace std;
+
+// The quadric error Q(v) = v^T A v + 2 b^T v + c of a point v in R^4 (the
+// position and the scaled value), i.e. the sum of the squared distances from v
+// to the planes of a set of triangles in R^4, weighted by their areas.
+struct Quadric
+{
+   double A[4][4], b[4], c, area;
+
+   void Clear()
+   {
+      for (int i = 0; i < 4; i++)
+      {
+         for (int j = 0; j < 4; j++) { A[i][j] = 0.0; }
+         b[i] = 0.0;
+      }
+      c = area = 0.0;
+   }
+
+   void Add(const Quadric &q)
+   {
+      for (int i = 0; i < 4; i++)
+      {
+         for (int j = 0; j < 4; j++) { A[i][j] += q.A[i][j]; }
+         b[i] += q.b[i];
+      }
+      c += q.c;
+      area += q.area;
+   }
+
+   // See M. Garland and P. Heckbert, "Simplifying surfaces with color and
+   // texture using quadric error metrics", IEEE Visualization 1998.
+   void AddTriangle(const double *p, const double *q, const double *r)
+   {
+      double e1[4], e2[4], l1 = 0.0, l2 = 0.0, d = 0.0;
+      for (int i = 0; i < 4; i++)
+      {
+         e1[i] = q[i] - p[i];
+         l1 += e1[i]*e1[i];
+      }
+      l1 = sqrt(l1);
+      if (l1 == 0.0) { return; }
+      for (int i = 0; i < 4; i++)
+      {
+         e1[i] /= l1;
+         e2[i] = r[i] - p[i];
+         d += e1[i]*e2[i];
+      }
+      for (int i = 0; i < 4; i++)
+      {
+         e2[i] -= d*e1[i];
+         l2 += e2[i]*e2[i];
+      }
+      l2 = sqrt(l2);
+      if (l2 == 0.0) { return; }
+      double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+      for (int i = 0; i < 4; i++)
+      {
+         e2[i] /= l2;
+         pe1 += p[i]*e1[i];
+         pe2 += p[i]*e2[i];
+         pp += p[i]*p[i];
+      }
+      const double w = 0.5*l1*l2;
+      for (int i = 0; i < 4; i++)
+      {
+         for (int j = 0; j < 4; j++)
+         {
+            A[i][j] += w*((i == j) - e1[i]*e1[j] - e2[i]*e2[j]);
+         }
+         b[i] += w*(pe1*e1[i] + pe2*e2[i] - p[i]);
+      }
+      c += w*(pp - pe1*pe1 - pe2*pe2);
+      area += w;
+   }
+
+   // The mean squared distance from v to the planes
+   double Error(const double *v) const
+   {
+      double e = c;
+      for (int i = 0; i < 4; i++)
+      {
+         double Av = 0.0;
+         for (int j = 0; j < 4; j++) { Av += A[i][j]*v[j]; }
+         e += v[i]*Av + 2.0*b[i]*v[i];
+      }
+      return (area > 0.0) ? max(e, 0.0)/area : 0.0;
+   }
+
+   // Find the point with the smallest error; returns false if it is not unique
+   bool Minimize(double *v) const
+   {
+      double M[4][5];
+      for (int i = 0; i < 4; i++)
+      {
+         for (int j = 0; j < 4; j++) { M[i][j] = A[i][j]; }
+         M[i][4] = -b[i];
+      }
+      const double tol = 1e-8*area;
+      for (int k = 0; k < 4; k++)
+      {
+         int p = k;
+         for (int i = k+1; i < 4; i++)
+         {
+            if (fabs(M[i][k]) > fabs(M[p][k])) { p = i; }
+         }
+         if (fabs(M[p][k]) <= tol) { return false; }
+         for (int j = k; j < 5; j++) { swap(M[k][j], M[p][j]); }
+         for (int i = k+1; i < 4; i++)
+         {
+            const double f = M[i][k]/M[k][k];
+            for (int j = k; j < 5; j++) { M[i][j] -= f*M[k][j]; }
+         }
+      }
+      for (int i = 3; i >= 0; i--)
+      {
+         double s = M[i][4];
+         for (int j = i+1; j < 4; j++) { s -= M[i][j]*v[j]; }
+         v[i] = s/M[i][i];
+      }
+      return true;
+   }
+};
+
+// The welded mesh of one chunk and its edge collapses
+class ChunkMesh
+{
+private:
+   struct Vertex
+   {
+      double p[4], n[3], val;
+      Quadric q;
+      unsigned stamp;
+      bool locked, dead;
+      vector<int> tris;
+   };
+
+   // A candidate collapse of the edge (v,w); the heap is ordered by the
+   // smallest error first.
+   struct Collapse
+   {
+      double error;
+      int v, w;
+      unsigned sv, sw;
+      bool operator<(const Collapse &o) const { return (error > o.error); }
+   };
+
+   struct Corner
+   {
+      double key[4];
+      int id;
+      bool operator<(const Corner &o) const
+      {
+         for (int i = 0; i < 4; i++)
+         {
+            if (key[i] != o.key[i]) { return (key[i] < o.key[i]); }
+         }
+         return false;
+      }
+   };
+
+   double value_scale;
+   vector<Vertex> verts;
+   vector<int> tv;
+   vector<bool> tdead;
+   int live;
+   priority_queue<Collapse> heap;
+
+   bool HasVertex(int t, int v) const
+   {
+      return (tv[3*t] == v || tv[3*t+1] == v || tv[3*t+2] == v);
+   }
+
+   void GetNeighbors(int v, vector<int> &nbrs) const
+   {
+      nbrs.clear();
+      const vector<int> &tris = verts[v].tris;
+      for (size_t i = 0; i < tris.size(); i++)
+      {
+         for (int k = 0; k < 3; k++)
+         {
+            const int u = tv[3*tris[i]+k];
+            if (u != v) { nbrs.push_back(u); }
+         }
+      }
+      sort(nbrs.begin(), nbrs.end());
+   }
+
+   // Choose the vertex to keep and its new position; returns false if the
+   // edge can not be collapsed.
+   bool Plan(int &v, int &w, double *x, double &error) const
+   {
+      if (verts[w].locked) { swap(v, w); }
+      if (verts[w].locked) { return false; }
+
+      const Vertex &a = verts[v], &b = verts[w];
+      Quadric q = a.q;
+      q.Add(b.q);
+      if (a.locked)
+      {
+         for (int i = 0; i < 4; i++) { x[i] = a.p[i]; }
+      }
+      else if (!q.Minimize(x))
+      {
+         double mid[4];
+         for (int i = 0; i < 4; i++) { mid[i] = 0.5*(a.p[i] + b.p[i]); }
+         const double *best = a.p;
+         if (q.Error(b.p) < q.Error(best)) { best = b.p; }
+         if (q.Error(mid) < q.Error(best)) { best = mid; }
+         for (int i = 0; i < 4; i++) { x[i] = best[i]; }
+      }
+      error = q.Error(x);
+      return true;
+   }
+
+   void Push(int v, int w)
+   {
+      Collapse c;
+      double x[4];
+      if (!Plan(v, w, x, c.error)) { return; }
+      c.v = v;
+      c.w = w;
+      c.sv = verts[v].stamp;
+      c.sw = verts[w].stamp;
+      heap.push(c);
+   }
+
+   // Moving 'v' and 'w' to 'x' must not flip or squash the triangles which do
+   // not contain both of them.
+   bool Folds(int v, int w, const double *x) const
+   {
+      const int vw[2] = { v, w };
+      for (int s = 0; s < 2; s++)
+      {
+         const vector<int> &tris = verts[vw[s]].tris;
+         for (size_t i = 0; i < tris.size(); i++)
+         {
+            const int t = tris[i];
+            if (HasVertex(t, vw[1-s])) { continue; }
+            const double *p[3], *q[3];
+            for (int k = 0; k < 3; k++)
+            {
+               p[k] = verts[tv[3*t+k]].p;
+               q[k] = (tv[3*t+k] == vw[s]) ? x : p[k];
+            }
+            double n0[3], n1[3];
+            Normal(p, n0);
+            Normal(q, n1);
+            const double d = n0[0]*n1[0] + n0[1]*n1[1] + n0[2]*n1[2];
+            const double l0 = n0[0]*n0[0] + n0[1]*n0[1] + n0[2]*n0[2];
+            const double l1 = n1[0]*n1[0] + n1[1]*n1[1] + n1[2]*n1[2];
+            if (d <= 0.2*sqrt(l0*l1) || l1 <= 1e-6*l0) { return true; }
+         }
+      }
+      return false;
+   }
+
+   static void Normal(const double *p[3], double *n)
+   {
+      double a[3], b[3];
+      for (int d = 0; d < 3; d++)
+      {
+         a[d] = p[1][d] - p[0][d];
+         b[d] = p[2][d] - p[0][d];
+      }
+      n[0] = a[1]*b[2] - a[2]*b[1];
+      n[1] = a[2]*b[0] - a[0]*b[2];
+      n[2] = a[0]*b[1] - a[1]*b[0];
+   }
+
+   bool TryCollapse(int v, int w, vector<int> &nv, vector<int> &nw)
+   {
+      double x[4], error;
+      if (!Plan(v, w, x, error)) { return false; }
+
+      // link condition: v and w have exactly two common neighbors, the
+      // opposite vertices of the two triangles sharing the edge
+      int shared = 0;
+      const vector<int> &wt = verts[w].tris;
+      for (size_t i = 0; i < wt.size(); i++)
+      {
+         if (HasVertex(wt[i], v)) { shared++; }
+      }
+      if (shared != 2) { return false; }
+      GetNeighbors(v, nv);
+      GetNeighbors(w, nw);
+      nv.erase(unique(nv.begin(), nv.end()), nv.end());
+      nw.erase(unique(nw.begin(), nw.end()), nw.end());
+      int common = 0;
+      for (size_t i = 0, j = 0; i < nv.size() && j < nw.size(); )
+      {
+         if (nv[i] < nw[j]) { i++; }
+         else if (nw[j] < nv[i]) { j++; }
+         else { common++; i++; j++; }
+      }
+      if (common != 2 || Folds(v, w, x)) { return false; }
+
+      Vertex &a = verts[v], &b = verts[w];
+      for (size_t i = 0; i < wt.size(); i++)
+      {
+         const int t = wt[i];
+         if (HasVertex(t, v))
+         {
+            tdead[t] = true;
+            live--;
+            continue;
+         }
+         for (int k = 0; k < 3; k++)
+         {
+            if (tv[3*t+k] == w) { tv[3*t+k] = v; }
+         }
+         a.tris.push_back(t);
+      }
+      size_t j = 0;
+      for (size_t i = 0; i < a.tris.size(); i++)
+      {
+         if (!tdead[a.tris[i]]) { a.tris[j++] = a.tris[i]; }
+      }
+      a.tris.resize(j);
+
+      if (!a.locked)
+      {
+         double s = 0.0;
+         for (int d = 0; d < 3; d++)
+         {
+            a.n[d] += b.n[d];
+            s += a.n[d]*a.n[d];
+         }
+         s = (s > 0.0) ? 1.0/sqrt(s) : 0.0;
+         for (int d = 0; d < 3; d++) { a.n[d] *= s; }
+         if (value_scale > 0.0) { a.val = x[3]/value_scale; }
+         for (int i = 0; i < 4; i++) { a.p[i] = x[i]; }
+      }
+      a.q.Add(b.q);
+      a.stamp++;
+      b.dead = true;
+      vector<int>().swap(b.tris);
+
+      GetNeighbors(v, nv);
+      nv.erase(unique(nv.begin(), nv.end()), nv.end());
+      for (size_t i = 0; i < nv.size(); i++) { Push(v, nv[i]); }
+      return true;
+   }
+
+public:
+   // Weld the corners of the triangles 'tris' of the soup and prepare the
+   // quadrics and the candidate collapses.
+   ChunkMesh(const float *soup, const vector<int> &tris, double tol,
+             double value_scale_)
+      : value_scale(value_scale_)
+   {
+      // sort the corners by their quantized position and value
+      const int nc = 3*(int)tris.size();
+      vector<Corner> corners(nc);
+      for (int i = 0; i < nc; i++)
+      {
+         const float *c = soup + 7*(3*(long)tris[i/3] + i%3);
+         for (int d = 0; d < 3; d++)
+         {
+            corners[i].key[d] = floor(c[d]/tol + 0.5);
+         }
+         corners[i].key[3] = floor(value_scale*c[6]/tol + 0.5);
+         corners[i].id = i;
+      }
+      sort(corners.begin(), corners.end());
+
+      tv.resize(nc);
+      for (int i = 0; i < nc; i++)
+      {
+         if (i == 0 || corners[i-1] < corners[i])
+         {
+            const float *c = soup + 7*(3*(long)tris[corners[i].id/3] +
+                                       corners[i].id%3);
+            Vertex vtx;
+            for (int d = 0; d < 3; d++)
+            {
+               vtx.p[d] = c[d];
+               vtx.n[d] = 0.0;
+            }
+            vtx.p[3] = value_scale*c[6];
+            vtx.val = c[6];
+            vtx.q.Clear();
+            vtx.stamp = 0;
+            vtx.locked = vtx.dead = false;
+            verts.push_back(vtx);
+         }
+         const int v = (int)verts.size() - 1;
+         const float *c = soup + 7*(3*(long)tris[corners[i].id/3] +
+                                    corners[i].id%3);
+         for (int d = 0; d < 3; d++) { verts[v].n[d] += c[3+d]; }
+         tv[corners[i].id] = v;
+      }
+      vector<Corner>().swap(corners);
+
+      const int nt = (int)tris.size();
+      tdead.assign(nt, false);
+      live = 0;
+      for (int t = 0; t < nt; t++)
+      {
+         const int *u = &tv[3*t];
+         if (u[0] == u[1] || u[1] == u[2] || u[2] == u[0])
+         {
+            tdead[t] = true;
+            continue;
+         }
+         live++;
+         Quadric q;
+         q.Clear();
+         q.AddTriangle(verts[u[0]].p, verts[u[1]].p, verts[u[2]].p);
+         for (int k = 0; k < 3; k++)
+         {
+            verts[u[k]].tris.push_back(t);
+            verts[u[k]].q.Add(q);
+         }
+      }
+
+      // lock the vertices on open boundaries (including the chunk border)
+      // and on non-manifold edges: each edge must be in exactly 2 triangles
+      vector<int> nbrs;
+      for (size_t v = 0; v < verts.size(); v++)
+      {
+         Vertex &vtx = verts[v];
+         double s = 0.0;
+         for (int d = 0; d < 3; d++) { s += vtx.n[d]*vtx.n[d]; }
+         s = (s > 0.0) ? 1.0/sqrt(s) : 0.0;
+         for (int d = 0; d < 3; d++) { vtx.n[d] *= s; }
+
+         GetNeighbors(v, nbrs);
+         for (size_t i = 0; i < nbrs.size(); )
+         {
+            size_t j = i;
+            while (j < nbrs.size() && nbrs[j] == nbrs[i]) { j++; }
+            if (j - i != 2) { vtx.locked = true; }
+            i = j;
+         }
+      }
+
+      for (int t = 0; t < nt; t++)
+      {
+         if (tdead[t]) { continue; }
+         for (int k = 0; k < 3; k++)
+         {
+            const int a = tv[3*t+k], b = tv[3*t+(k+1)%3];
+            if (a < b) { Push(a, b); }
+         }
+      }
+   }
+
+   int GetNLive() const { return live; }
+
+   // Collapse edges until at most 'target' triangles are left, or the error
+   // of the next collapse exceeds 'max_error_2' (if positive).
+   void Simplify(int target, double max_error_2)
+   {
+      vector<int> nv, nw;
+      while (live > target && !heap.empty())
+      {
+         const Collapse c = heap.top();
+         if (max_error_2 > 0.0 && c.error > max_error_2) { break; }
+         heap.pop();
+         if (verts[c.v].dead || verts[c.w].dead ||
+             verts[c.v].stamp != c.sv || verts[c.w].stamp != c.sw)
+         {
+            continue;
+         }
+         TryCollapse(c.v, c.w, nv, nw);
+      }
+   }
+
+   void GetTriangles(SurfaceSimplifier::Triangles &out) const
+   {
+      out.clear();
+      out.reserve(21*live);
+      for (size_t t = 0; t < tdead.size(); t++)
+      {
+         if (tdead[t]) { continue; }
+         for (int k = 0; k < 3; k++)
+         {
+            const Vertex &vtx = verts[tv[3*t+k]];
+            for (int d = 0; d < 3; d++) { out.push_back(vtx.p[d]); }
+            for (int d = 0; d < 3; d++) { out.push_back(vtx.n[d]); }
+            out.push_back(vtx.val);
+         }
+      }
+   }
+};
+
+
+SurfaceSimplifier::SurfaceSimplifier()
+   : ratio(1.0), max_error(0.0), value_scale(0.0), weld_tol(0.0)
+{ }
+
+void SurfaceSimplifier::AddCorner(const double *v, const double *n,
+                                  double val)
+{
+   for (int d = 0; d < 3; d++) { soup.push_back(v[d]); }
+   for (int d = 0; d < 3; d++) { soup.push_back(n[d]); }
+   soup.push_back(val);
+}
+
+void SurfaceSimplifier::AddTriangle(const double v[][3], const double n[][3],
+                                    double val)
+{
+   for (int k = 0; k < 3; k++) { AddCorner(v[k], n[k], val); }
+}
+
+void SurfaceSimplifier::AddQuad(const double v[][3], const double n[][3],
+                                double val)
+{
+   static const int ind[6] = { 0, 1, 2, 0, 2, 3 };
+   for (int k = 0; k < 6; k++) { AddCorner(v[ind[k]], n[ind[k]], val); }
+}
+
+void SurfaceSimplifier::SimplifyChunk(int c)
+{
+   if (chunk_tris[c].empty()) { return; }
+
+   ChunkMesh mesh(&soup[0], chunk_tris[c], weld_tol, value_scale);
+   vector<int>().swap(chunk_tris[c]);
+
+   const int target = (int)ceil(ratio*mesh.GetNLive());
+   mesh.Simplify(target, max_error*max_error);
+   mesh.GetTriangles(chunks[c]);
+}
+
+void SurfaceSimplifier::WorkerThread(void *arg, int, int)
+{
+   SurfaceSimplifier *ss = (SurfaceSimplifier *)arg;
+   while (1)
+   {
+      const int c = ss->next_chunk.Next();
+      if (c < 0) { break; }
+      ss->SimplifyChunk(c);
+   }
+}
+
+void SurfaceSimplifier::Simplify(int nthreads)
+{
+   const int nt = GetNInputTriangles();
+   chunks.clear();
+   if (nt == 0) { return; }
+
+   if (nthreads <= 0)
+   {
+      nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   // at least 20000 triangles and about 4 chunks per thread
+   const int nc = max(1, min(4*nthreads, nt/20000));
+   int k = 1;
+   while ((k+1)*(k+1)*(k+1) <= nc) { k++; }
+
+   // the bounding box of the corners
+   double bb[3][2];
+   for (int d = 0; d < 3; d++) { bb[d][0] = bb[d][1] = soup[d]; }
+   for (size_t i = 0; i < soup.size(); i += 7)
+   {
+      for (int d = 0; d < 3; d++)
+      {
+         bb[d][0] = min(bb[d][0], (double)soup[i+d]);
+         bb[d][1] = max(bb[d][1], (double)soup[i+d]);
+      }
+   }
+   double diam = 0.0;
+   for (int d = 0; d < 3; d++)
+   {
+      diam += (bb[d][1] - bb[d][0])*(bb[d][1] - bb[d][0]);
+   }
+   diam = sqrt(diam);
+   weld_tol = (diam > 0.0) ? 1e-6*diam : 1e-6;
+
+   // assign the triangles to a k x k x k grid of chunks by their centroids
+   chunk_tris.assign(k*k*k, vector<int>());
+   for (int t = 0; t < nt; t++)
+   {
+      const float *c = &soup[21*(long)t];
+      int ind = 0;
+      for (int d = 0; d < 3; d++)
+      {
+         const double x = (c[d] + c[7+d] + c[14+d])/3.0;
+         const double h = bb[d][1] - bb[d][0];
+         int i = (h > 0.0) ? (int)(k*(x - bb[d][0])/h) : 0;
+         i = min(max(i, 0), k-1);
+         ind = k*ind + i;
+      }
+      chunk_tris[ind].push_back(t);
+   }
+   chunks.assign(k*k*k, Triangles());
+
+   next_chunk.Reset(k*k*k);
+   RunThreads(WorkerThread, this, min(nthreads, k*k*k));
+
+   vector<float>().swap(soup);
+   chunk_tris.clear();
+}
+
+int SurfaceSimplifier::GetNTriangles() const
+{
+   size_t n = 0;
+   for (size_t c = 0; c < chunks.size(); c++) { n += chunks[c].size(); }
+   return (int)(n/21);
+}
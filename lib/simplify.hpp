@@ -0,0 +1,75 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_SIMPLIFY
+#define GLVIS_SIMPLIFY
+
+#include <vector>
+#include "workers.hpp"
+
+// Simplification of a triangle soup, e.g. an extracted level surface, for
+// display. Each corner of a triangle has a position, a normal and a scalar
+// value. The corners are welded into a mesh and its edges are collapsed in the
+// order of the quadric error (Garland-Heckbert) of the positions extended with
+// the scaled scalar value, so flat regions of constant color are simplified
+// first. The work is split into spatial chunks processed in parallel. Chunk
+// borders, open boundaries and non-manifold edges are not changed, so no
+// cracks are introduced.
+class SurfaceSimplifier
+{
+public:
+   // The output triangles, 3 corners of 7 floats each: x, y, z, nx, ny, nz,
+   // value.
+   typedef std::vector<float> Triangles;
+
+private:
+   double ratio, max_error, value_scale;
+   // corners closer than this are welded
+   double weld_tol;
+
+   // the input corners, 7 floats each, as in Triangles
+   std::vector<float> soup;
+
+   std::vector<Triangles> chunks;
+   std::vector<std::vector<int> > chunk_tris;
+
+   WorkCounter next_chunk;
+
+   void AddCorner(const double *v, const double *n, double val);
+   void SimplifyChunk(int c);
+   static void WorkerThread(void *arg, int id, int n);
+
+public:
+   SurfaceSimplifier();
+
+   // Keep about 'ratio_' of the triangles, but stop before the mean distance
+   // of a vertex from its original surface exceeds 'max_error_' (if positive).
+   void SetTarget(double ratio_, double max_error_)
+   { ratio = ratio_; max_error = max_error_; }
+   // The value is multiplied by 'scale' when it is compared to the positions.
+   void SetValueScale(double scale) { value_scale = scale; }
+
+   // Add a triangle with vertices v[i], normals n[i] and constant value.
+   void AddTriangle(const double v[][3], const double n[][3], double val);
+   // Add the quad (v[0],v[1],v[2],v[3]) as two triangles.
+   void AddQuad(const double v[][3], const double n[][3], double val);
+   int GetNInputTriangles() const { return (int)soup.size()/21; }
+
+   // Simplify the soup with 'nthreads' threads (0 means the number of online
+   // processors). The input is released.
+   void Simplify(int nthreads = 0);
+
+   int GetNChunks() const { return (int)chunks.size(); }
+   const Triangles &GetChunk(int c) const { return chunks[c]; }
+   int GetNTriangles() const;
+};
+
+#endif
@@ -0,0 +1,797 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "softrender.hpp"
+#include "profiler.hpp"
+#include "workers.hpp"
+#include <GL/gl.h>
+#include <unistd.h>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+static bool software_rendering = false;
+static bool capturing = false;
+
+// The render state is passed through the feedback buffer as this marker
+// followed by the values written by MarkRenderState().
+static const GLfloat state_marker = 1000.0f;
+static const int num_state_values = 7;
+
+enum
+{
+   STATE_TEX1D = 1, STATE_TEX2D = 2, STATE_BLEND = 4, STATE_DEPTH_TEST = 8,
+   STATE_DEPTH_MASK = 16, STATE_OFFSET_FILL = 32, STATE_LIGHTING = 64
+};
+
+struct SoftState
+{
+   int bits;
+   // the texture names; after the capture, indices in 'textures' or -1
+   int tex1d, tex2d;
+   float offset_factor, offset_units, line_width, point_size;
+};
+
+struct SoftTexture
+{
+   int width, height;
+   // the components which modulate the fragment color
+   bool rgb, alpha;
+   vector<float> texels; // RGBA
+};
+
+// A vertex in window coordinates: x, y, z, the primary color r, g, b, a, the
+// texture coordinates s, t and the specular color r, g, b, which is added
+// after the texturing.
+struct SoftVertex
+{
+   float v[12];
+};
+
+struct SoftTriangle
+{
+   SoftVertex v[3];
+   int state;
+   bool offset; // from a polygon: apply the polygon offset
+};
+
+// The feedback buffers keep the size that was sufficient for the last frame.
+// The second one holds the specular colors of the lit primitives.
+static int feedback_size = 1024*1024;
+static vector<GLfloat> feedback[2];
+
+static vector<SoftState> states;
+static vector<SoftTexture> textures;
+static vector<SoftTriangle> triangles;
+
+static int image_w = 0, image_h = 0;
+static vector<unsigned char> image; // RGB, the bottom row first
+static vector<float> depth_image; // window z, the bottom row first
+
+
+void SetSoftwareRendering(bool on)
+{
+   software_rendering = on;
+}
+
+bool GetSoftwareRendering()
+{
+   return software_rendering;
+}
+
+void MarkRenderState()
+{
+   if (!capturing)
+   {
+      return;
+   }
+   GLint list;
+   glGetIntegerv(GL_LIST_INDEX, &list);
+   if (list != 0)
+   {
+      return; // the state of a display list is not known until it is called
+   }
+
+   GLint tex1d, tex2d;
+   GLboolean depth_mask;
+   GLfloat factor, units, line_width, point_size;
+   glGetIntegerv(GL_TEXTURE_BINDING_1D, &tex1d);
+   glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex2d);
+   glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+   glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &factor);
+   glGetFloatv(GL_POLYGON_OFFSET_UNITS, &units);
+   glGetFloatv(GL_LINE_WIDTH, &line_width);
+   glGetFloatv(GL_POINT_SIZE, &point_size);
+
+   int bits = 0;
+   if (glIsEnabled(GL_TEXTURE_1D)) { bits |= STATE_TEX1D; }
+   if (glIsEnabled(GL_TEXTURE_2D)) { bits |= STATE_TEX2D; }
+   if (glIsEnabled(GL_BLEND)) { bits |= STATE_BLEND; }
+   if (glIsEnabled(GL_DEPTH_TEST)) { bits |= STATE_DEPTH_TEST; }
+   if (depth_mask) { bits |= STATE_DEPTH_MASK; }
+   if (glIsEnabled(GL_POLYGON_OFFSET_FILL)) { bits |= STATE_OFFSET_FILL; }
+   if (glIsEnabled(GL_LIGHTING)) { bits |= STATE_LIGHTING; }
+
+   glPassThrough(state_marker);
+   glPassThrough(bits);
+   glPassThrough(tex1d);
+   glPassThrough(tex2d);
+   glPassThrough(factor);
+   glPassThrough(units);
+   glPassThrough(line_width);
+   glPassThrough(point_size);
+}
+
+// Draw the scene in feedback mode, growing the buffer until it fits. Returns
+// the number of values in the buffer or -1. The feedback contains only the
+// primary colors, so the specular colors, which are added after the texturing,
+// are captured separately: with 'specular' the ambient and diffuse light is
+// turned off and the specular light is moved to the primary colors.
+static GLint CaptureScene(VisualizationScene *scene, bool specular,
+                          vector<GLfloat> &buffer)
+{
+   ProfileTimer timer("SoftwareRender::Capture");
+
+   GLint old_control, num_lights = 0;
+   glGetIntegerv(GL_LIGHT_MODEL_COLOR_CONTROL, &old_control);
+   glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, specular ?
+                 GL_SINGLE_COLOR : GL_SEPARATE_SPECULAR_COLOR);
+   // the global ambient light and the ambient and diffuse light of each light
+   vector<GLfloat> lights;
+   if (specular)
+   {
+      const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+      glGetIntegerv(GL_MAX_LIGHTS, &num_lights);
+      lights.resize(4 + 8*num_lights);
+      glGetFloatv(GL_LIGHT_MODEL_AMBIENT, &lights[0]);
+      glLightModelfv(GL_LIGHT_MODEL_AMBIENT, black);
+      for (int i = 0; i < num_lights; i++)
+      {
+         glGetLightfv(GL_LIGHT0 + i, GL_AMBIENT, &lights[4 + 8*i]);
+         glGetLightfv(GL_LIGHT0 + i, GL_DIFFUSE, &lights[8 + 8*i]);
+         glLightfv(GL_LIGHT0 + i, GL_AMBIENT, black);
+         glLightfv(GL_LIGHT0 + i, GL_DIFFUSE, black);
+      }
+   }
+
+   GLint n;
+   while (1)
+   {
+      buffer.resize(feedback_size);
+      glFeedbackBuffer(feedback_size, GL_3D_COLOR_TEXTURE, &buffer[0]);
+      glRenderMode(GL_FEEDBACK);
+      capturing = true;
+      MarkRenderState();
+      scene->Draw();
+      capturing = false;
+      n = glRenderMode(GL_RENDER);
+      if (n >= 0 || feedback_size > INT_MAX/2)
+      {
+         break;
+      }
+      feedback_size *= 2;
+   }
+
+   if (specular)
+   {
+      glLightModelfv(GL_LIGHT_MODEL_AMBIENT, &lights[0]);
+      for (int i = 0; i < num_lights; i++)
+      {
+         glLightfv(GL_LIGHT0 + i, GL_AMBIENT, &lights[4 + 8*i]);
+         glLightfv(GL_LIGHT0 + i, GL_DIFFUSE, &lights[8 + 8*i]);
+      }
+   }
+   glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, old_control);
+   return n;
+}
+
+// Read the texture 'name' of 'target' into 'textures' and return its index.
+static int FetchTexture(GLenum target, GLint name,
+                        map<pair<GLenum, GLint>, int> &fetched)
+{
+   if (name == 0)
+   {
+      return -1;
+   }
+   map<pair<GLenum, GLint>, int>::iterator it =
+      fetched.find(make_pair(target, name));
+   if (it != fetched.end())
+   {
+      return it->second;
+   }
+
+   GLint bound;
+   glGetIntegerv((target == GL_TEXTURE_1D) ? GL_TEXTURE_BINDING_1D :
+                 GL_TEXTURE_BINDING_2D, &bound);
+   glBindTexture(target, name);
+
+   GLint w = 0, h = 1, format = GL_RGB;
+   glGetTexLevelParameteriv(target, 0, GL_TEXTURE_WIDTH, &w);
+   if (target == GL_TEXTURE_2D)
+   {
+      glGetTexLevelParameteriv(target, 0, GL_TEXTURE_HEIGHT, &h);
+   }
+   glGetTexLevelParameteriv(target, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+   int index = -1;
+   if (w > 0 && h > 0)
+   {
+      index = (int)textures.size();
+      textures.push_back(SoftTexture());
+      SoftTexture &tex = textures.back();
+      tex.width = w;
+      tex.height = h;
+      const bool alpha_only = (format == GL_ALPHA || format == GL_ALPHA4 ||
+                               format == GL_ALPHA8 || format == GL_ALPHA12 ||
+                               format == GL_ALPHA16);
+      tex.rgb = !alpha_only;
+      tex.alpha = (alpha_only || format == 4 || format == GL_RGBA ||
+                   format == GL_RGBA8);
+      tex.texels.resize(4*w*h);
+      glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      glGetTexImage(target, 0, GL_RGBA, GL_FLOAT, &tex.texels[0]);
+      glPopClientAttrib();
+   }
+
+   glBindTexture(target, bound);
+   fetched[make_pair(target, name)] = index;
+   return index;
+}
+
+static void AddTriangle(const SoftVertex &a, const SoftVertex &b,
+                        const SoftVertex &c, int state, bool offset)
+{
+   triangles.push_back(SoftTriangle());
+   SoftTriangle &t = triangles.back();
+   t.v[0] = a;
+   t.v[1] = b;
+   t.v[2] = c;
+   t.state = state;
+   t.offset = offset;
+}
+
+// A screen-aligned square of side 'size' centered at 'p'.
+static void AddPoint(const SoftVertex &p, float size, int state)
+{
+   const float r = 0.5f*max(size, 1.0f);
+   SoftVertex q[4];
+   for (int k = 0; k < 4; k++)
+   {
+      q[k] = p;
+      q[k].v[0] += (k == 1 || k == 2) ? r : -r;
+      q[k].v[1] += (k >= 2) ? r : -r;
+   }
+   AddTriangle(q[0], q[1], q[2], state, false);
+   AddTriangle(q[0], q[2], q[3], state, false);
+}
+
+// A rectangle of the line width along the segment (p,q).
+static void AddLine(const SoftVertex &p, const SoftVertex &q, float width,
+                    int state)
+{
+   const float dx = q.v[0] - p.v[0], dy = q.v[1] - p.v[1];
+   const float len = sqrt(dx*dx + dy*dy);
+   if (len == 0.0f)
+   {
+      AddPoint(p, width, state);
+      return;
+   }
+   const float r = 0.5f*max(width, 1.0f)/len;
+   SoftVertex c[4] = { p, p, q, q };
+   c[0].v[0] -= r*dy; c[0].v[1] += r*dx;
+   c[1].v[0] += r*dy; c[1].v[1] -= r*dx;
+   c[2].v[0] += r*dy; c[2].v[1] -= r*dx;
+   c[3].v[0] -= r*dy; c[3].v[1] += r*dx;
+   AddTriangle(c[0], c[1], c[2], state, false);
+   AddTriangle(c[0], c[2], c[3], state, false);
+}
+
+// Read the vertex at 'f' and, if 'g' is not NULL, its specular color from the
+// same vertex at 'g' in the specular capture.
+static void ReadVertex(const GLfloat *f, const GLfloat *g, SoftVertex &vtx)
+{
+   for (int k = 0; k < 7; k++) { vtx.v[k] = f[k]; }
+   const float q = (f[10] != 0.0f) ? f[10] : 1.0f;
+   vtx.v[7] = f[7]/q;
+   vtx.v[8] = f[8]/q;
+   for (int k = 0; k < 3; k++) { vtx.v[9+k] = g ? g[3+k] : 0.0f; }
+}
+
+// Convert the feedback buffer, 'n' values, to triangles. If 'n2' is not
+// negative, the specular capture has 'n2' values. Returns true if there are
+// lit primitives.
+static bool ParseFeedback(GLint n, GLint n2)
+{
+   states.clear();
+   triangles.clear();
+
+   SoftState rs = { STATE_DEPTH_TEST | STATE_DEPTH_MASK, 0, 0,
+                    0.0f, 0.0f, 1.0f, 1.0f
+                  };
+   int state = -1;
+   bool lit = false;
+   const GLfloat *f = &feedback[0][0];
+   // the specular capture is used while its primitives match
+   const GLfloat *g = (n2 == n) ? &feedback[1][0] : NULL;
+   vector<SoftVertex> poly;
+   for (GLint i = 0; i < n; )
+   {
+      const GLint token = GLint(f[i++]);
+      if (g && (g[i-1] != f[i-1] || g[i] != f[i]))
+      {
+         g = NULL;
+      }
+      if (token == GL_PASS_THROUGH_TOKEN)
+      {
+         if (f[i++] != state_marker || n - i < 2*num_state_values)
+         {
+            continue;
+         }
+         GLfloat val[num_state_values];
+         for (int k = 0; k < num_state_values; k++, i += 2)
+         {
+            val[k] = f[i+1];
+         }
+         rs.bits = int(val[0]);
+         rs.tex1d = int(val[1]);
+         rs.tex2d = int(val[2]);
+         rs.offset_factor = val[3];
+         rs.offset_units = val[4];
+         rs.line_width = val[5];
+         rs.point_size = val[6];
+         state = -1;
+         continue;
+      }
+      if (state < 0)
+      {
+         state = (int)states.size();
+         states.push_back(rs);
+         lit = lit || (rs.bits & STATE_LIGHTING);
+      }
+      // the specular colors of the unlit primitives are zero
+      const GLfloat *gs = (g && (rs.bits & STATE_LIGHTING)) ? g : NULL;
+      if (token == GL_POLYGON_TOKEN)
+      {
+         const int nv = int(f[i++]);
+         poly.resize(nv);
+         for (int k = 0; k < nv; k++, i += 11)
+         {
+            ReadVertex(f + i, gs ? gs + i : NULL, poly[k]);
+         }
+         for (int k = 2; k < nv; k++)
+         {
+            AddTriangle(poly[0], poly[k-1], poly[k], state, true);
+         }
+      }
+      else if (token == GL_LINE_TOKEN || token == GL_LINE_RESET_TOKEN)
+      {
+         SoftVertex p, q;
+         ReadVertex(f + i, gs ? gs + i : NULL, p);
+         ReadVertex(f + i + 11, gs ? gs + i + 11 : NULL, q);
+         i += 22;
+         AddLine(p, q, rs.line_width, state);
+      }
+      else if (token == GL_POINT_TOKEN)
+      {
+         SoftVertex p;
+         ReadVertex(f + i, gs ? gs + i : NULL, p);
+         i += 11;
+         AddPoint(p, rs.point_size, state);
+      }
+      else // GL_BITMAP_TOKEN, GL_DRAW_PIXEL_TOKEN, GL_COPY_PIXEL_TOKEN
+      {
+         i += 11;
+      }
+   }
+   return lit;
+}
+
+// Replace the texture names in 'states' by their indices in 'textures'.
+static void FetchTextures()
+{
+   textures.clear();
+   map<pair<GLenum, GLint>, int> fetched;
+   for (size_t i = 0; i < states.size(); i++)
+   {
+      SoftState &s = states[i];
+      s.tex1d = (s.bits & STATE_TEX1D) ?
+                FetchTexture(GL_TEXTURE_1D, s.tex1d, fetched) : -1;
+      s.tex2d = (s.bits & STATE_TEX2D) ?
+                FetchTexture(GL_TEXTURE_2D, s.tex2d, fetched) : -1;
+   }
+}
+
+
+// Rasterizes the triangles in tiles of tile_size x tile_size pixels. The tiles
+// are independent, so the threads take them from a shared counter; within a
+// tile the triangles are drawn in their original order.
+class TileRasterizer
+{
+public:
+   static const int tile_size = 64;
+
+private:
+   int ntx, nty;
+   float clear[3];
+   // the depth of one unit of polygon offset
+   float depth_unit;
+   vector<vector<int> > bins;
+
+   WorkCounter next_tile;
+
+   struct Buffers
+   {
+      float color[3*tile_size*tile_size], depth[tile_size*tile_size];
+      // coverage and depth of the pixels of one row of a triangle
+      int mask[tile_size];
+      float z[tile_size];
+   };
+
+   void DrawTriangle(const SoftTriangle &t, int ox, int oy, int tw, int th,
+                     Buffers &buf) const;
+   void DrawTile(int tile, Buffers &buf) const;
+   static void WorkerThread(void *arg, int id, int n);
+
+public:
+   void Rasterize(int nthreads = 0);
+};
+
+static inline float Eval(const double p[3], double x, double y)
+{
+   return float(p[0]*x + p[1]*y + p[2]);
+}
+
+// GL_MODULATE with the nearest texel, clamped to the edge
+static inline void Modulate(const SoftTexture &tex, float s, float t,
+                            float c[4])
+{
+   const int i = min(max(int(floor(s*tex.width)), 0), tex.width - 1);
+   const int j = min(max(int(floor(t*tex.height)), 0), tex.height - 1);
+   const float *texel = &tex.texels[4*(j*tex.width + i)];
+   if (tex.rgb)
+   {
+      for (int k = 0; k < 3; k++) { c[k] *= texel[k]; }
+   }
+   if (tex.alpha)
+   {
+      c[3] *= texel[3];
+   }
+}
+
+void TileRasterizer::DrawTriangle(const SoftTriangle &t, int ox, int oy,
+                                  int tw, int th, Buffers &buf) const
+{
+   const SoftVertex *v = t.v;
+
+   // the edge functions E_i = a*x + b*y + c, positive inside and equal to
+   // twice the area at the opposite vertex
+   double edge[3][3];
+   bool top_left[3];
+   double area = 0.0;
+   for (int i = 0; i < 3; i++)
+   {
+      const float *p = v[(i+1)%3].v, *q = v[(i+2)%3].v;
+      edge[i][0] = double(p[1]) - q[1];
+      edge[i][1] = double(q[0]) - p[0];
+      edge[i][2] = double(p[0])*q[1] - double(q[0])*p[1];
+      area += edge[i][2];
+   }
+   if (area == 0.0)
+   {
+      return;
+   }
+   const double sign = (area > 0.0) ? 1.0 : -1.0;
+   for (int i = 0; i < 3; i++)
+   {
+      for (int k = 0; k < 3; k++) { edge[i][k] *= sign; }
+      top_left[i] = (edge[i][0] > 0.0 ||
+                     (edge[i][0] == 0.0 && edge[i][1] < 0.0));
+   }
+   area = fabs(area);
+
+   // the planes of the vertex values after x, y from the barycentric
+   // coordinates
+   double plane[10][3];
+   for (int k = 0; k < 10; k++)
+   {
+      for (int j = 0; j < 3; j++)
+      {
+         plane[k][j] = (edge[0][j]*v[0].v[2+k] + edge[1][j]*v[1].v[2+k] +
+                        edge[2][j]*v[2].v[2+k])/area;
+      }
+   }
+
+   const SoftState &rs = states[t.state];
+   if (t.offset && (rs.bits & STATE_OFFSET_FILL))
+   {
+      const double slope = max(fabs(plane[0][0]), fabs(plane[0][1]));
+      plane[0][2] += rs.offset_factor*slope + rs.offset_units*depth_unit;
+   }
+   const bool depth_test = (rs.bits & STATE_DEPTH_TEST);
+   const bool depth_write = depth_test && (rs.bits & STATE_DEPTH_MASK);
+   const bool blend = (rs.bits & STATE_BLEND);
+   const SoftTexture *tex1d = (rs.tex1d >= 0) ? &textures[rs.tex1d] : NULL;
+   const SoftTexture *tex2d = (rs.tex2d >= 0) ? &textures[rs.tex2d] : NULL;
+
+   // the pixels of the tile inside the bounding box
+   float x0 = v[0].v[0], x1 = x0, y0 = v[0].v[1], y1 = y0;
+   for (int i = 1; i < 3; i++)
+   {
+      x0 = min(x0, v[i].v[0]);
+      x1 = max(x1, v[i].v[0]);
+      y0 = min(y0, v[i].v[1]);
+      y1 = max(y1, v[i].v[1]);
+   }
+   const int xs = max(int(floor(x0)), ox), xe = min(int(ceil(x1)), ox+tw-1);
+   const int ys = max(int(floor(y0)), oy), ye = min(int(ceil(y1)), oy+th-1);
+   if (xs > xe || ys > ye)
+   {
+      return;
+   }
+   const int n = xe - xs + 1;
+
+   const float a0 = edge[0][0], a1 = edge[1][0], a2 = edge[2][0];
+   const int tl0 = top_left[0], tl1 = top_left[1], tl2 = top_left[2];
+   const float dz = plane[0][0];
+   float dval[9];
+   for (int k = 0; k < 9; k++) { dval[k] = plane[1+k][0]; }
+
+   for (int y = ys; y <= ye; y++)
+   {
+      // the values at the first pixel center of the row; the increments
+      // along the row are small, so single precision is enough from here on
+      const double px = xs + 0.5, py = y + 0.5;
+      const float e0 = Eval(edge[0], px, py), e1 = Eval(edge[1], px, py);
+      const float e2 = Eval(edge[2], px, py), z0 = Eval(plane[0], px, py);
+      const float *depth = buf.depth + (y - oy)*tile_size + (xs - ox);
+      int *mask = buf.mask;
+      float *z = buf.z;
+
+      // coverage and depth test without branches, vectorized by the compiler
+      for (int i = 0; i < n; i++)
+      {
+         const float w0 = e0 + i*a0, w1 = e1 + i*a1, w2 = e2 + i*a2;
+         const float zi = z0 + i*dz;
+         const int in0 = (w0 > 0.0f) | ((w0 == 0.0f) & tl0);
+         const int in1 = (w1 > 0.0f) | ((w1 == 0.0f) & tl1);
+         const int in2 = (w2 > 0.0f) | ((w2 == 0.0f) & tl2);
+         const int pass = (!depth_test) | (zi <= depth[i]);
+         mask[i] = in0 & in1 & in2 & pass;
+         z[i] = zi;
+      }
+
+      float val[9];
+      for (int k = 0; k < 9; k++) { val[k] = Eval(plane[1+k], px, py); }
+      for (int i = 0; i < n; i++)
+      {
+         if (!mask[i]) { continue; }
+
+         float c[4];
+         for (int k = 0; k < 4; k++)
+         {
+            c[k] = min(max(val[k] + i*dval[k], 0.0f), 1.0f);
+         }
+         const float s = val[4] + i*dval[4], tc = val[5] + i*dval[5];
+         if (tex1d)
+         {
+            Modulate(*tex1d, s, 0.0f, c);
+         }
+         if (tex2d)
+         {
+            Modulate(*tex2d, s, tc, c);
+         }
+         for (int k = 0; k < 3; k++)
+         {
+            c[k] = min(c[k] + max(val[6+k] + i*dval[6+k], 0.0f), 1.0f);
+         }
+
+         const int p = (y - oy)*tile_size + (xs - ox) + i;
+         float *color = buf.color + 3*p;
+         if (blend)
+         {
+            for (int k = 0; k < 3; k++)
+            {
+               color[k] = c[3]*c[k] + (1.0f - c[3])*color[k];
+            }
+         }
+         else
+         {
+            for (int k = 0; k < 3; k++) { color[k] = c[k]; }
+         }
+         if (depth_write)
+         {
+            buf.depth[p] = z[i];
+         }
+      }
+   }
+}
+
+void TileRasterizer::DrawTile(int tile, Buffers &buf) const
+{
+   const int tx = tile % ntx, ty = tile / ntx;
+   const int ox = tx*tile_size, oy = ty*tile_size;
+   const int tw = min(tile_size, image_w - ox);
+   const int th = min(tile_size, image_h - oy);
+
+   for (int p = 0; p < tile_size*tile_size; p++)
+   {
+      for (int k = 0; k < 3; k++) { buf.color[3*p+k] = clear[k]; }
+      buf.depth[p] = 1.0f;
+   }
+
+   const vector<int> &bin = bins[tile];
+   for (size_t i = 0; i < bin.size(); i++)
+   {
+      DrawTriangle(triangles[bin[i]], ox, oy, tw, th, buf);
+   }
+
+   for (int j = 0; j < th; j++)
+   {
+      const float *color = buf.color + 3*j*tile_size;
+      unsigned char *row = &image[3*((long)(oy + j)*image_w + ox)];
+      for (int i = 0; i < 3*tw; i++)
+      {
+         row[i] = (unsigned char)(255.0f*color[i] + 0.5f);
+      }
+      memcpy(&depth_image[(long)(oy + j)*image_w + ox],
+             buf.depth + j*tile_size, tw*sizeof(float));
+   }
+}
+
+void TileRasterizer::WorkerThread(void *arg, int, int)
+{
+   TileRasterizer *tr = (TileRasterizer *)arg;
+   Buffers *buf = new Buffers;
+   while (1)
+   {
+      const int tile = tr->next_tile.Next();
+      if (tile < 0) { break; }
+      tr->DrawTile(tile, *buf);
+   }
+   delete buf;
+}
+
+void TileRasterizer::Rasterize(int nthreads)
+{
+   ProfileTimer timer("SoftwareRender::Rasterize");
+
+   GLfloat clear_color[4];
+   glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+   for (int k = 0; k < 3; k++) { clear[k] = clear_color[k]; }
+   GLint depth_bits;
+   glGetIntegerv(GL_DEPTH_BITS, &depth_bits);
+   depth_unit = ldexp(1.0, -((depth_bits > 0) ? depth_bits : 24));
+
+   // bin the triangles by the tiles of their bounding boxes
+   ntx = (image_w + tile_size - 1)/tile_size;
+   nty = (image_h + tile_size - 1)/tile_size;
+   bins.assign(ntx*nty, vector<int>());
+   for (size_t t = 0; t < triangles.size(); t++)
+   {
+      const SoftVertex *v = triangles[t].v;
+      float x0 = v[0].v[0], x1 = x0, y0 = v[0].v[1], y1 = y0;
+      for (int i = 1; i < 3; i++)
+      {
+         x0 = min(x0, v[i].v[0]);
+         x1 = max(x1, v[i].v[0]);
+         y0 = min(y0, v[i].v[1]);
+         y1 = max(y1, v[i].v[1]);
+      }
+      const int i0 = max(int(floor(x0)), 0)/tile_size;
+      const int i1 = min(int(ceil(x1)), image_w - 1)/tile_size;
+      const int j0 = max(int(floor(y0)), 0)/tile_size;
+      const int j1 = min(int(ceil(y1)), image_h - 1)/tile_size;
+      for (int j = j0; j <= j1; j++)
+      {
+         for (int i = i0; i <= i1; i++)
+         {
+            bins[j*ntx + i].push_back((int)t);
+         }
+      }
+   }
+
+   if (nthreads <= 0)
+   {
+      nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   next_tile.Reset(ntx*nty);
+   RunThreads(WorkerThread, this, min(nthreads, ntx*nty));
+   bins.clear();
+}
+
+int SoftwareRender(VisualizationScene *scene, int w, int h)
+{
+   if (w <= 0 || h <= 0)
+   {
+      return 1;
+   }
+   const GLint n = CaptureScene(scene, false, feedback[0]);
+   if (n < 0)
+   {
+      return 2;
+   }
+   if (ParseFeedback(n, -1))
+   {
+      ParseFeedback(n, CaptureScene(scene, true, feedback[1]));
+   }
+   FetchTextures();
+
+   image_w = w;
+   image_h = h;
+   image.resize(3*(long)w*h);
+   depth_image.resize((long)w*h);
+   TileRasterizer rasterizer;
+   rasterizer.Rasterize();
+
+   vector<SoftTriangle>().swap(triangles);
+   return 0;
+}
+
+void DrawSoftwareImage()
+{
+   if (image.empty())
+   {
+      return;
+   }
+   glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+   glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+   glDisable(GL_DEPTH_TEST);
+   glDisable(GL_LIGHTING);
+   glDisable(GL_BLEND);
+   glDisable(GL_TEXTURE_1D);
+   glDisable(GL_TEXTURE_2D);
+   glDisable(GL_CLIP_PLANE0);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glRasterPos2f(-1.0f, -1.0f);
+   glDrawPixels(image_w, image_h, GL_RGB, GL_UNSIGNED_BYTE, &image[0]);
+
+   // fill the depth buffer too, it is read back when probing the solution or
+   // seeding the vector field
+   glEnable(GL_DEPTH_TEST);
+   glDepthFunc(GL_ALWAYS);
+   glDepthMask(GL_TRUE);
+   glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+   glDrawPixels(image_w, image_h, GL_DEPTH_COMPONENT, GL_FLOAT,
+                &depth_image[0]);
+
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+
+   glPopClientAttrib();
+   glPopAttrib();
+}
+
+bool GetSoftwareImageRow(int y, int w, unsigned char *pixels)
+{
+   if (!software_rendering || image.empty() || w != image_w || y < 0 ||
+       y >= image_h)
+   {
+      return false;
+   }
+   memcpy(pixels, &image[3*(long)y*image_w], 3*w);
+   return true;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_SOFTRENDER
+#define GLVIS_SOFTRENDER
+
+#include "openglvis.hpp"
+
+// Software rendering of the scenes, for displays without a GPU where the
+// OpenGL driver rasterizes slowly. The scene is drawn once in feedback mode,
+// so OpenGL only transforms, lights and clips the vertices, and the resulting
+// window-space triangles, lines and points are rasterized into an image with
+// 64x64 pixel tiles processed in parallel by all cores. The image is then
+// shown with a single glDrawPixels, together with its depth, and is also used
+// by the screenshots. Text drawn with glDrawPixels or bitmap fonts is not
+// reproduced.
+
+void SetSoftwareRendering(bool on);
+bool GetSoftwareRendering();
+
+// Render 'scene' into the image of size 'w' x 'h'; the projection must already
+// be set for this size. Returns 0 on success.
+int SoftwareRender(VisualizationScene *scene, int w, int h);
+
+// Draw the last rendered image in the current window.
+void DrawSoftwareImage();
+
+// Copy the RGB pixels of row 'y' (counted from the bottom, as in glReadPixels)
+// of the last rendered image to 'pixels'. Returns false if there is no image
+// of width 'w' with this row.
+bool GetSoftwareImageRow(int y, int w, unsigned char *pixels);
+
+// Record the current texturing, blending, depth and polygon offset state for
+// the primitives that follow. The scenes call it after changing this state in
+// their Draw(); it does nothing unless a software rendering is in progress.
+void MarkRenderState();
+
+#endif
@@ -0,0 +1,714 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#include "streamlines.hpp"
+#include "aux_vis.hpp"
+#include "workers.hpp"
+#include <unistd.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace mfem;
+
+// Evaluates a vector GridFunction at physical points. The finite elements of
+// the mesh and of the space keep scratch data, so evaluators running on
+// different threads must use different copies of the finite element
+// collections, see Streamlines::Trace().
+class FieldEvaluator
+{
+private:
+   Mesh *mesh;
+   GridFunction *vgf, *nodes;
+   const PointLocator *locator;
+   const Table &el_to_el;
+   int sdim, vdim;
+
+   FiniteElementCollection *vfec, *nfec;
+   IsoparametricTransformation T;
+   int cur_elem;
+
+   Array<int> vdofs;
+   Vector loc, shape, pt;
+   DenseMatrix vshape;
+
+   void SetElement(int e)
+   {
+      if (e == cur_elem) { return; }
+      const int geom = mesh->GetElementBaseGeometry(e);
+      const FiniteElement *fe = nfec->FiniteElementForGeometry(geom);
+      const int nd = fe->GetDof();
+      DenseMatrix &pm = T.GetPointMat();
+      if (nodes)
+      {
+         nodes->FESpace()->GetElementVDofs(e, vdofs);
+         nodes->GetSubVector(vdofs, loc);
+         pm.SetSize(sdim, nd);
+         for (int d = 0; d < sdim; d++)
+         {
+            for (int j = 0; j < nd; j++)
+            {
+               pm(d,j) = loc(d*nd + j);
+            }
+         }
+      }
+      else
+      {
+         // the vertices are the first degrees of freedom of the linear H1
+         // elements, in the same order
+         mesh->GetPointMatrix(e, pm);
+      }
+      T.SetFE(fe);
+      T.Attribute = mesh->GetAttribute(e);
+      T.ElementNo = e;
+      cur_elem = e;
+   }
+
+   bool InElement(int e, const double *x, IntegrationPoint &ip)
+   {
+      if (!locator->InBox(e, x)) { return false; }
+      SetElement(e);
+      InverseElementTransformation inv_tr(&T);
+      // the default initial guess uses the global GeometryRefiner, which is
+      // not thread safe
+      inv_tr.SetInitialGuessType(InverseElementTransformation::Center);
+      for (int d = 0; d < sdim; d++) { pt(d) = x[d]; }
+      return (inv_tr.Transform(pt, ip) == InverseElementTransformation::Inside);
+   }
+
+public:
+   // 'vfec_' and 'nfec_' are collections of the same elements as the space
+   // of 'vgf_' and the mesh nodes (linear H1 for meshes without nodes), see
+   // NewCollections().
+   FieldEvaluator(GridFunction *vgf_, const PointLocator *locator_,
+                  const Table &el_to_el_, FiniteElementCollection *vfec_,
+                  FiniteElementCollection *nfec_)
+      : mesh(vgf_->FESpace()->GetMesh()), vgf(vgf_),
+        nodes(mesh->GetNodes()), locator(locator_), el_to_el(el_to_el_),
+        vfec(vfec_), nfec(nfec_), cur_elem(-1)
+   {
+      sdim = mesh->SpaceDimension();
+      vdim = std::min(vgf->VectorDim(), 3);
+      pt.SetSize(sdim);
+   }
+
+   // Create copies of the collections of 'vgf' and of its mesh nodes. The
+   // constructors fill the global caches of 1D bases and points of MFEM, so
+   // this must not run concurrently with other MFEM calls.
+   static void NewCollections(GridFunction *vgf, FiniteElementCollection *&vfec,
+                              FiniteElementCollection *&nfec)
+   {
+      Mesh *mesh = vgf->FESpace()->GetMesh();
+      vfec = FiniteElementCollection::New(vgf->FESpace()->FEColl()->Name());
+      if (mesh->GetNodes())
+      {
+         nfec = FiniteElementCollection::New(
+                   mesh->GetNodes()->FESpace()->FEColl()->Name());
+      }
+      else
+      {
+         nfec = new H1_FECollection(1, mesh->Dimension());
+      }
+   }
+
+   // Evaluate the field at 'x'. The search starts at element 'e' and its
+   // neighbors; 'e' is set to the element containing 'x'. Returns false if
+   // 'x' is outside the mesh.
+   bool Eval(const double *x, int &e, double *v)
+   {
+      IntegrationPoint ip;
+      if (e < 0 || !InElement(e, x, ip))
+      {
+         int found = -1;
+         if (e >= 0)
+         {
+            const int *nbr = el_to_el.GetRow(e);
+            for (int k = 0; k < el_to_el.RowSize(e); k++)
+            {
+               if (InElement(nbr[k], x, ip)) { found = nbr[k]; break; }
+            }
+         }
+         if (found < 0)
+         {
+            const int *elems;
+            int n;
+            locator->GetCandidates(x, elems, n);
+            for (int k = 0; k < n; k++)
+            {
+               if (InElement(elems[k], x, ip)) { found = elems[k]; break; }
+            }
+         }
+         if (found < 0) { return false; }
+         e = found;
+      }
+
+      const FiniteElement *fe =
+         vfec->FiniteElementForGeometry(mesh->GetElementBaseGeometry(e));
+      const int nd = fe->GetDof();
+      vgf->FESpace()->GetElementVDofs(e, vdofs);
+      vgf->GetSubVector(vdofs, loc);
+      for (int d = 0; d < 3; d++) { v[d] = 0.0; }
+      if (fe->GetRangeType() == FiniteElement::SCALAR)
+      {
+         shape.SetSize(nd);
+         fe->CalcShape(ip, shape);
+         for (int d = 0; d < vdim; d++)
+         {
+            for (int j = 0; j < nd; j++)
+            {
+               v[d] += shape(j)*loc(d*nd + j);
+            }
+         }
+      }
+      else
+      {
+         T.SetIntPoint(&ip);
+         vshape.SetSize(nd, sdim);
+         fe->CalcVShape(T, vshape);
+         for (int d = 0; d < sdim; d++)
+         {
+            for (int j = 0; j < nd; j++)
+            {
+               v[d] += vshape(j,d)*loc(j);
+            }
+         }
+      }
+      return true;
+   }
+};
+
+// Traces single streamlines with the Dormand-Prince method.
+class StreamlineIntegrator
+{
+private:
+   FieldEvaluator &eval;
+   int sdim;
+   double tol, hmin, hmax, max_len, vmin;
+   int max_steps;
+
+   // the normalized field times 'dir', also returns |v|
+   bool Direction(const double *x, int &e, double dir, double *k, double &s)
+   {
+      double v[3];
+      if (!eval.Eval(x, e, v)) { return false; }
+      s = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+      if (s <= vmin) { return false; }
+      for (int d = 0; d < 3; d++) { k[d] = (d < sdim) ? dir*v[d]/s : 0.0; }
+      return true;
+   }
+
+public:
+   StreamlineIntegrator(FieldEvaluator &eval_, int sdim_, double diam,
+                        double vmin_)
+      : eval(eval_), sdim(sdim_)
+   {
+      tol = 1e-5*diam;
+      hmin = 1e-7*diam;
+      hmax = 0.02*diam;
+      max_len = 4*diam;
+      vmin = vmin_;
+      max_steps = 10000;
+   }
+
+   // Append the points (x, y, z, |v|) of the line from 'x0' in direction
+   // 'dir' (+1 or -1) to 'out', without the starting point.
+   void Integrate(const double *x0, int e0, double dir, vector<double> &out)
+   {
+      // Dormand-Prince coefficients
+      static const double
+      a21 = 1./5,
+      a31 = 3./40, a32 = 9./40,
+      a41 = 44./45, a42 = -56./15, a43 = 32./9,
+      a51 = 19372./6561, a52 = -25360./2187, a53 = 64448./6561,
+      a54 = -212./729,
+      a61 = 9017./3168, a62 = -355./33, a63 = 46732./5247, a64 = 49./176,
+      a65 = -5103./18656,
+      a71 = 35./384, a73 = 500./1113, a74 = 125./192, a75 = -2187./6784,
+      a76 = 11./84,
+      // difference between the 5th and 4th order weights
+      e1 = 71./57600, e3 = -71./16695, e4 = 71./1920, e5 = -17253./339200,
+      e6 = 22./525, e7 = -1./40;
+
+      double x[3] = { x0[0], x0[1], x0[2] }, y[3], k[7][3], s, s7;
+      int e = e0;
+      if (!Direction(x, e, dir, k[0], s)) { return; }
+
+      double h = 0.1*hmax, len = 0.0;
+      for (int step = 0; step < max_steps && len < max_len; step++)
+      {
+         int ei = e;
+         bool ok = true;
+         for (int d = 0; d < 3; d++) { y[d] = x[d] + h*a21*k[0][d]; }
+         ok = ok && Direction(y, ei, dir, k[1], s7);
+         for (int d = 0; d < 3 && ok; d++)
+         {
+            y[d] = x[d] + h*(a31*k[0][d] + a32*k[1][d]);
+         }
+         ok = ok && Direction(y, ei, dir, k[2], s7);
+         for (int d = 0; d < 3 && ok; d++)
+         {
+            y[d] = x[d] + h*(a41*k[0][d] + a42*k[1][d] + a43*k[2][d]);
+         }
+         ok = ok && Direction(y, ei, dir, k[3], s7);
+         for (int d = 0; d < 3 && ok; d++)
+         {
+            y[d] = x[d] + h*(a51*k[0][d] + a52*k[1][d] + a53*k[2][d] +
+                             a54*k[3][d]);
+         }
+         ok = ok && Direction(y, ei, dir, k[4], s7);
+         for (int d = 0; d < 3 && ok; d++)
+         {
+            y[d] = x[d] + h*(a61*k[0][d] + a62*k[1][d] + a63*k[2][d] +
+                             a64*k[3][d] + a65*k[4][d]);
+         }
+         ok = ok && Direction(y, ei, dir, k[5], s7);
+         for (int d = 0; d < 3 && ok; d++)
+         {
+            y[d] = x[d] + h*(a71*k[0][d] + a73*k[2][d] + a74*k[3][d] +
+                             a75*k[4][d] + a76*k[5][d]);
+         }
+         ok = ok && Direction(y, ei, dir, k[6], s7);
+         if (!ok)
+         {
+            // left the mesh or reached a stagnation point
+            h *= 0.25;
+            if (h < hmin) { break; }
+            continue;
+         }
+
+         double err = 0.0;
+         for (int d = 0; d < 3; d++)
+         {
+            double ed = h*(e1*k[0][d] + e3*k[2][d] + e4*k[3][d] +
+                           e5*k[4][d] + e6*k[5][d] + e7*k[6][d]);
+            err += ed*ed;
+         }
+         err = sqrt(err);
+         double fac = (err > 0.0) ? 0.9*pow(tol/err, 0.2) : 5.0;
+         if (err > tol && h > hmin)
+         {
+            h = std::max(hmin, h*std::max(0.2, fac));
+            continue;
+         }
+
+         // accept the step, the last stage is the first one of the next step
+         for (int d = 0; d < 3; d++)
+         {
+            x[d] = y[d];
+            k[0][d] = k[6][d];
+         }
+         e = ei;
+         len += h;
+         out.push_back(x[0]);
+         out.push_back(x[1]);
+         out.push_back(x[2]);
+         out.push_back(s7);
+         h = std::min(hmax, h*std::min(5.0, fac));
+      }
+   }
+};
+
+struct Streamlines::Worker
+{
+   Streamlines *sl;
+   const Table *el_to_el;
+   double vmin;
+   int first_seed;
+   // the seeds to trace, starting from 'first_seed'
+   WorkCounter *seeds;
+   // the line of each new seed
+   vector<vector<double> > *lines;
+   // the finite element collections of each thread
+   vector<FiniteElementCollection *> vfecs, nfecs;
+};
+
+void Streamlines::TraceThread(void *arg, int id, int)
+{
+   Worker *w = (Worker *)arg;
+   Streamlines *sl = w->sl;
+   FieldEvaluator eval(sl->vgf, sl->locator, *w->el_to_el, w->vfecs[id],
+                       w->nfecs[id]);
+   StreamlineIntegrator integ(eval, sl->sdim, sl->diam, w->vmin);
+   vector<double> back;
+
+   while (true)
+   {
+      const int k = w->seeds->Next();
+      if (k < 0) { break; }
+
+      const double *x = &sl->seeds[3*(w->first_seed + k)];
+      double v[3];
+      int e = -1;
+      if (!eval.Eval(x, e, v)) { continue; }
+
+      // backward part in reverse order, the seed, then the forward part
+      vector<double> &line = (*w->lines)[k];
+      back.clear();
+      integ.Integrate(x, e, -1.0, back);
+      for (int j = int(back.size())/4-1; j >= 0; j--)
+      {
+         line.insert(line.end(), &back[4*j], &back[4*j] + 4);
+      }
+      line.push_back(x[0]);
+      line.push_back(x[1]);
+      line.push_back(x[2]);
+      line.push_back(sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]));
+      integ.Integrate(x, e, 1.0, line);
+   }
+}
+
+Streamlines::Streamlines(GridFunction *vgf_, const PointLocator *locator_)
+   : vgf(vgf_), locator(locator_)
+{
+   mesh = vgf->FESpace()->GetMesh();
+   sdim = mesh->SpaceDimension();
+
+   double bmin[3], bmax[3];
+   locator->GetBoundingBox(bmin, bmax);
+   diam = 0.0;
+   for (int d = 0; d < sdim; d++)
+   {
+      diam += (bmax[d] - bmin[d])*(bmax[d] - bmin[d]);
+   }
+   diam = sqrt(diam);
+
+   line_offsets.Append(0);
+   width = 0.004;
+   minv = 0.0;
+   maxv = 1.0;
+   zc = 0.0;
+}
+
+Streamlines::~Streamlines()
+{
+   Clear();
+}
+
+void Streamlines::Clear()
+{
+   for (int k = 0; k < lists.Size(); k++)
+   {
+      glDeleteLists(lists[k], 1);
+   }
+   lists.SetSize(0);
+   list_lines.SetSize(0);
+   seeds.SetSize(0);
+   line_offsets.SetSize(1);
+   points.SetSize(0);
+}
+
+void Streamlines::Trace(int first_seed, int num_threads)
+{
+   const int ns = seeds.Size()/3 - first_seed;
+   if (num_threads <= 0)
+   {
+      num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   num_threads = std::max(1, std::min(num_threads, ns));
+
+   // The tensor product elements of quadrilaterals and hexahedra evaluate
+   // their shape functions with the shared 1D bases of MFEM, which keep
+   // scratch data, so those meshes are traced on one thread.
+   for (int i = 0; i < mesh->GetNE() && num_threads > 1; i++)
+   {
+      const int geom = mesh->GetElementBaseGeometry(i);
+      if (geom == Geometry::SQUARE || geom == Geometry::CUBE)
+      {
+         num_threads = 1;
+      }
+   }
+
+   // build the neighbor table before starting the threads
+   const Table &el_to_el = mesh->ElementToElementTable();
+
+   // stop at speeds that are negligible compared to the maximum
+   double vmax = 0.0;
+   for (int i = 0; i < vgf->Size(); i++)
+   {
+      vmax = std::max(vmax, fabs((*vgf)(i)));
+   }
+
+   vector<vector<double> > lines(ns);
+   WorkCounter seed_counter(ns);
+
+   Worker w;
+   w.sl = this;
+   w.el_to_el = &el_to_el;
+   w.vmin = 1e-12*vmax;
+   w.first_seed = first_seed;
+   w.seeds = &seed_counter;
+   w.lines = &lines;
+   w.vfecs.resize(num_threads);
+   w.nfecs.resize(num_threads);
+   for (int t = 0; t < num_threads; t++)
+   {
+      FieldEvaluator::NewCollections(vgf, w.vfecs[t], w.nfecs[t]);
+   }
+
+   RunThreads(TraceThread, &w, num_threads);
+
+   for (int t = 0; t < num_threads; t++)
+   {
+      delete w.nfecs[t];
+      delete w.vfecs[t];
+   }
+
+   // keep the order of the seeds, so the result does not depend on the threads
+   for (int i = 0; i < ns; i++)
+   {
+      const int np = lines[i].size()/4;
+      if (np < 2) { continue; }
+      for (int j = 0; j < 4*np; j++)
+      {
+         points.Append(lines[i][j]);
+      }
+      line_offsets.Append(line_offsets.Last() + np);
+   }
+}
+
+void Streamlines::AddSeeds(const Array<double> &new_seeds, int num_threads)
+{
+   const int first_seed = seeds.Size()/3;
+   const int first_line = NumLines();
+   seeds.Append(new_seeds);
+   Trace(first_seed, num_threads);
+
+   if (NumLines() > first_line)
+   {
+      lists.Append(glGenLists(1));
+      list_lines.Append(first_line);
+      CompileList(lists.Last(), first_line, NumLines());
+   }
+   cout << "Streamlines: " << NumLines() - first_line << " new, "
+        << NumLines() << " total" << endl;
+}
+
+void Streamlines::Prepare()
+{
+   for (int k = 0; k < lists.Size(); k++)
+   {
+      int last = (k+1 < lists.Size()) ? list_lines[k+1] : NumLines();
+      CompileList(lists[k], list_lines[k], last);
+   }
+}
+
+void Streamlines::Draw()
+{
+   for (int k = 0; k < lists.Size(); k++)
+   {
+      glCallList(lists[k]);
+   }
+}
+
+void Streamlines::CompileList(int list, int first_line, int last_line)
+{
+   glNewList(list, GL_COMPILE);
+   for (int i = first_line; i < last_line; i++)
+   {
+      const double *pts = &points[4*line_offsets[i]];
+      const int n = line_offsets[i+1] - line_offsets[i];
+      if (sdim == 3)
+      {
+         DrawTube(pts, n);
+      }
+      else
+      {
+         DrawRibbon(pts, n);
+      }
+   }
+   glEndList();
+}
+
+// unit tangent of the polyline at point i
+static void Tangent(const double *pts, int n, int i, double *t)
+{
+   const double *a = pts + 4*std::max(i-1, 0), *b = pts + 4*std::min(i+1, n-1);
+   double l = 0.0;
+   for (int d = 0; d < 3; d++)
+   {
+      t[d] = b[d] - a[d];
+      l += t[d]*t[d];
+   }
+   l = sqrt(l);
+   for (int d = 0; d < 3; d++)
+   {
+      t[d] = (l > 0.0) ? t[d]/l : (d == 0);
+   }
+}
+
+void Streamlines::DrawTube(const double *pts, int n)
+{
+   const int nr = 8; // points on the circles
+   const double r = 0.5*width*diam;
+   double t[3], nor[3], bin[3];
+   vector<double> ring(6*(nr+1)*n); // position and normal of the circles
+
+   // normals carried along the line by projection (parallel transport)
+   Tangent(pts, n, 0, t);
+   nor[0] = nor[1] = nor[2] = 0.0;
+   nor[fabs(t[0]) < 0.6 ? 0 : (fabs(t[1]) < 0.6 ? 1 : 2)] = 1.0;
+   for (int i = 0; i < n; i++)
+   {
+      Tangent(pts, n, i, t);
+      double tn = t[0]*nor[0] + t[1]*nor[1] + t[2]*nor[2], l = 0.0;
+      for (int d = 0; d < 3; d++)
+      {
+         nor[d] -= tn*t[d];
+         l += nor[d]*nor[d];
+      }
+      l = sqrt(l);
+      if (l < 1e-8)
+      {
+         // the tangent turned by 90 degrees in one step
+         nor[0] = nor[1] = nor[2] = 0.0;
+         nor[fabs(t[0]) < 0.6 ? 0 : (fabs(t[1]) < 0.6 ? 1 : 2)] = 1.0;
+         tn = t[0]*nor[0] + t[1]*nor[1] + t[2]*nor[2];
+         l = 0.0;
+         for (int d = 0; d < 3; d++)
+         {
+            nor[d] -= tn*t[d];
+            l += nor[d]*nor[d];
+         }
+         l = sqrt(l);
+      }
+      for (int d = 0; d < 3; d++) { nor[d] /= l; }
+      bin[0] = t[1]*nor[2] - t[2]*nor[1];
+      bin[1] = t[2]*nor[0] - t[0]*nor[2];
+      bin[2] = t[0]*nor[1] - t[1]*nor[0];
+
+      for (int j = 0; j <= nr; j++)
+      {
+         double c = cos(2*M_PI*j/nr), s = sin(2*M_PI*j/nr);
+         double *rv = &ring[6*((nr+1)*i + j)];
+         for (int d = 0; d < 3; d++)
+         {
+            rv[3+d] = c*nor[d] + s*bin[d];
+            rv[d] = pts[4*i+d] + r*rv[3+d];
+         }
+      }
+   }
+
+   for (int i = 0; i+1 < n; i++)
+   {
+      glBegin(GL_QUAD_STRIP);
+      for (int j = 0; j <= nr; j++)
+      {
+         for (int k = i; k <= i+1; k++)
+         {
+            const double *rv = &ring[6*((nr+1)*k + j)];
+            MySetColor(pts[4*k+3], minv, maxv);
+            glNormal3dv(rv+3);
+            glVertex3dv(rv);
+         }
+      }
+      glEnd();
+   }
+}
+
+void Streamlines::DrawRibbon(const double *pts, int n)
+{
+   const double hw = 0.5*width*diam;
+   double t[3];
+
+   glNormal3d(0.0, 0.0, 1.0);
+   glBegin(GL_QUAD_STRIP);
+   for (int i = 0; i < n; i++)
+   {
+      Tangent(pts, n, i, t);
+      MySetColor(pts[4*i+3], minv, maxv);
+      glVertex3d(pts[4*i] - hw*t[1], pts[4*i+1] + hw*t[0], zc);
+      glVertex3d(pts[4*i] + hw*t[1], pts[4*i+1] - hw*t[0], zc);
+   }
+   glEnd();
+}
+
+void Streamlines::SeedsOnLine(const double *p0, const double *p1, int n,
+                              Array<double> &s)
+{
+   for (int i = 0; i < n; i++)
+   {
+      const double t = (n > 1) ? double(i)/(n-1) : 0.5;
+      for (int d = 0; d < 3; d++)
+      {
+         s.Append(p0[d] + t*(p1[d] - p0[d]));
+      }
+   }
+}
+
+void Streamlines::SeedsOnPlane(const double *p, const double *nor,
+                               double size, int n, Array<double> &s)
+{
+   // orthonormal vectors u, w in the plane
+   double nl = sqrt(nor[0]*nor[0] + nor[1]*nor[1] + nor[2]*nor[2]);
+   if (nl == 0.0 || n < 1) { return; }
+   double m[3] = { nor[0]/nl, nor[1]/nl, nor[2]/nl }, u[3], w[3];
+   double a[3] = { 0.0, 0.0, 0.0 };
+   a[fabs(m[0]) < 0.6 ? 0 : (fabs(m[1]) < 0.6 ? 1 : 2)] = 1.0;
+   u[0] = a[1]*m[2] - a[2]*m[1];
+   u[1] = a[2]*m[0] - a[0]*m[2];
+   u[2] = a[0]*m[1] - a[1]*m[0];
+   double ul = sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+   for (int d = 0; d < 3; d++) { u[d] /= ul; }
+   w[0] = m[1]*u[2] - m[2]*u[1];
+   w[1] = m[2]*u[0] - m[0]*u[2];
+   w[2] = m[0]*u[1] - m[1]*u[0];
+
+   for (int j = 0; j < n; j++)
+   {
+      for (int i = 0; i < n; i++)
+      {
+         double ci = size*((i + 0.5)/n - 0.5), cj = size*((j + 0.5)/n - 0.5);
+         for (int d = 0; d < 3; d++)
+         {
+            s.Append(p[d] + ci*u[d] + cj*w[d]);
+         }
+      }
+   }
+}
+
+void Streamlines::SeedsOnBoundary(Mesh *mesh, int attr, int max_n,
+                                  Array<double> &s)
+{
+   Array<int> bdr;
+   for (int i = 0; i < mesh->GetNBE(); i++)
+   {
+      if (mesh->GetBdrAttribute(i) == attr) { bdr.Append(i); }
+   }
+   if (bdr.Size() == 0 || max_n < 1) { return; }
+
+   const int sdim = mesh->SpaceDimension();
+   const int stride = (bdr.Size() + max_n - 1)/max_n;
+   DenseMatrix pm;
+   for (int k = 0; k < bdr.Size(); k += stride)
+   {
+      int e1, e2;
+      mesh->GetFaceElements(mesh->GetBdrElementEdgeIndex(bdr[k]), &e1, &e2);
+
+      double fc[3] = { 0.0, 0.0, 0.0 }, ec[3] = { 0.0, 0.0, 0.0 };
+      mesh->GetBdrPointMatrix(bdr[k], pm);
+      for (int d = 0; d < sdim; d++)
+      {
+         for (int j = 0; j < pm.Width(); j++) { fc[d] += pm(d,j); }
+         fc[d] /= pm.Width();
+      }
+      mesh->GetPointMatrix(e1, pm);
+      for (int d = 0; d < sdim; d++)
+      {
+         for (int j = 0; j < pm.Width(); j++) { ec[d] += pm(d,j); }
+         ec[d] /= pm.Width();
+      }
+      for (int d = 0; d < 3; d++)
+      {
+         s.Append(fc[d] + 0.01*(ec[d] - fc[d]));
+      }
+   }
+}
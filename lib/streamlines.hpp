@@ -0,0 +1,89 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_STREAMLINES
+#define GLVIS_STREAMLINES
+
+#include <mfem.hpp>
+#include "pointlocator.hpp"
+
+// Streamlines of a vector GridFunction. The lines are traced through the seeds
+// in both directions with the adaptive Runge-Kutta method of Dormand and
+// Prince (RK45), following the normalized field. The elements containing the
+// points are found by walking from the current element to its neighbors, with
+// the PointLocator as a fallback. The lines of each call to AddSeeds() are
+// traced by several threads and compiled into their own display list, so the
+// existing lines are not recomputed when seeds are added.
+class Streamlines
+{
+private:
+   mfem::GridFunction *vgf;
+   const PointLocator *locator;
+   mfem::Mesh *mesh;
+   int sdim;
+   double diam; // diameter of the bounding box of the mesh
+
+   // all seeds, 3 coordinates each
+   mfem::Array<double> seeds;
+   // the points (x, y, z, |v|) of line i are
+   // points[4*line_offsets[i] ... 4*line_offsets[i+1]-1]
+   mfem::Array<int> line_offsets;
+   mfem::Array<double> points;
+   // display lists; list_lines[k] is the first line in lists[k]
+   mfem::Array<int> lists, list_lines;
+
+   void Trace(int first_seed, int num_threads);
+   void CompileList(int list, int first_line, int last_line);
+   void DrawTube(const double *pts, int n);
+   void DrawRibbon(const double *pts, int n);
+
+   struct Worker;
+   static void TraceThread(void *arg, int id, int n);
+
+public:
+   // Diameter of the tubes (3D) or width of the ribbons (2D), relative to the
+   // size of the mesh.
+   double width;
+   // The color range of |v|, see MySetColor().
+   double minv, maxv;
+   // In 2D, the ribbons are drawn in the plane z = zc.
+   double zc;
+
+   // The locator must be for the mesh of 'vgf_'.
+   Streamlines(mfem::GridFunction *vgf_, const PointLocator *locator_);
+   ~Streamlines();
+
+   // Trace the streamlines through the points 'new_seeds' (3 coordinates per
+   // point) using 'num_threads' threads (0 means the number of online
+   // processors). Seeds outside of the mesh are ignored.
+   void AddSeeds(const mfem::Array<double> &new_seeds, int num_threads = 0);
+   const mfem::Array<double> &GetSeeds() const { return seeds; }
+   int NumLines() const { return line_offsets.Size()-1; }
+   void Clear();
+
+   // Recompile the display lists, e.g. after a change of the colors.
+   void Prepare();
+   void Draw();
+
+   // 'n' seeds evenly spaced on the segment from 'p0' to 'p1'
+   static void SeedsOnLine(const double *p0, const double *p1, int n,
+                           mfem::Array<double> &s);
+   // 'n' x 'n' seeds on a square with side 'size' centered at 'p', in the
+   // plane with normal 'nor'
+   static void SeedsOnPlane(const double *p, const double *nor, double size,
+                            int n, mfem::Array<double> &s);
+   // Up to 'max_n' seeds at the centers of the boundary elements with the
+   // given attribute, moved slightly inside the mesh
+   static void SeedsOnBoundary(mfem::Mesh *mesh, int attr, int max_n,
+                               mfem::Array<double> &s);
+};
+
+#endif
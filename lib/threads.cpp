@@ -13,6 +13,8 @@
 #include <fcntl.h>     // fcntl
 #include <cerrno>      // errno, EAGAIN
 #include <cstdio>      // perror
+#include <sstream>
+#include <algorithm>   // count
 
 #include "palettes.hpp"
 #include "visual.hpp"
@@ -20,13 +22,16 @@
 using namespace std;
 
 void SetMeshSolution(Mesh *mesh, GridFunction *&grid_f, bool save_coloring);
+GridFunction *ProjectVectorFEGridFunction(GridFunction*);
 extern const char *strings_off_on[]; // defined in vsdata.cpp
+extern int visualize; // defined in aux_vis.cpp
 
 GLVisCommand *glvis_command = NULL;
 
 GLVisCommand::GLVisCommand(
    VisualizationSceneScalarData **_vs, Mesh **_mesh, GridFunction **_grid_f,
-   Vector *_sol, bool *_keep_attr, bool *_fix_elem_orient)
+   Vector *_sol, bool *_keep_attr, bool *_fix_elem_orient,
+   bool *_coalesce_updates)
 {
    vs        = _vs;
    mesh      = _mesh;
@@ -34,11 +39,12 @@ GLVisCommand::GLVisCommand(
    sol       = _sol;
    keep_attr = _keep_attr;
    fix_elem_orient = _fix_elem_orient;
+   coalesce_updates = _coalesce_updates;
 
    pthread_mutex_init(&glvis_mutex, NULL);
    pthread_cond_init(&glvis_cond, NULL);
-   num_waiting = 0;
    terminating = false;
+   signaled = false;
    if (pipe(pfd) == -1)
    {
       perror("pipe()");
@@ -47,371 +53,436 @@ GLVisCommand::GLVisCommand(
    int flag = fcntl(pfd[0], F_GETFL);
    fcntl(pfd[0], F_SETFL, flag | O_NONBLOCK);
 
-   command = NO_COMMAND;
+   q_first = q_size = 0;
+   num_dropped = 0;
 
    autopause = 0;
+
+   prep_started =
+      !pthread_create(&prep_tid, NULL, GLVisCommand::prepare_thread, this);
 }
 
-int GLVisCommand::lock()
+bool GLVisCommand::Merge(Command &last, const Command &cmd)
+{
+   if (last.type != cmd.type)
+   {
+      return false;
+   }
+   switch (cmd.type)
+   {
+      case NEW_MESH_AND_SOLUTION:
+         if (!*coalesce_updates || last.prep_state == PREPARING)
+         {
+            return false;
+         }
+         delete last.new_sol;
+         delete last.new_g;
+         delete last.new_m;
+         last.new_m = cmd.new_m;
+         last.new_g = cmd.new_g;
+         last.new_sol = NULL;
+         last.prep_state = NOT_PREPARED;
+         num_dropped++;
+         return true;
+
+      case VIEW_ANGLES:
+         last.view_ang_theta = cmd.view_ang_theta;
+         last.view_ang_phi   = cmd.view_ang_phi;
+         return true;
+
+      case ZOOM:
+         last.zoom_factor *= cmd.zoom_factor;
+         return true;
+
+      case VIEW_CENTER:
+         last.view_center_x = cmd.view_center_x;
+         last.view_center_y = cmd.view_center_y;
+         return true;
+
+      case CAMERA:
+         for (int i = 0; i < 9; i++)
+         {
+            last.camera[i] = cmd.camera[i];
+         }
+         return true;
+   }
+   return false;
+}
+
+int GLVisCommand::Push(const Command &cmd)
 {
-   int my_id;
    pthread_mutex_lock(&glvis_mutex);
    if (terminating)
    {
       pthread_mutex_unlock(&glvis_mutex);
       return -1;
    }
-   my_id = num_waiting++;
-   while (my_id > 0)
+   // a command that has not been picked up by the main thread yet can absorb
+   // a new command of the same kind
+   if (q_size > 0 && Merge(queue[(q_first+q_size-1)%QUEUE_SIZE], cmd))
+   {
+      if (cmd.type == NEW_MESH_AND_SOLUTION)
+      {
+         pthread_cond_broadcast(&glvis_cond); // wake up the prepare thread
+      }
+      pthread_mutex_unlock(&glvis_mutex);
+      return 0;
+   }
+   while (q_size == QUEUE_SIZE)
    {
       pthread_cond_wait(&glvis_cond, &glvis_mutex);
       if (terminating)
       {
-         num_waiting--;
          pthread_mutex_unlock(&glvis_mutex);
          return -1;
       }
-      my_id--;
    }
-   pthread_mutex_unlock(&glvis_mutex);
-   return 0;
-}
-
-int GLVisCommand::signal()
-{
-   char c = 's';
-   if (write(pfd[1], &c, 1) != 1)
+   Command &last = queue[(q_first+q_size)%QUEUE_SIZE];
+   last = cmd;
+   last.new_sol = NULL;
+   if (cmd.type == NEW_MESH_AND_SOLUTION)
    {
-      return -1;
+      last.prep_state = NOT_PREPARED;
+      pthread_cond_broadcast(&glvis_cond); // wake up the prepare thread
    }
-   return 0;
+   else
+   {
+      last.prep_state = PREPARED;
+   }
+   q_size++;
+   int err = 0;
+   if (!signaled)
+   {
+      signaled = true;
+      if (signal() < 0)
+      {
+         err = -2;
+      }
+   }
+   pthread_mutex_unlock(&glvis_mutex);
+   return err;
 }
 
-void GLVisCommand::unlock()
+bool GLVisCommand::Pop(Command &cmd)
 {
    pthread_mutex_lock(&glvis_mutex);
-   num_waiting--;
-   if (num_waiting > 0)
+   // the prepare thread is still working on the first command
+   while (q_size > 0 && queue[q_first].prep_state == PREPARING)
+   {
+      pthread_cond_wait(&glvis_cond, &glvis_mutex);
+   }
+   if (q_size == 0)
+   {
+      signaled = false;
+      pthread_mutex_unlock(&glvis_mutex);
+      return false;
+   }
+   cmd = queue[q_first];
+   q_first = (q_first+1)%QUEUE_SIZE;
+   if (q_size-- == QUEUE_SIZE)
    {
       pthread_cond_broadcast(&glvis_cond);
    }
    pthread_mutex_unlock(&glvis_mutex);
+   return true;
 }
 
-int GLVisCommand::NewMeshAndSolution(Mesh *_new_m, GridFunction *_new_g)
+void GLVisCommand::PrepareSolution(Command &cmd)
 {
-   if (lock() < 0)
+   if (cmd.new_g == NULL)
    {
-      return -1;
+      return;
    }
-   command = NEW_MESH_AND_SOLUTION;
-   new_m = _new_m;
-   new_g = _new_g;
-   if (signal() < 0)
+   if (cmd.new_g->VectorDim() == 1)
    {
-      return -2;
+      cmd.new_sol = new Vector;
+      cmd.new_g->GetNodalValues(*cmd.new_sol);
+   }
+   else if (cmd.new_m->SpaceDimension() != 2)
+   {
+      cmd.new_g = ProjectVectorFEGridFunction(cmd.new_g);
    }
-   return 0;
 }
 
-int GLVisCommand::Screenshot(const char *filename)
+void *GLVisCommand::prepare_thread(void *p)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = SCREENSHOT;
-   screenshot_filename = filename;
-   if (signal() < 0)
+   GLVisCommand *_this = (GLVisCommand *)p;
+
+   pthread_mutex_lock(&_this->glvis_mutex);
+   while (!_this->terminating)
    {
-      return -2;
+      Command *cmd = NULL;
+      for (int i = 0; i < _this->q_size; i++)
+      {
+         Command &c = _this->queue[(_this->q_first+i)%QUEUE_SIZE];
+         if (c.prep_state == NOT_PREPARED)
+         {
+            cmd = &c;
+            break;
+         }
+      }
+      if (cmd == NULL)
+      {
+         pthread_cond_wait(&_this->glvis_cond, &_this->glvis_mutex);
+         continue;
+      }
+      // While PREPARING, the command is neither removed from the queue nor
+      // merged with a newer one, so it can be updated without the lock.
+      cmd->prep_state = PREPARING;
+      pthread_mutex_unlock(&_this->glvis_mutex);
+      PrepareSolution(*cmd);
+      pthread_mutex_lock(&_this->glvis_mutex);
+      cmd->prep_state = PREPARED;
+      pthread_cond_broadcast(&_this->glvis_cond);
    }
-   return 0;
+   pthread_mutex_unlock(&_this->glvis_mutex);
+
+   return p;
 }
 
-int GLVisCommand::KeyCommands(const char *keys)
+int GLVisCommand::signal()
 {
-   if (lock() < 0)
+   char c = 's';
+   if (write(pfd[1], &c, 1) != 1)
    {
       return -1;
    }
-   command = KEY_COMMANDS;
-   key_commands = keys;
-   if (signal() < 0)
-   {
-      return -2;
-   }
    return 0;
 }
 
+int GLVisCommand::NewMeshAndSolution(Mesh *_new_m, GridFunction *_new_g)
+{
+   Command cmd;
+   cmd.type = NEW_MESH_AND_SOLUTION;
+   cmd.new_m = _new_m;
+   cmd.new_g = _new_g;
+   return Push(cmd);
+}
+
+int GLVisCommand::Screenshot(const char *filename)
+{
+   Command cmd;
+   cmd.type = SCREENSHOT;
+   cmd.screenshot_filename = filename;
+   return Push(cmd);
+}
+
+int GLVisCommand::KeyCommands(const char *keys)
+{
+   Command cmd;
+   cmd.type = KEY_COMMANDS;
+   cmd.key_commands = keys;
+   return Push(cmd);
+}
+
 int GLVisCommand::WindowSize(int w, int h)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = WINDOW_SIZE;
-   window_w = w;
-   window_h = h;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = WINDOW_SIZE;
+   cmd.window_w = w;
+   cmd.window_h = h;
+   return Push(cmd);
 }
 
 int GLVisCommand::WindowGeometry(int x, int y, int w, int h)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = WINDOW_GEOMETRY;
-   window_x = x;
-   window_y = y;
-   window_w = w;
-   window_h = h;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = WINDOW_GEOMETRY;
+   cmd.window_x = x;
+   cmd.window_y = y;
+   cmd.window_w = w;
+   cmd.window_h = h;
+   return Push(cmd);
 }
 
 int GLVisCommand::WindowTitle(const char *title)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = WINDOW_TITLE;
-   window_title = title;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = WINDOW_TITLE;
+   cmd.window_title = title;
+   return Push(cmd);
 }
 
 int GLVisCommand::PlotCaption(const char *caption)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = PLOT_CAPTION;
-   plot_caption = caption;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = PLOT_CAPTION;
+   cmd.plot_caption = caption;
+   return Push(cmd);
 }
 
 int GLVisCommand::AxisLabels(const char *a_x, const char *a_y, const char *a_z)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = AXIS_LABELS;
-   axis_label_x = a_x;
-   axis_label_y = a_y;
-   axis_label_z = a_z;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = AXIS_LABELS;
+   cmd.axis_label_x = a_x;
+   cmd.axis_label_y = a_y;
+   cmd.axis_label_z = a_z;
+   return Push(cmd);
 }
 
 int GLVisCommand::Pause()
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = PAUSE;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = PAUSE;
+   return Push(cmd);
 }
 
 int GLVisCommand::ViewAngles(double theta, double phi)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = VIEW_ANGLES;
-   view_ang_theta = theta;
-   view_ang_phi   = phi;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = VIEW_ANGLES;
+   cmd.view_ang_theta = theta;
+   cmd.view_ang_phi   = phi;
+   return Push(cmd);
 }
 
 int GLVisCommand::Zoom(double factor)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = ZOOM;
-   zoom_factor = factor;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = ZOOM;
+   cmd.zoom_factor = factor;
+   return Push(cmd);
 }
 
 int GLVisCommand::Subdivisions(int tot, int bdr)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = SUBDIVISIONS;
-   subdiv_tot = tot;
-   subdiv_bdr = bdr;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = SUBDIVISIONS;
+   cmd.subdiv_tot = tot;
+   cmd.subdiv_bdr = bdr;
+   return Push(cmd);
 }
 
 int GLVisCommand::ValueRange(double minv, double maxv)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = VALUE_RANGE;
-   val_min = minv;
-   val_max = maxv;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = VALUE_RANGE;
+   cmd.val_min = minv;
+   cmd.val_max = maxv;
+   return Push(cmd);
 }
 
 int GLVisCommand::SetShading(const char *shd)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = SHADING;
-   shading = shd;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = SHADING;
+   cmd.shading = shd;
+   return Push(cmd);
 }
 
 int GLVisCommand::ViewCenter(double x, double y)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = VIEW_CENTER;
-   view_center_x = x;
-   view_center_y = y;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = VIEW_CENTER;
+   cmd.view_center_x = x;
+   cmd.view_center_y = y;
+   return Push(cmd);
 }
 
 int GLVisCommand::Autoscale(const char *mode)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = AUTOSCALE;
-   autoscale_mode = mode;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = AUTOSCALE;
+   cmd.autoscale_mode = mode;
+   return Push(cmd);
 }
 
 int GLVisCommand::Palette(int pal)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = PALETTE;
-   palette = pal;
-   if (signal() < 0)
-   {
-      return -2;
-   }
-   return 0;
+   Command cmd;
+   cmd.type = PALETTE;
+   cmd.palette = pal;
+   return Push(cmd);
 }
 
 int GLVisCommand::PaletteRepeat(int n)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = PALETTE_REPEAT;
-   palette_repeat = n;
-   if (signal() < 0)
+   Command cmd;
+   cmd.type = PALETTE_REPEAT;
+   cmd.palette_repeat = n;
+   return Push(cmd);
+}
+
+int GLVisCommand::Camera(const double cam[])
+{
+   Command cmd;
+   cmd.type = CAMERA;
+   for (int i = 0; i < 9; i++)
    {
-      return -2;
+      cmd.camera[i] = cam[i];
    }
-   return 0;
+   return Push(cmd);
 }
 
-int GLVisCommand::Camera(const double cam[])
+int GLVisCommand::Autopause(const char *mode)
 {
-   if (lock() < 0)
+   Command cmd;
+   cmd.type = AUTOPAUSE;
+   cmd.autopause_mode = mode;
+   return Push(cmd);
+}
+
+int GLVisCommand::Request(Command &cmd, string &reply)
+{
+   CommandReply result;
+   result.done = false;
+
+   cmd.reply = &result;
+   int err = Push(cmd);
+   if (err)
    {
-      return -1;
+      return err;
    }
-   command = CAMERA;
-   for (int i = 0; i < 9; i++)
+
+   // Terminate() removes the command from the queue and wakes us up
+   pthread_mutex_lock(&glvis_mutex);
+   while (!result.done && !terminating)
    {
-      camera[i] = cam[i];
+      pthread_cond_wait(&glvis_cond, &glvis_mutex);
    }
-   if (signal() < 0)
+   pthread_mutex_unlock(&glvis_mutex);
+   if (!result.done)
    {
-      return -2;
+      return -1;
    }
+   reply = result.text;
    return 0;
 }
 
-int GLVisCommand::Autopause(const char *mode)
+void GLVisCommand::Reply(Command &cmd, const string &text)
 {
-   if (lock() < 0)
-   {
-      return -1;
-   }
-   command = AUTOPAUSE;
-   autopause_mode = mode;
-   if (signal() < 0)
+   pthread_mutex_lock(&glvis_mutex);
+   cmd.reply->text = text;
+   cmd.reply->done = true;
+   pthread_cond_broadcast(&glvis_cond);
+   pthread_mutex_unlock(&glvis_mutex);
+}
+
+int GLVisCommand::Probe(const double x[3], string &reply)
+{
+   Command cmd;
+   cmd.type = PROBE;
+   for (int i = 0; i < 3; i++)
    {
-      return -2;
+      cmd.probe_x[i] = x[i];
    }
-   return 0;
+   return Request(cmd, reply);
 }
 
-extern GridFunction *ProjectVectorFEGridFunction(GridFunction*);
+int GLVisCommand::Stats(string &reply)
+{
+   Command cmd;
+   cmd.type = STATS;
+   return Request(cmd, reply);
+}
+
+int GLVisCommand::Sync(string &reply)
+{
+   Command cmd;
+   cmd.type = SYNC;
+   return Request(cmd, reply);
+}
 
 int GLVisCommand::Execute()
 {
@@ -427,7 +498,42 @@ int GLVisCommand::Execute()
       return -1;
    }
 
-   switch (command)
+   ProfileTimer timer("GLVisCommand::Execute");
+
+   // Execute all queued commands and redraw the window once at the end. Stop
+   // early if one of the commands paused the communication threads.
+   Command cmd;
+   bool redraw = false;
+   while (visualize == 1 && Pop(cmd))
+   {
+      RunCommand(cmd, redraw);
+   }
+   if (redraw)
+   {
+      MyExpose();
+   }
+
+   // wake up the main loop again if commands are left in the queue
+   pthread_mutex_lock(&glvis_mutex);
+   if (q_size > 0)
+   {
+      if (signal() < 0)
+      {
+         pthread_mutex_unlock(&glvis_mutex);
+         return -2;
+      }
+   }
+   else
+   {
+      signaled = false;
+   }
+   pthread_mutex_unlock(&glvis_mutex);
+   return 0;
+}
+
+void GLVisCommand::RunCommand(Command &cmd, bool &redraw)
+{
+   switch (cmd.type)
    {
       case NO_COMMAND:
          break;
@@ -435,45 +541,49 @@ int GLVisCommand::Execute()
       case NEW_MESH_AND_SOLUTION:
       {
          double mesh_range = -1.0;
-         if (new_g == NULL)
+         if (cmd.new_g == NULL)
          {
-            SetMeshSolution(new_m, new_g, false);
-            mesh_range = new_g->Max() + 1.0;
+            SetMeshSolution(cmd.new_m, cmd.new_g, false);
+            mesh_range = cmd.new_g->Max() + 1.0;
+            cmd.prep_state = NOT_PREPARED;
          }
-         if (new_m->SpaceDimension() == (*mesh)->SpaceDimension() &&
-             new_g->VectorDim() == (*grid_f)->VectorDim())
+         if (cmd.prep_state != PREPARED)
          {
-            if (new_m->SpaceDimension() == 2)
+            PrepareSolution(cmd);
+         }
+         if (cmd.new_m->SpaceDimension() == (*mesh)->SpaceDimension() &&
+             cmd.new_g->VectorDim() == (*grid_f)->VectorDim())
+         {
+            if (cmd.new_m->SpaceDimension() == 2)
             {
-               if (new_g->VectorDim() == 1)
+               if (cmd.new_g->VectorDim() == 1)
                {
                   VisualizationSceneSolution *vss =
                      dynamic_cast<VisualizationSceneSolution *>(*vs);
-                  new_g->GetNodalValues(*sol);
-                  vss->NewMeshAndSolution(new_m, sol, new_g);
+                  sol->Swap(*cmd.new_sol);
+                  vss->NewMeshAndSolution(cmd.new_m, sol, cmd.new_g);
                }
                else
                {
                   VisualizationSceneVector *vsv =
                      dynamic_cast<VisualizationSceneVector *>(*vs);
-                  vsv->NewMeshAndSolution(*new_g);
+                  vsv->NewMeshAndSolution(*cmd.new_g);
                }
             }
             else
             {
-               if (new_g->VectorDim() == 1)
+               if (cmd.new_g->VectorDim() == 1)
                {
                   VisualizationSceneSolution3d *vss =
                      dynamic_cast<VisualizationSceneSolution3d *>(*vs);
-                  new_g->GetNodalValues(*sol);
-                  vss->NewMeshAndSolution(new_m, sol, new_g);
+                  sol->Swap(*cmd.new_sol);
+                  vss->NewMeshAndSolution(cmd.new_m, sol, cmd.new_g);
                }
                else
                {
-                  new_g = ProjectVectorFEGridFunction(new_g);
                   VisualizationSceneVector3d *vss =
                      dynamic_cast<VisualizationSceneVector3d *>(*vs);
-                  vss->NewMeshAndSolution(new_m, new_g);
+                  vss->NewMeshAndSolution(cmd.new_m, cmd.new_g);
                }
             }
             if (mesh_range > 0.0)
@@ -481,18 +591,19 @@ int GLVisCommand::Execute()
                (*vs)->SetValueRange(-mesh_range, mesh_range);
             }
             delete (*grid_f);
-            *grid_f = new_g;
+            *grid_f = cmd.new_g;
             delete (*mesh);
-            *mesh = new_m;
+            *mesh = cmd.new_m;
 
-            (*vs)->Draw();
+            redraw = true;
          }
          else
          {
             cout << "Stream: field type does not match!" << endl;
-            delete new_g;
-            delete new_m;
+            delete cmd.new_g;
+            delete cmd.new_m;
          }
+         delete cmd.new_sol;
          if (autopause)
          {
             cout << "Autopause ..." << endl;
@@ -504,65 +615,75 @@ int GLVisCommand::Execute()
       case SCREENSHOT:
       {
          cout << "Command: screenshot: " << flush;
-         if (::Screenshot(screenshot_filename.c_str(), true))
+         if (redraw)
+         {
+            // bring the window up to date with the previous commands
+            MyExpose();
+            redraw = false;
+         }
+         if (::Screenshot(cmd.screenshot_filename.c_str(), true))
          {
-            cout << "Screenshot(" << screenshot_filename << ") failed." << endl;
+            cout << "Screenshot(" << cmd.screenshot_filename << ") failed."
+                 << endl;
          }
          else
          {
-            cout << "-> " << screenshot_filename << endl;
+            cout << "-> " << cmd.screenshot_filename << endl;
          }
          break;
       }
 
       case KEY_COMMANDS:
       {
-         cout << "Command: keys: '" << key_commands << "'" << endl;
-         // SendKeySequence(key_commands.c_str());
-         CallKeySequence(key_commands.c_str());
-         MyExpose();
+         cout << "Command: keys: '" << cmd.key_commands << "'" << endl;
+         // SendKeySequence(cmd.key_commands.c_str());
+         CallKeySequence(cmd.key_commands.c_str());
+         redraw = true;
          break;
       }
 
       case WINDOW_SIZE:
       {
-         cout << "Command: window_size: " << window_w << " x " << window_h << endl;
-         ResizeWindow(window_w, window_h);
+         cout << "Command: window_size: " << cmd.window_w << " x "
+              << cmd.window_h << endl;
+         ResizeWindow(cmd.window_w, cmd.window_h);
          break;
       }
 
       case WINDOW_GEOMETRY:
       {
          cout << "Command: window_geometry: "
-              << "@(" << window_x << "," << window_y << ") "
-              << window_w << " x " << window_h << endl;
-         MoveResizeWindow(window_x, window_y, window_w, window_h);
+              << "@(" << cmd.window_x << "," << cmd.window_y << ") "
+              << cmd.window_w << " x " << cmd.window_h << endl;
+         MoveResizeWindow(cmd.window_x, cmd.window_y,
+                          cmd.window_w, cmd.window_h);
          break;
       }
 
       case WINDOW_TITLE:
       {
-         cout << "Command: window_title: " << window_title << endl;
-         SetWindowTitle(window_title.c_str());
+         cout << "Command: window_title: " << cmd.window_title << endl;
+         SetWindowTitle(cmd.window_title.c_str());
          break;
       }
 
       case PLOT_CAPTION:
       {
-         cout << "Command: plot_caption: " << plot_caption << endl;
-         ::plot_caption = plot_caption;
+         cout << "Command: plot_caption: " << cmd.plot_caption << endl;
+         ::plot_caption = cmd.plot_caption;
          (*vs)->UpdateCaption(); // turn on or off the caption
-         MyExpose();
+         redraw = true;
          break;
       }
 
       case AXIS_LABELS:
       {
-         cout << "Command: axis_labels: '" << axis_label_x << "' '"
-              << axis_label_y << "' '" << axis_label_z << "'" << endl;
-         (*vs)->SetAxisLabels(axis_label_x.c_str(), axis_label_y.c_str(),
-                              axis_label_z.c_str());
-         MyExpose();
+         cout << "Command: axis_labels: '" << cmd.axis_label_x << "' '"
+              << cmd.axis_label_y << "' '" << cmd.axis_label_z << "'" << endl;
+         (*vs)->SetAxisLabels(cmd.axis_label_x.c_str(),
+                              cmd.axis_label_y.c_str(),
+                              cmd.axis_label_z.c_str());
+         redraw = true;
          break;
       }
 
@@ -575,36 +696,36 @@ int GLVisCommand::Execute()
 
       case VIEW_ANGLES:
       {
-         cout << "Command: view: " << view_ang_theta << ' ' << view_ang_phi
-              << endl;
-         (*vs)->SetView(view_ang_theta, view_ang_phi);
-         MyExpose();
+         cout << "Command: view: " << cmd.view_ang_theta << ' '
+              << cmd.view_ang_phi << endl;
+         (*vs)->SetView(cmd.view_ang_theta, cmd.view_ang_phi);
+         redraw = true;
          break;
       }
 
       case ZOOM:
       {
-         cout << "Command: zoom: " << zoom_factor << endl;
-         (*vs)->Zoom(zoom_factor);
-         MyExpose();
+         cout << "Command: zoom: " << cmd.zoom_factor << endl;
+         (*vs)->Zoom(cmd.zoom_factor);
+         redraw = true;
          break;
       }
 
       case SUBDIVISIONS:
       {
          cout << "Command: subdivisions: " << flush;
-         (*vs)->SetRefineFactors(subdiv_tot, subdiv_bdr);
-         cout << subdiv_tot << ' ' << subdiv_bdr << endl;
-         MyExpose();
+         (*vs)->SetRefineFactors(cmd.subdiv_tot, cmd.subdiv_bdr);
+         cout << cmd.subdiv_tot << ' ' << cmd.subdiv_bdr << endl;
+         redraw = true;
          break;
       }
 
       case VALUE_RANGE:
       {
          cout << "Command: valuerange: " << flush;
-         (*vs)->SetValueRange(val_min, val_max);
-         cout << val_min << ' ' << val_max << endl;
-         MyExpose();
+         (*vs)->SetValueRange(cmd.val_min, cmd.val_max);
+         cout << cmd.val_min << ' ' << cmd.val_max << endl;
+         redraw = true;
          break;
       }
 
@@ -612,27 +733,27 @@ int GLVisCommand::Execute()
       {
          cout << "Command: shading: " << flush;
          int s = -1;
-         if (shading == "flat")
+         if (cmd.shading == "flat")
          {
             s = 0;
          }
-         else if (shading == "smooth")
+         else if (cmd.shading == "smooth")
          {
             s = 1;
          }
-         else if (shading == "cool")
+         else if (cmd.shading == "cool")
          {
             s = 2;
          }
          if (s != -1)
          {
             (*vs)->SetShading(s, false);
-            cout << shading << endl;
-            MyExpose();
+            cout << cmd.shading << endl;
+            redraw = true;
          }
          else
          {
-            cout << shading << " ?" << endl;
+            cout << cmd.shading << " ?" << endl;
          }
          break;
       }
@@ -640,29 +761,29 @@ int GLVisCommand::Execute()
       case VIEW_CENTER:
       {
          cout << "Command: viewcenter: "
-              << view_center_x << ' ' << view_center_y << endl;
-         (*vs)->ViewCenterX = view_center_x;
-         (*vs)->ViewCenterY = view_center_y;
-         MyExpose();
+              << cmd.view_center_x << ' ' << cmd.view_center_y << endl;
+         (*vs)->ViewCenterX = cmd.view_center_x;
+         (*vs)->ViewCenterY = cmd.view_center_y;
+         redraw = true;
          break;
       }
 
       case AUTOSCALE:
       {
-         cout << "Command: autoscale: " << autoscale_mode;
-         if (autoscale_mode == "off")
+         cout << "Command: autoscale: " << cmd.autoscale_mode;
+         if (cmd.autoscale_mode == "off")
          {
             (*vs)->SetAutoscale(0);
          }
-         else if (autoscale_mode == "on")
+         else if (cmd.autoscale_mode == "on")
          {
             (*vs)->SetAutoscale(1);
          }
-         else if (autoscale_mode == "value")
+         else if (cmd.autoscale_mode == "value")
          {
             (*vs)->SetAutoscale(2);
          }
-         else if (autoscale_mode == "mesh")
+         else if (cmd.autoscale_mode == "mesh")
          {
             (*vs)->SetAutoscale(3);
          }
@@ -676,26 +797,26 @@ int GLVisCommand::Execute()
 
       case PALETTE:
       {
-         cout << "Command: palette: " << palette << endl;
-         Set_Palette(palette-1);
+         cout << "Command: palette: " << cmd.palette << endl;
+         Set_Palette(cmd.palette-1);
          if (!GetUseTexture())
          {
             (*vs)->EventUpdateColors();
          }
-         MyExpose();
+         redraw = true;
          break;
       }
 
       case PALETTE_REPEAT:
       {
-         cout << "Command: palette_repeat: " << palette_repeat << endl;
-         RepeatPaletteTimes = palette_repeat;
+         cout << "Command: palette_repeat: " << cmd.palette_repeat << endl;
+         RepeatPaletteTimes = cmd.palette_repeat;
          Set_Texture_Image();
          if (!GetUseTexture())
          {
             (*vs)->EventUpdateColors();
          }
-         MyExpose();
+         redraw = true;
          break;
       }
 
@@ -704,17 +825,17 @@ int GLVisCommand::Execute()
          cout << "Command: camera: ";
          for (int i = 0; i < 9; i++)
          {
-            cout << ' ' << camera[i];
+            cout << ' ' << cmd.camera[i];
          }
          cout << endl;
-         (*vs)->cam.Set(camera);
-         MyExpose();
+         (*vs)->cam.Set(cmd.camera);
+         redraw = true;
          break;
       }
 
       case AUTOPAUSE:
       {
-         if (autopause_mode == "off" || autopause_mode == "0")
+         if (cmd.autopause_mode == "off" || cmd.autopause_mode == "0")
          {
             autopause = 0;
          }
@@ -734,37 +855,89 @@ int GLVisCommand::Execute()
          break;
       }
 
+      case PROBE:
+      {
+         cout << "Command: probe: ";
+         (*vs)->PrintProbe(cmd.probe_x);
+
+         Vector vals;
+         ostringstream text;
+         text << (*vs)->Probe(cmd.probe_x, vals);
+         for (int i = 0; i < vals.Size(); i++)
+         {
+            text << ' ' << vals(i);
+         }
+         Reply(cmd, text.str());
+         break;
+      }
+
+      case STATS:
+      {
+         cout << "Command: stats:" << endl;
+         ProfilerPrint(cout);
+
+         ostringstream text;
+         ProfilerPrint(text);
+         Reply(cmd, text.str());
+         break;
+      }
+
+      case SYNC:
+      {
+         // present the frame with all the previous commands applied,
+         // including the refined values computed in the background
+         if (redraw)
+         {
+            MyExpose();
+            redraw = false;
+         }
+         if ((*vs)->FinishPrepare())
+         {
+            MyExpose();
+         }
+         glFinish();
+
+         ostringstream text;
+         text << NumDropped();
+         Reply(cmd, text.str());
+         break;
+      }
    }
+}
 
-   command = NO_COMMAND;
-   unlock();
-   return 0;
+int GLVisCommand::NumDropped()
+{
+   pthread_mutex_lock(&glvis_mutex);
+   int n = num_dropped;
+   pthread_mutex_unlock(&glvis_mutex);
+   return n;
 }
 
 void GLVisCommand::Terminate()
 {
-   char c;
-   int n = read(pfd[0], &c, 1);
-
    pthread_mutex_lock(&glvis_mutex);
    terminating = true;
+   pthread_cond_broadcast(&glvis_cond);
    pthread_mutex_unlock(&glvis_mutex);
-   if (n == 1 && c == 's')
+
+   if (prep_started)
    {
-      switch (command)
-      {
-         case NEW_MESH_AND_SOLUTION:
-            delete new_g;
-            delete new_m;
-            break;
-      }
-      unlock();
+      pthread_join(prep_tid, NULL);
    }
+
    pthread_mutex_lock(&glvis_mutex);
-   if (num_waiting > 0)
+   for ( ; q_size > 0; q_size--)
    {
-      pthread_cond_broadcast(&glvis_cond);
+      Command &cmd = queue[q_first];
+      if (cmd.type == NEW_MESH_AND_SOLUTION)
+      {
+         delete cmd.new_sol;
+         delete cmd.new_g;
+         delete cmd.new_m;
+      }
+      q_first = (q_first+1)%QUEUE_SIZE;
    }
+   pthread_cond_broadcast(&glvis_cond);
    pthread_mutex_unlock(&glvis_mutex);
 }
 
@@ -784,9 +957,14 @@ void GLVisCommand::ToggleAutopause()
 
 GLVisCommand::~GLVisCommand()
 {
-   if (num_waiting > 0)
-      cout << "\nGLVisCommand::~GLVisCommand() : num_waiting = "
-           << num_waiting << '\n' << endl;
+   if (q_size > 0)
+      cout << "\nGLVisCommand::~GLVisCommand() : q_size = "
+           << q_size << '\n' << endl;
+   if (num_dropped > 0)
+   {
+      cout << "Stream: " << num_dropped << " solution update(s) were skipped"
+           << endl;
+   }
    close(pfd[0]);
    close(pfd[1]);
    pthread_cond_destroy(&glvis_cond);
@@ -817,6 +995,29 @@ communication_thread::~communication_thread()
    delete new_m;
 }
 
+void communication_thread::SkipEchoedCommand(int nargs)
+{
+   // all processors sent the command
+   for (int i = 1; i < is.Size(); i++)
+   {
+      *is[i] >> ws >> ident;
+      for (int j = 0; j < nargs; j++)
+      {
+         double a;
+         *is[i] >> a;
+      }
+   }
+}
+
+void communication_thread::SendReply(const string &msg)
+{
+   socketstream *isock = dynamic_cast<socketstream *>(is[0]);
+   if (isock)
+   {
+      *isock << msg << flush;
+   }
+}
+
 // defined in glvis.cpp
 extern void Extrude1DMeshAndSolution(Mesh **, GridFunction **, Vector *);
 
@@ -839,6 +1040,7 @@ void *communication_thread::execute(void *p)
       if (_this->ident == "mesh" || _this->ident == "solution" ||
           _this->ident == "parallel")
       {
+         const double parse_start = ProfilerTime();
          bool fix_elem_orient = glvis_command->FixElementOrientations();
          if (_this->ident == "mesh")
          {
@@ -916,6 +1118,7 @@ void *communication_thread::execute(void *p)
          // cout << "Stream: new solution" << endl;
 
          Extrude1DMeshAndSolution(&_this->new_m, &_this->new_g, NULL);
+         ProfilerRecord("Stream::Parse", parse_start, ProfilerTime());
 
          if (glvis_command->NewMeshAndSolution(_this->new_m, _this->new_g))
          {
@@ -1290,6 +1493,54 @@ void *communication_thread::execute(void *p)
             goto comm_terminate;
          }
       }
+      else if (_this->ident == "probe")
+      {
+         double x[3];
+         string reply;
+
+         *_this->is[0] >> x[0] >> x[1] >> x[2];
+         _this->SkipEchoedCommand(3);
+
+         if (glvis_command->Probe(x, reply))
+         {
+            goto comm_terminate;
+         }
+
+         // send "probe <element> <value(s)>" back, element is -1 if the point
+         // is outside the mesh
+         _this->SendReply("probe " + reply + '\n');
+      }
+      else if (_this->ident == "stats")
+      {
+         string reply;
+
+         _this->SkipEchoedCommand();
+
+         if (glvis_command->Stats(reply))
+         {
+            goto comm_terminate;
+         }
+
+         // send "stats <n>" back, followed by the n lines of the table
+         ostringstream msg;
+         msg << "stats " << count(reply.begin(), reply.end(), '\n') << '\n'
+             << reply;
+         _this->SendReply(msg.str());
+      }
+      else if (_this->ident == "sync")
+      {
+         string reply;
+
+         _this->SkipEchoedCommand();
+
+         if (glvis_command->Sync(reply))
+         {
+            goto comm_terminate;
+         }
+
+         // send "sync <dropped>" back once the frame is drawn
+         _this->SendReply("sync " + reply + '\n');
+      }
       else
       {
          cout << "Stream: unknown command: " << _this->ident << endl;
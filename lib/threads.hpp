@@ -26,11 +26,12 @@ private:
    mfem::Vector         *sol;
    bool                 *keep_attr;
    bool                 *fix_elem_orient;
+   bool                 *coalesce_updates;
 
    pthread_mutex_t glvis_mutex;
    pthread_cond_t  glvis_cond;
-   int num_waiting;
    bool terminating;
+   bool signaled; // a wake-up byte has been written to the pipe
    int pfd[2];  // pfd[0] -- reading, pfd[1] -- writing
 
    enum
@@ -55,47 +56,87 @@ private:
       WINDOW_GEOMETRY = 17,
       PLOT_CAPTION = 18,
       AXIS_LABELS = 19,
-      PALETTE_REPEAT = 20
+      PALETTE_REPEAT = 20,
+      PROBE = 21,
+      STATS = 22,
+      SYNC = 23
    };
 
-   // command to be executed
-   int command;
+   // state of the data prepared for NEW_MESH_AND_SOLUTION off the main thread
+   enum { NOT_PREPARED, PREPARING, PREPARED };
 
-   // command arguments
-   Mesh         *new_m;
-   GridFunction *new_g;
-   std::string   screenshot_filename;
-   std::string   key_commands;
-   int           window_x, window_y;
-   int           window_w, window_h;
-   std::string   window_title;
-   std::string   plot_caption;
-   std::string   axis_label_x;
-   std::string   axis_label_y;
-   std::string   axis_label_z;
-   double        view_ang_theta, view_ang_phi;
-   double        zoom_factor;
-   int           subdiv_tot, subdiv_bdr;
-   double        val_min, val_max;
-   std::string   shading;
-   double        view_center_x, view_center_y;
-   std::string   autoscale_mode;
-   int           palette, palette_repeat;
-   double        camera[9];
-   std::string   autopause_mode;
+   // result of a PROBE, STATS or SYNC command, set by the main thread
+   struct CommandReply
+   {
+      bool        done;
+      std::string text;
+   };
+
+   // command to be executed together with its arguments
+   struct Command
+   {
+      int           type;
+      int           prep_state;
+      Mesh         *new_m;
+      GridFunction *new_g;
+      Vector       *new_sol; // nodal values of new_g (scalar fields)
+      std::string   screenshot_filename;
+      std::string   key_commands;
+      int           window_x, window_y;
+      int           window_w, window_h;
+      std::string   window_title;
+      std::string   plot_caption;
+      std::string   axis_label_x;
+      std::string   axis_label_y;
+      std::string   axis_label_z;
+      double        view_ang_theta, view_ang_phi;
+      double        zoom_factor;
+      int           subdiv_tot, subdiv_bdr;
+      double        val_min, val_max;
+      std::string   shading;
+      double        view_center_x, view_center_y;
+      std::string   autoscale_mode;
+      int           palette, palette_repeat;
+      double        camera[9];
+      std::string   autopause_mode;
+      double        probe_x[3];
+      CommandReply *reply;
+   };
+
+   // Circular queue of commands, filled by the worker threads and drained by
+   // the main thread in Execute(); protected by glvis_mutex.
+   static const int QUEUE_SIZE = 32;
+   Command queue[QUEUE_SIZE];
+   int q_first, q_size;
+
+   // number of solution updates replaced by newer ones (coalesce_updates)
+   int num_dropped;
 
    // internal variables
    int autopause;
 
-   int lock();
+   // thread computing the nodal values (or projecting vector FE fields) of
+   // queued solutions while the main thread is drawing
+   pthread_t prep_tid;
+   bool prep_started; // if false, Execute() prepares the solutions itself
+   static void PrepareSolution(Command &cmd);
+   static void *prepare_thread(void *);
+
+   bool Merge(Command &last, const Command &cmd);
+   int Push(const Command &cmd);
+   bool Pop(Command &cmd);
+   // Push a command with a reply and wait until the main thread has set it.
+   int Request(Command &cmd, std::string &reply);
+   // Set the reply of a command and wake up the thread waiting for it.
+   void Reply(Command &cmd, const std::string &text);
    int signal();
-   void unlock();
+   void RunCommand(Command &cmd, bool &redraw);
 
 public:
    // called by the main execution thread
    GLVisCommand(VisualizationSceneScalarData **_vs, Mesh **_mesh,
                 GridFunction **_grid_f, Vector *_sol, bool *_keep_attr,
-                bool *_fix_elem_orient);
+                bool *_fix_elem_orient, bool *_coalesce_updates);
 
    // to be used by the main execution (visualization) thread
    int ReadFD() { return pfd[0]; }
@@ -104,6 +145,9 @@ public:
    bool KeepAttrib() { return *keep_attr; } // may need to sync this
    bool FixElementOrientations() { return *fix_elem_orient; }
 
+   // number of solution updates skipped in coalescing mode
+   int NumDropped();
+
    // called by worker threads
    int NewMeshAndSolution(Mesh *_new_m, GridFunction *_new_g);
    int Screenshot(const char *filename);
@@ -125,6 +169,16 @@ public:
    int PaletteRepeat(int n);
    int Camera(const double cam[]);
    int Autopause(const char *mode);
+   // Waits until the main thread has evaluated the solution at 'x' and
+   // returns the element number followed by the value(s) in 'reply'.
+   int Probe(const double x[3], std::string &reply);
+   // Waits until the main thread has printed the timing statistics (see
+   // ProfilerPrint()) and returns them in 'reply'.
+   int Stats(std::string &reply);
+   // Waits until the main thread has applied all the preceding commands and
+   // drawn the window, and returns the number of dropped solution updates
+   // (see NumDropped()) in 'reply'.
+   int Sync(std::string &reply);
 
    // called by the main execution thread
    int Execute();
@@ -164,6 +218,12 @@ private:
       pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
    }
 
+   // Read the copies of the current command, with 'nargs' numbers, sent by
+   // the other processors.
+   void SkipEchoedCommand(int nargs = 0);
+   // Send 'msg' back to the first processor, if it is connected by a socket.
+   void SendReply(const std::string &msg);
+
    static void *execute(void *);
 
 public:
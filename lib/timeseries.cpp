@@ -0,0 +1,519 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#include "mfem.hpp"
+using namespace mfem;
+using namespace std;
+
+#include "timeseries.hpp"
+
+static const char ts_magic[] = "glvis-timeseries";
+static const char ts_frames[] = "frames";
+
+enum { KEY_FRAME = 0, DELTA_FRAME = 1 };
+
+typedef unsigned long long uint64;
+
+// Adaptive binary range coder (as in LZMA): each bit is coded with a 11-bit
+// probability that is updated after the bit.
+static const unsigned rc_top = 1u << 24;
+static const int rc_prob_bits = 11, rc_move_bits = 5;
+
+class RangeEncoder
+{
+private:
+   vector<char> &out;
+   uint64 low;
+   unsigned range;
+   unsigned char cache;
+   long cache_size;
+
+   void ShiftLow()
+   {
+      if ((unsigned)low < 0xff000000u || (low >> 32) != 0)
+      {
+         unsigned char carry = (unsigned char)(low >> 32), c = cache;
+         do
+         {
+            out.push_back((char)(unsigned char)(c + carry));
+            c = 0xff;
+         }
+         while (--cache_size != 0);
+         cache = (unsigned char)((unsigned)low >> 24);
+      }
+      cache_size++;
+      low = (low & 0x00ffffffu) << 8;
+   }
+
+public:
+   RangeEncoder(vector<char> &out_)
+      : out(out_), low(0), range(0xffffffffu), cache(0), cache_size(1) { }
+
+   void Encode(unsigned short &prob, int bit)
+   {
+      const unsigned bound = (range >> rc_prob_bits)*prob;
+      if (bit == 0)
+      {
+         range = bound;
+         prob += ((1 << rc_prob_bits) - prob) >> rc_move_bits;
+      }
+      else
+      {
+         low += bound;
+         range -= bound;
+         prob -= prob >> rc_move_bits;
+      }
+      while (range < rc_top)
+      {
+         range <<= 8;
+         ShiftLow();
+      }
+   }
+
+   void Finish() { for (int i = 0; i < 5; i++) { ShiftLow(); } }
+};
+
+class RangeDecoder
+{
+private:
+   const unsigned char *in, *end;
+   unsigned range, code;
+
+   unsigned Next() { return (in < end) ? *in++ : 0; }
+
+public:
+   RangeDecoder(const char *data, size_t size)
+      : in((const unsigned char *)data), end(in + size), range(0xffffffffu),
+        code(0)
+   {
+      for (int i = 0; i < 5; i++) { code = (code << 8) | Next(); }
+   }
+
+   int Decode(unsigned short &prob)
+   {
+      const unsigned bound = (range >> rc_prob_bits)*prob;
+      int bit;
+      if (code < bound)
+      {
+         range = bound;
+         prob += ((1 << rc_prob_bits) - prob) >> rc_move_bits;
+         bit = 0;
+      }
+      else
+      {
+         code -= bound;
+         range -= bound;
+         prob -= prob >> rc_move_bits;
+         bit = 1;
+      }
+      while (range < rc_top)
+      {
+         range <<= 8;
+         code = (code << 8) | Next();
+      }
+      return bit;
+   }
+};
+
+// The differences are coded value by value: first the number of leading zero
+// bytes (8 for equal values), in the context of the previous count, then the
+// remaining bytes from the most significant one, in the context of their
+// position.
+struct DeltaModel
+{
+   unsigned short zeros[9][16];
+   unsigned short bytes[8][2][256];
+
+   DeltaModel()
+   {
+      unsigned short *p = &zeros[0][0];
+      for (size_t i = 0; i < sizeof(zeros)/sizeof(p[0]); i++)
+      {
+         p[i] = 1 << (rc_prob_bits - 1);
+      }
+      p = &bytes[0][0][0];
+      for (size_t i = 0; i < sizeof(bytes)/sizeof(p[0]); i++)
+      {
+         p[i] = 1 << (rc_prob_bits - 1);
+      }
+   }
+};
+
+// The difference of the bit patterns of two doubles, with the sign moved to
+// the lowest bit, so that small differences of either sign have many leading
+// zero bytes.
+static inline uint64 BitDelta(double a, double b)
+{
+   uint64 ua, ub;
+   memcpy(&ua, &a, sizeof(ua));
+   memcpy(&ub, &b, sizeof(ub));
+   const uint64 d = ua - ub;
+   return (d >> 63) ? ~(d << 1) : (d << 1);
+}
+
+static inline double AddBitDelta(double b, uint64 z)
+{
+   const uint64 d = (z & 1) ? ~(z >> 1) : (z >> 1);
+   uint64 ub;
+   memcpy(&ub, &b, sizeof(ub));
+   ub += d;
+   memcpy(&b, &ub, sizeof(b));
+   return b;
+}
+
+static void EncodeDeltas(const vector<uint64> &x, vector<char> &out)
+{
+   DeltaModel model;
+   RangeEncoder rc(out);
+   int prev_nz = 0;
+   for (size_t i = 0; i < x.size(); i++)
+   {
+      int nz = 8;
+      while (nz > 0 && (x[i] >> (8*(8-nz))) != 0) { nz--; }
+      unsigned short *prob = model.zeros[prev_nz];
+      for (int b = 3, m = 1; b >= 0; b--)
+      {
+         const int bit = (nz >> b) & 1;
+         rc.Encode(prob[m], bit);
+         m = 2*m + bit;
+      }
+      for (int p = 7 - nz; p >= 0; p--)
+      {
+         const int byte = (int)((x[i] >> (8*p)) & 0xff);
+         prob = model.bytes[p][p == 7 - nz];
+         for (int b = 7, m = 1; b >= 0; b--)
+         {
+            const int bit = (byte >> b) & 1;
+            rc.Encode(prob[m], bit);
+            m = 2*m + bit;
+         }
+      }
+      prev_nz = nz;
+   }
+   rc.Finish();
+}
+
+static void DecodeDeltas(const char *data, size_t size, vector<uint64> &x)
+{
+   DeltaModel model;
+   RangeDecoder rc(data, size);
+   int prev_nz = 0;
+   for (size_t i = 0; i < x.size(); i++)
+   {
+      unsigned short *prob = model.zeros[prev_nz];
+      int m = 1;
+      for (int b = 0; b < 4; b++) { m = 2*m + rc.Decode(prob[m]); }
+      const int nz = min(m - 16, 8);
+      x[i] = 0;
+      for (int p = 7 - nz; p >= 0; p--)
+      {
+         prob = model.bytes[p][p == 7 - nz];
+         m = 1;
+         for (int b = 0; b < 8; b++) { m = 2*m + rc.Decode(prob[m]); }
+         x[i] |= uint64(m - 256) << (8*p);
+      }
+      prev_nz = nz;
+   }
+}
+
+// FNV-1a hash
+static void Hash(uint64 &h, const void *data, size_t size)
+{
+   const unsigned char *c = (const unsigned char *)data;
+   for (size_t i = 0; i < size; i++)
+   {
+      h = (h ^ c[i])*1099511628211ull;
+   }
+}
+
+// Identifies the mesh and the finite element space of 'gf' by their contents
+static uint64 SpaceSignature(GridFunction &gf)
+{
+   FiniteElementSpace *fes = gf.FESpace();
+   Mesh *mesh = fes->GetMesh();
+   uint64 h = 14695981039346656037ull;
+
+   const char *name = fes->FEColl()->Name();
+   Hash(h, name, strlen(name));
+   const int sdim = mesh->SpaceDimension();
+   int sizes[6] = { mesh->Dimension(), sdim, mesh->GetNV(), mesh->GetNE(),
+                    fes->GetVDim(), fes->GetOrdering()
+                  };
+   Hash(h, sizes, sizeof(sizes));
+   for (int i = 0; i < mesh->GetNV(); i++)
+   {
+      Hash(h, mesh->GetVertex(i), sdim*sizeof(double));
+   }
+   Array<int> v;
+   for (int i = 0; i < mesh->GetNE(); i++)
+   {
+      int attr[2] = { mesh->GetElementBaseGeometry(i), mesh->GetAttribute(i) };
+      Hash(h, attr, sizeof(attr));
+      mesh->GetElementVertices(i, v);
+      Hash(h, v.GetData(), v.Size()*sizeof(int));
+   }
+   // curved meshes
+   const GridFunction *nodes = mesh->GetNodes();
+   if (nodes)
+   {
+      const char *nname = nodes->FESpace()->FEColl()->Name();
+      Hash(h, nname, strlen(nname));
+      Hash(h, nodes->GetData(), nodes->Size()*sizeof(double));
+   }
+   return h;
+}
+
+TimeSeriesWriter::TimeSeriesWriter(const char *fname, Mesh &mesh,
+                                   GridFunction &gf, int bits_,
+                                   int key_interval_)
+   : file(fname, ios::out | ios::binary)
+{
+   bits = bits_;
+   if (bits != 0 && bits != 8 && bits != 16 && bits != 32)
+   {
+      cout << "TimeSeriesWriter: invalid number of bits: " << bits
+           << ", using 0 (lossless)." << endl;
+      bits = 0;
+   }
+   key_interval = (key_interval_ > 0) ? key_interval_ : 1;
+
+   file << ts_magic << '\n' << bits << ' ' << key_interval << '\n';
+   file.precision(16);
+   mesh.Print(file);
+   gf.Save(file);
+   file << '\n' << ts_frames << '\n';
+
+   space_id = SpaceSignature(gf);
+   prev.SetSize(gf.Size());
+   AddFrame(gf);
+}
+
+int TimeSeriesWriter::AddFrame(GridFunction &gf)
+{
+   const int n = gf.Size();
+   if (n != prev.Size() || SpaceSignature(gf) != space_id)
+   {
+      cout << "TimeSeriesWriter: the mesh or the finite element space of the"
+           " frame differ from those of the first frame" << endl;
+      return 1;
+   }
+
+   offsets.Append((long long)file.tellp());
+   int type = (offsets.Size()-1) % key_interval ? DELTA_FRAME : KEY_FRAME;
+   file.write((const char *)&type, sizeof(type));
+
+   if (type == KEY_FRAME)
+   {
+      file.write((const char *)gf.GetData(), n*sizeof(double));
+      prev = gf;
+   }
+   else if (bits == 0)
+   {
+      vector<uint64> x(n);
+      for (int i = 0; i < n; i++)
+      {
+         x[i] = BitDelta(gf(i), prev(i));
+      }
+      qbuf.clear();
+      EncodeDeltas(x, qbuf);
+      long long size = qbuf.size();
+      file.write((const char *)&size, sizeof(size));
+      file.write(&qbuf[0], size);
+      prev = gf;
+   }
+   else
+   {
+      // quantize the difference with the previous reconstructed frame, so
+      // the quantization errors do not accumulate
+      double dmax = 0.0;
+      for (int i = 0; i < n; i++)
+      {
+         dmax = max(dmax, fabs(gf(i) - prev(i)));
+      }
+      const double qmax = (bits == 32) ? 2147483647.0 : (1 << (bits-1)) - 1;
+      double scale = (dmax > 0.0) ? dmax/qmax : 1.0;
+      file.write((const char *)&scale, sizeof(scale));
+
+      const int bytes = bits/8;
+      qbuf.resize((size_t)n*bytes);
+      for (int i = 0; i < n; i++)
+      {
+         double q = floor((gf(i) - prev(i))/scale + 0.5);
+         q = min(max(q, -qmax), qmax);
+         if (bits == 8)
+         {
+            ((signed char *)&qbuf[0])[i] = (signed char)q;
+         }
+         else if (bits == 16)
+         {
+            ((short *)&qbuf[0])[i] = (short)q;
+         }
+         else
+         {
+            ((int *)&qbuf[0])[i] = (int)q;
+         }
+         prev(i) += q*scale;
+      }
+      file.write(&qbuf[0], qbuf.size());
+   }
+   return file.good() ? 0 : 2;
+}
+
+TimeSeriesWriter::~TimeSeriesWriter()
+{
+   int nframes = offsets.Size();
+   if (nframes > 0)
+   {
+      file.write((const char *)offsets.GetData(), nframes*sizeof(long long));
+   }
+   file.write((const char *)&nframes, sizeof(nframes));
+   file.close();
+}
+
+TimeSeriesReader::TimeSeriesReader(const char *fname)
+   : file(fname, ios::in | ios::binary)
+{
+   bits = key_interval = 0;
+   cur_frame = -1;
+
+   string line;
+   getline(file, line);
+   if (!file || line != ts_magic)
+   {
+      cout << "Not a GLVis time series file: " << fname << endl;
+      return;
+   }
+   file >> bits >> key_interval >> ws;
+   ostringstream hdr;
+   while (getline(file, line) && line != ts_frames)
+   {
+      hdr << line << '\n';
+   }
+   header = hdr.str();
+   if (!file || key_interval <= 0)
+   {
+      cout << "Invalid time series file: " << fname << endl;
+      return;
+   }
+
+   // read the frame index
+   int nframes;
+   file.seekg(-(streamoff)sizeof(nframes), ios::end);
+   file.read((char *)&nframes, sizeof(nframes));
+   if (!file || nframes <= 0)
+   {
+      cout << "Time series file without frames: " << fname << endl;
+      return;
+   }
+   offsets.SetSize(nframes);
+   file.seekg(-(streamoff)(sizeof(nframes) + nframes*sizeof(long long)),
+              ios::end);
+   file.read((char *)offsets.GetData(), nframes*sizeof(long long));
+   if (!file)
+   {
+      offsets.SetSize(0);
+   }
+}
+
+void TimeSeriesReader::NewMeshAndGridFunction(Mesh **mp, GridFunction **gp,
+                                              bool fix_elem_orient)
+{
+   istringstream hdr(header);
+   *mp = new Mesh(hdr, 1, 0, fix_elem_orient);
+   *gp = new GridFunction(*mp, hdr);
+}
+
+int TimeSeriesReader::ReadFrameData(int k, Vector &values)
+{
+   const int n = values.Size();
+   int type;
+   file.seekg(offsets[k]);
+   file.read((char *)&type, sizeof(type));
+   if (type == KEY_FRAME)
+   {
+      file.read((char *)values.GetData(), n*sizeof(double));
+   }
+   else if (bits == 0)
+   {
+      long long size;
+      file.read((char *)&size, sizeof(size));
+      if (!file || size <= 0)
+      {
+         return 1;
+      }
+      qbuf.resize(size);
+      file.read(&qbuf[0], size);
+      vector<uint64> x(n);
+      DecodeDeltas(&qbuf[0], size, x);
+      for (int i = 0; i < n; i++)
+      {
+         values(i) = AddBitDelta(values(i), x[i]);
+      }
+   }
+   else
+   {
+      double scale;
+      file.read((char *)&scale, sizeof(scale));
+      qbuf.resize((size_t)n*(bits/8));
+      file.read(&qbuf[0], qbuf.size());
+      for (int i = 0; i < n; i++)
+      {
+         double q;
+         if (bits == 8)
+         {
+            q = ((signed char *)&qbuf[0])[i];
+         }
+         else if (bits == 16)
+         {
+            q = ((short *)&qbuf[0])[i];
+         }
+         else
+         {
+            q = ((int *)&qbuf[0])[i];
+         }
+         values(i) += q*scale;
+      }
+   }
+   return file ? 0 : 1;
+}
+
+int TimeSeriesReader::ReadFrame(int k, Vector &values)
+{
+   if (k < 0 || k >= offsets.Size())
+   {
+      return 1;
+   }
+   if (cur_frame < 0 || k <= cur_frame || k - cur_frame > key_interval ||
+       cur_values.Size() != values.Size())
+   {
+      // restart from the nearest key frame
+      cur_values.SetSize(values.Size());
+      cur_frame = k - k % key_interval - 1;
+   }
+   while (cur_frame < k)
+   {
+      if (ReadFrameData(cur_frame+1, cur_values))
+      {
+         cur_frame = -1;
+         return 2;
+      }
+      cur_frame++;
+   }
+   values = cur_values;
+   return 0;
+}
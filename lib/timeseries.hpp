@@ -0,0 +1,102 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+#ifndef GLVIS_TIMESERIES
+#define GLVIS_TIMESERIES
+
+#include <mfem.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A time series file stores a mesh and a grid function once, followed by the
+// values (dofs) of the grid function for a sequence of time steps:
+//
+//    glvis-timeseries
+//    <bits> <key_interval>
+//    <mesh>
+//    <grid function>
+//    frames
+//    <binary frames>
+//    <binary frame index>
+//
+// Every 'key_interval'-th frame is stored with full double precision, the
+// other frames store the difference with the previous frame. When 'bits' is 8,
+// 16 or 32, the differences are quantized to integers of that size (lossy).
+// When it is 0, the series is lossless: the integer differences of the bit
+// patterns of the values and those of the previous frame, whose high bytes are
+// mostly zero for slowly changing values, are compressed with an adaptive
+// range coder. The frame index at the end of the file contains the offset of
+// each frame, followed by the number of frames.
+
+class TimeSeriesWriter
+{
+private:
+   std::ofstream file;
+   int bits, key_interval;
+   // identifies the mesh and the finite element space of the first frame
+   unsigned long long space_id;
+   mfem::Vector prev; // last frame, as it will be reconstructed when reading
+   mfem::Array<long long> offsets;
+   std::vector<char> qbuf;
+
+public:
+   // Start a new file with the given mesh and grid function; the values of
+   // 'gf' become the first frame.
+   TimeSeriesWriter(const char *fname, mfem::Mesh &mesh,
+                    mfem::GridFunction &gf, int bits_ = 0,
+                    int key_interval_ = 32);
+
+   bool good() { return file.good(); }
+
+   int NumFrames() { return offsets.Size(); }
+
+   // Append the values of 'gf' as a frame; returns 0 on success. The mesh and
+   // the finite element space of 'gf' must be the same as for the first frame
+   // (equal, not necessarily the same objects).
+   int AddFrame(mfem::GridFunction &gf);
+
+   // Write the frame index and close the file.
+   ~TimeSeriesWriter();
+};
+
+class TimeSeriesReader
+{
+private:
+   std::ifstream file;
+   std::string header; // mesh and grid function in text form
+   int bits, key_interval;
+   mfem::Array<long long> offsets;
+   mfem::Vector cur_values;
+   int cur_frame;
+   std::vector<char> qbuf;
+
+   int ReadFrameData(int k, mfem::Vector &values);
+
+public:
+   TimeSeriesReader(const char *fname);
+
+   bool good() { return offsets.Size() > 0; }
+
+   int NumFrames() { return offsets.Size(); }
+
+   // Construct the mesh and the grid function stored in the file.
+   void NewMeshAndGridFunction(mfem::Mesh **mp, mfem::GridFunction **gp,
+                               bool fix_elem_orient);
+
+   // Read the values of frame 'k' into 'values', which must have the size of
+   // the stored grid function. Reading the frames in increasing order only
+   // reads one frame per call; seeking goes back to the nearest key frame.
+   // Returns 0 on success.
+   int ReadFrame(int k, mfem::Vector &values);
+};
+
+#endif
@@ -58,6 +58,7 @@
 #include <poll.h>
 #endif
 #include <unistd.h>    // dup, dup2
+#include <sys/time.h>  // gettimeofday
 
 #include "visual.hpp"
 
@@ -94,6 +95,21 @@ static GLenum (*MouseUpFunc)(int, int, GLenum) = 0;
 static GLenum (*MouseMoveFunc)(int, int, GLenum) = 0;
 static void (*IdleFunc)(void) = 0;
 static int lastEventType = -1;
+
+/* Frame pacing: Expose events and DisplayFunc calls are not drawn right away,
+   tkExec() draws one frame for all of them after the queued events have been
+   processed, and at most one frame per 'interval' seconds. While events keep
+   arriving, a frame is drawn after at most 'budget' seconds of processing. */
+static struct _FRAMEINFO {
+    double interval, budget;
+    double last;                  /* time when the last frame was drawn */
+    int expose, display;          /* pending ExposeFunc/DisplayFunc calls */
+    unsigned long drawn;          /* frames drawn */
+    unsigned long skipped;        /* redraw requests merged into other frames */
+    unsigned long slow;           /* frames which took longer than 'interval' */
+} frameInfo = {
+    1.0/60, 1.0/60, 0.0, 0, 0, 0, 0, 0
+};
 static Colormap colorMap;
 static float colorMaps[] = {
     0.000000, 1.000000, 0.000000, 1.000000, 0.000000, 1.000000,
@@ -334,7 +350,11 @@ static GLenum DoNextEvent(void)
         }
         if (current.xexpose.count == 0) {
             if (ExposeFunc) {
-                (*ExposeFunc)(windInfo.width, windInfo.height);
+                /* drawn by tkExec(), see DrawFrame() */
+                if (frameInfo.expose) {
+                    frameInfo.skipped++;
+                }
+                frameInfo.expose = 1;
                 if (lastEventType == ConfigureNotify) {
                     lastEventType = Expose;
                     return GL_FALSE;
@@ -577,6 +597,9 @@ static GLenum DoNextEvent(void)
           case XK_asciitilde:   key = XK_asciitilde;    break;
           case XK_exclam:       key = XK_exclam;        break;
           case XK_at:           key = XK_at;            break;
+          case XK_numbersign:   key = XK_numbersign;    break;
+          case XK_dollar:       key = XK_dollar;        break;
+          case XK_percent:      key = XK_percent;       break;
           case XK_bracketleft:  key = XK_bracketleft;   break;
           case XK_bracketright: key = XK_bracketright;  break;
           case XK_parenleft:    key = XK_parenleft;     break;
@@ -586,6 +609,9 @@ static GLenum DoNextEvent(void)
                                 printf("display: %p\n",(void *)display);
                                 printf("window:  %p\n",(void *)window);
                                 printf("keys:    %s\n",hist);
+                                printf("frames:  %lu drawn, %lu skipped, "
+                                       "%lu slow\n", frameInfo.drawn,
+                                       frameInfo.skipped, frameInfo.slow);
 #ifdef GLVIS_DEBUG
           {
              printf("Display connection number: %d\n",
@@ -683,6 +709,96 @@ static GLenum DoNextEvent(void)
     return GL_FALSE;
 }
 
+static double GetTime(void)
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static int FramePending(void)
+{
+   return (frameInfo.expose || frameInfo.display);
+}
+
+static void DrawFrame(void)
+{
+   double start = GetTime();
+   if (frameInfo.expose)
+   {
+      frameInfo.expose = 0;
+      if (ExposeFunc)
+         (*ExposeFunc)(windInfo.width, windInfo.height);
+   }
+   if (frameInfo.display)
+   {
+      frameInfo.display = 0;
+      if (DisplayFunc)
+         (*DisplayFunc)();
+   }
+   frameInfo.last = GetTime();
+   frameInfo.drawn++;
+   if (frameInfo.interval > 0.0 && frameInfo.last - start > frameInfo.interval)
+      frameInfo.slow++;
+}
+
+/* Process the queued events, drawing the pending frame only before events that
+   may depend on what is on the screen, e.g. a key taking a screenshot or a
+   mouse click reading the depth buffer. */
+static void ProcessEvents(void)
+{
+   XEvent xe;
+   double start = GetTime();
+   do
+   {
+      if (FramePending())
+      {
+         XPeekEvent(display, &xe);
+         if (xe.type != Expose && xe.type != MotionNotify &&
+             xe.type != ConfigureNotify)
+            DrawFrame();
+      }
+      if (DoNextEvent())
+      {
+         if (frameInfo.display)
+            frameInfo.skipped++;
+         frameInfo.display = (DisplayFunc != 0);
+      }
+   }
+   while (visualize && XPending(display) &&
+          GetTime() - start < frameInfo.budget);
+}
+
+/* Wait until there are events on 'fd' or 'fd2' (if not negative) or 'timeout'
+   seconds have passed. */
+static void WaitForEvents(int fd, int fd2, double timeout)
+{
+   int ms = (int)(1e3*timeout) + 1;
+#ifndef GLVIS_USE_POLL
+   fd_set read_fds;
+   struct timeval tv;
+   FD_ZERO(&read_fds);
+   FD_SET(fd, &read_fds);
+   if (fd2 >= 0)
+      FD_SET(fd2, &read_fds);
+   tv.tv_sec = ms/1000;
+   tv.tv_usec = 1000*(ms%1000);
+   if (select(max(fd, fd2) + 1, &read_fds, NULL, NULL, &tv) == -1 &&
+       errno != EINTR)
+      perror("select()");
+#else
+   struct pollfd pfd[2];
+   pfd[0].fd = fd;
+   pfd[0].events = POLLIN;
+   pfd[0].revents = 0;
+   pfd[1].fd = fd2; /* ignored by poll() if negative */
+   pfd[1].events = POLLIN;
+   pfd[1].revents = 0;
+   if (poll(pfd, 2, ms) == -1 && errno != EINTR)
+      perror("poll()");
+#endif
+}
+
 void tkExec(void)
 {
    XEvent xe;
@@ -702,9 +818,36 @@ void tkExec(void)
    {
       if (XPending(display))
       {
-         if (DoNextEvent())
-            if (DisplayFunc)
-               (*DisplayFunc)();
+         ProcessEvents();
+      }
+      if (FramePending() && visualize)
+      {
+         double wait = frameInfo.last + frameInfo.interval - GetTime();
+         if (wait <= 0.0)
+         {
+            DrawFrame();
+            continue;
+         }
+         if (IdleFunc == NULL && !XPending(display))
+         {
+            /* more events or commands may arrive before the frame is due */
+            if (glvis_command == NULL || visualize == 2)
+            {
+               WaitForEvents(display_fd, -1, wait);
+               continue;
+            }
+            err = glvis_command->Execute();
+            if (err < 0)
+               break;
+            if (err > 0)
+               WaitForEvents(display_fd, command_fd, wait);
+            continue;
+         }
+      }
+
+      if (XPending(display) || !visualize)
+      {
+         continue;
       }
       else if (IdleFunc)
       {
@@ -814,6 +957,17 @@ void tkIdleFunc(void (*Func)(void))
     IdleFunc = Func;
 }
 
+void tkSetFrameRate(double fps)
+{
+    frameInfo.interval = (fps > 0.0) ? 1.0/fps : 0.0;
+    frameInfo.budget = (fps > 0.0) ? 1.0/fps : 1.0/60;
+}
+
+double tkGetFrameRate(void)
+{
+    return (frameInfo.interval > 0.0) ? 1.0/frameInfo.interval : 0.0;
+}
+
 /******************************************************************************/
 
 GLint tkGetColorMapSize(void)
@@ -1647,6 +1801,13 @@ void tkSetRGBMap(int size, float *rgb)
 void tkSwapBuffers(void)
 {
    if (display) {
+      GLint mode;
+
+      /* nothing was drawn while capturing in feedback mode */
+      glGetIntegerv(GL_RENDER_MODE, &mode);
+      if (mode != GL_RENDER) {
+         return;
+      }
 #ifdef GLVIS_GLX10
       glXSwapBuffers(display, window);
 #else
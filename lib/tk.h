@@ -215,6 +215,9 @@ extern void tkMouseDownFunc(GLenum (*)(int, int, GLenum));
 extern void tkMouseUpFunc(GLenum (*)(int, int, GLenum));
 extern void tkMouseMoveFunc(GLenum (*)(int, int, GLenum));
 extern void tkIdleFunc(void (*)(void));
+/* Maximum number of frames per second drawn by tkExec(), 0 means no limit. */
+extern void tkSetFrameRate(double);
+extern double tkGetFrameRate(void);
 
 extern void tkSwapBuffers(void);
 
@@ -18,10 +18,20 @@
 #include "material.hpp"
 #include "aux_vis.hpp"
 #include "openglvis.hpp"
+#include "pointlocator.hpp"
+#include "streamlines.hpp"
+#include "refinedvalues.hpp"
+#include "simplify.hpp"
 #include "vssolution.hpp"
 #include "vssolution3d.hpp"
 #include "vsvector.hpp"
 #include "vsvector3d.hpp"
 #include "threads.hpp"
+#include "session.hpp"
+#include "timeseries.hpp"
+#include "coloring.hpp"
+#include "profiler.hpp"
+#include "softrender.hpp"
+#include "workers.hpp"
 
 #endif
@@ -22,6 +22,9 @@ using namespace std;
 #include "aux_vis.hpp"
 #include "material.hpp"
 #include "palettes.hpp"
+#include "profiler.hpp"
+#include "softrender.hpp"
+#include "streamlines.hpp"
 
 #include "gl2ps.h"
 
@@ -290,6 +293,97 @@ void VisualizationSceneScalarData::Arrow(double px, double py, double pz,
    glEnd();
 }
 
+int VisualizationSceneScalarData::GetArrowList(int type, double cone_scale)
+{
+   for (int i = 0; i < arrow_lists.Size(); i++)
+   {
+      if (arrow_list_keys[2*i] == type &&
+          arrow_list_keys[2*i+1] == cone_scale)
+      {
+         return arrow_lists[i];
+      }
+   }
+
+   // display lists can not be created while another one is being compiled
+   GLint compiling;
+   glGetIntegerv(GL_LIST_INDEX, &compiling);
+   if (compiling)
+   {
+      return 0;
+   }
+
+   // Arrow() with unit scaling and direction (0,0,1) gives the unit arrow
+   double scale[3] = { xscale, yscale, zscale };
+   int old_type = arrow_type, scaling_type = arrow_scaling_type;
+   xscale = yscale = zscale = 1.0;
+   arrow_type = type;
+   arrow_scaling_type = 1;
+
+   int list = glGenLists(1);
+   glNewList(list, GL_COMPILE);
+   Arrow(0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 1.0, cone_scale);
+   glEndList();
+
+   xscale = scale[0];
+   yscale = scale[1];
+   zscale = scale[2];
+   arrow_type = old_type;
+   arrow_scaling_type = scaling_type;
+
+   arrow_lists.Append(list);
+   arrow_list_keys.Append(type);
+   arrow_list_keys.Append(cone_scale);
+   return list;
+}
+
+void VisualizationSceneScalarData::ArrowInstance(double px, double py,
+                                                 double pz, double vx,
+                                                 double vy, double vz,
+                                                 double length,
+                                                 double cone_scale)
+{
+   int list = GetArrowList(arrow_type, cone_scale);
+   if (!list)
+   {
+      Arrow(px, py, pz, vx, vy, vz, length, cone_scale);
+      return;
+   }
+
+   double rhos = sqrt (vx*vx+vy*vy+vz*vz);
+   if (rhos == 0.0)
+   {
+      return;
+   }
+   double phi = acos(vz/rhos), theta = atan2(vy, vx);
+
+   if (arrow_scaling_type == 0)
+   {
+      length = rhos;
+   }
+
+   // the transformation applied to the unit arrow by Arrow()
+   double M[3][3]= {{cos(theta)*cos(phi), -sin(theta),  cos(theta)*sin(phi)},
+      {sin(theta)*cos(phi),  cos(theta),  sin(theta)*sin(phi)},
+      {          -sin(phi),          0.,             cos(phi)}
+   };
+   double v[3] = { M[0][2]/xscale, M[1][2]/yscale, M[2][2]/zscale };
+   length /= sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+
+   const double s[3] = { length/xscale, length/yscale, length/zscale };
+   GLdouble A[16] =
+   {
+      M[0][0]*s[0], M[1][0]*s[1], M[2][0]*s[2], 0.0,
+      M[0][1]*s[0], M[1][1]*s[1], M[2][1]*s[2], 0.0,
+      M[0][2]*s[0], M[1][2]*s[1], M[2][2]*s[2], 0.0,
+      px,           py,           pz,           1.0
+   };
+
+   glPushMatrix();
+   glMultMatrixd(A);
+   glCallList(list);
+   glPopMatrix();
+}
+
 void VisualizationSceneScalarData::DrawColorBar (double minval, double maxval,
                                                  Array<double> *level,
                                                  Array<double> *levels)
@@ -328,6 +422,7 @@ void VisualizationSceneScalarData::DrawColorBar (double minval, double maxval,
    if (GetUseTexture())
    {
       glEnable (GL_TEXTURE_1D);
+      MarkRenderState();
       glColor4d(1, 1, 1, 1);
       glBegin(GL_QUADS);
       glTexCoord1d(0.);
@@ -338,6 +433,7 @@ void VisualizationSceneScalarData::DrawColorBar (double minval, double maxval,
       glVertex3d(minx, maxy, posz);
       glEnd();
       glDisable (GL_TEXTURE_1D);
+      MarkRenderState();
    }
    else
    {
@@ -594,6 +690,69 @@ void VisualizationSceneScalarData::DrawCaption()
    glPopMatrix();
 }
 
+// Draw the timing statistics (see ProfilerPrint) in the top left corner
+void VisualizationSceneScalarData::DrawStats()
+{
+   if (!drawstats) { return; }
+
+   ostringstream buf;
+   ProfilerPrint(buf, 12);
+   istringstream lines(buf.str());
+
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glPushAttrib(GL_ENABLE_BIT);
+   glDisable(GL_DEPTH_TEST);
+   glDisable(GL_CLIP_PLANE0);
+   MarkRenderState();
+   Set_Black_Material();
+
+   GLint viewport[4];
+   glGetIntegerv(GL_VIEWPORT, viewport);
+
+#ifndef GLVIS_USE_FREETYPE
+   glPushAttrib(GL_LIST_BIT);
+   glListBase(fontbase);
+   const int line_height = 14;
+#else
+   int width, line_height = 0;
+#endif
+
+   string line;
+   for (int i = 1; getline(lines, line); i++)
+   {
+#ifndef GLVIS_USE_FREETYPE
+      glRasterPos2d(-1.0 + 16.0/viewport[2],
+                    1.0 - 2.0*i*line_height/viewport[3]);
+      glCallLists(line.size(), GL_UNSIGNED_BYTE, line.c_str());
+#else
+      int height;
+      if (!RenderBitmapText(line.c_str(), width, height)) { continue; }
+      if (line_height == 0) { line_height = height; }
+      glRasterPos2d(-1.0 + 16.0/viewport[2],
+                    1.0 - 2.0*i*line_height/viewport[3]);
+      DrawBitmapText();
+#endif
+   }
+
+#ifndef GLVIS_USE_FREETYPE
+   glPopAttrib();
+#endif
+   glPopAttrib();
+   MarkRenderState();
+
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+   glPopMatrix();
+}
+
 void VisualizationSceneScalarData::DrawCoordinateCross()
 {
    if (drawaxes == 3)
@@ -1065,6 +1224,28 @@ void KeyToggleTexture()
    SendExposeEvent();
 }
 
+void KeyPercentPressed()
+{
+   vsdata->ToggleDrawStats();
+   SendExposeEvent();
+}
+
+void KeyDollarPressed()
+{
+   cout << "Streamline seeds:\n"
+        "   line x0 y0 [z0] x1 y1 [z1] n - n seeds on a segment\n"
+        "   plane px py pz nx ny nz n    - n x n seeds in a plane (3D)\n"
+        "   bdr attr n                   - n seeds on a boundary attribute\n"
+        "   clear                        - remove the streamlines\n"
+        "> " << flush;
+   string line;
+   cin >> ws;
+   getline(cin, line);
+   istringstream in(line);
+   vsdata->StreamlineCommand(in);
+   SendExposeEvent();
+}
+
 void VisualizationSceneScalarData::PrintLogscale(bool warn)
 {
    if (warn)
@@ -1133,6 +1314,173 @@ void VisualizationSceneScalarData::RulerPosition()
    }
    cout << "New ruler position: (" << ruler_x << ','
         << ruler_y << ',' << ruler_z << ")" << endl;
+   double pos[3] = { ruler_x, ruler_y, ruler_z };
+   PrintProbe(pos);
+}
+
+void VisualizationSceneScalarData::UpdateLayers()
+{
+   if (dirty_layers)
+   {
+      updating_layers = true;
+      RebuildLayers();
+      updating_layers = false;
+   }
+}
+
+void VisualizationSceneScalarData::RebuildLayers()
+{
+   if (dirty_layers & LAYER_SURFACE) { Prepare(); }
+   if ((dirty_layers & LAYER_AXES) && drawaxes) { PrepareAxes(); }
+   if ((dirty_layers & LAYER_PROXY) && ProxyActive()) { PrepareProxy(); }
+}
+
+PointLocator *VisualizationSceneScalarData::GetPointLocator()
+{
+   if (locator == NULL)
+   {
+      locator = new PointLocator(mesh);
+   }
+   return locator;
+}
+
+void VisualizationSceneScalarData::PrintProbe(const double *x)
+{
+   Vector vals;
+   int e = Probe(x, vals);
+
+   cout << "Value at (" << x[0] << ',' << x[1];
+   if (mesh->SpaceDimension() == 3)
+   {
+      cout << ',' << x[2];
+   }
+   cout << "): ";
+   if (e < 0)
+   {
+      cout << "not available" << endl;
+      return;
+   }
+   if (vals.Size() == 1)
+   {
+      cout << vals(0);
+   }
+   else
+   {
+      cout << '(';
+      for (int i = 0; i < vals.Size(); i++)
+      {
+         cout << (i ? "," : "") << vals(i);
+      }
+      cout << ')';
+   }
+   cout << " in element " << e << endl;
+}
+
+void VisualizationSceneScalarData::AddStreamlineSeeds(const Array<double> &s)
+{
+   cout << "Streamlines are only available for vector fields" << endl;
+}
+
+bool VisualizationSceneScalarData::StreamlineCommand(istream &in)
+{
+   const int sdim = mesh->SpaceDimension();
+   string kind;
+   int n = 0;
+   Array<double> s;
+
+   in >> kind;
+   if (kind == "clear")
+   {
+      ClearStreamlines();
+      return true;
+   }
+   else if (kind == "line")
+   {
+      double p[2][3] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+      for (int i = 0; i < 2; i++)
+      {
+         for (int d = 0; d < sdim; d++) { in >> p[i][d]; }
+      }
+      in >> n;
+      if (in) { Streamlines::SeedsOnLine(p[0], p[1], n, s); }
+   }
+   else if (kind == "plane" && sdim == 3)
+   {
+      double p[3], nor[3];
+      in >> p[0] >> p[1] >> p[2] >> nor[0] >> nor[1] >> nor[2] >> n;
+      // the square covers the bounding box
+      double size = sqrt((x[1]-x[0])*(x[1]-x[0]) + (y[1]-y[0])*(y[1]-y[0]) +
+                         (z[1]-z[0])*(z[1]-z[0]));
+      if (in) { Streamlines::SeedsOnPlane(p, nor, size, n, s); }
+   }
+   else if (kind == "bdr")
+   {
+      int attr;
+      in >> attr >> n;
+      if (in) { Streamlines::SeedsOnBoundary(mesh, attr, n, s); }
+   }
+   else
+   {
+      cout << "Unknown streamline seeds: '" << kind << "'" << endl;
+      return false;
+   }
+
+   if (!in || n < 1)
+   {
+      cout << "Invalid streamline seeds" << endl;
+      return false;
+   }
+   if (s.Size() == 0)
+   {
+      cout << "No streamline seeds" << endl;
+      return true;
+   }
+   AddStreamlineSeeds(s);
+   return true;
+}
+
+void VisualizationSceneScalarData::ProbeWindowPoint(int wx, int wy)
+{
+   GLint vp[4];
+   GLdouble mv[16], pr[16];
+   GLfloat depth;
+
+   glGetIntegerv(GL_VIEWPORT, vp);
+   wy = vp[1] + vp[3] - 1 - wy;
+   glReadPixels(wx, wy, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+   if (depth >= 1.0f)
+   {
+      cout << "Probe: nothing is drawn at the mouse position" << endl;
+      return;
+   }
+
+   ModelView();
+   glGetDoublev(GL_MODELVIEW_MATRIX, mv);
+   glGetDoublev(GL_PROJECTION_MATRIX, pr);
+
+   double p[3], p0[3], p1[3];
+   gluUnProject(wx, wy, depth, mv, pr, vp, &p[0], &p[1], &p[2]);
+   if (mesh->Dimension() == 3)
+   {
+      // the drawn surfaces are on the boundary of the elements, so move the
+      // point slightly inside along the view direction
+      gluUnProject(wx, wy, 0.0, mv, pr, vp, &p0[0], &p0[1], &p0[2]);
+      gluUnProject(wx, wy, 1.0, mv, pr, vp, &p1[0], &p1[1], &p1[2]);
+      double len = sqrt((p1[0]-p0[0])*(p1[0]-p0[0]) +
+                        (p1[1]-p0[1])*(p1[1]-p0[1]) +
+                        (p1[2]-p0[2])*(p1[2]-p0[2]));
+      double eps = 1e-4*sqrt((x[1]-x[0])*(x[1]-x[0]) +
+                             (y[1]-y[0])*(y[1]-y[0]) +
+                             (z[1]-z[0])*(z[1]-z[0]));
+      if (len > 0.0)
+      {
+         for (int d = 0; d < 3; d++)
+         {
+            p[d] += eps*(p1[d]-p0[d])/len;
+         }
+      }
+   }
+   PrintProbe(p);
 }
 
 void VisualizationSceneScalarData::DrawRuler(bool log_z)
@@ -1146,6 +1494,7 @@ void VisualizationSceneScalarData::DrawRuler(bool log_z)
          if (light)
          {
             glEnable(GL_LIGHTING);
+            MarkRenderState();
          }
          glBegin(GL_QUADS);
          glColor4d(0.8, 0.8, 0.8, 1.0);
@@ -1179,6 +1528,7 @@ void VisualizationSceneScalarData::DrawRuler(bool log_z)
          if (light)
          {
             glDisable(GL_LIGHTING);
+            MarkRenderState();
          }
          Set_Black_Material();
 
@@ -1251,10 +1601,14 @@ void VisualizationSceneScalarData::Init()
 {
    vsdata = this;
 
+   updating_layers = false;
+   dirty_layers = 0;
+
    arrow_type = arrow_scaling_type = 0;
    scaling = 0;
    light   = 1;
    drawaxes = colorbar = 0;
+   drawstats = 0;
    auto_ref_max = 16;
    auto_ref_max_surf_elem = 20000;
    minv = 0.0;
@@ -1314,6 +1668,8 @@ void VisualizationSceneScalarData::Init()
       auxKeyFunc (XK_asciitilde, KeyTildePressed);
 
       auxKeyFunc (XK_exclam, KeyToggleTexture);
+      auxKeyFunc (XK_dollar, KeyDollarPressed);
+      auxKeyFunc (XK_percent, KeyPercentPressed);
    }
 
    Set_Light();
@@ -1349,6 +1705,7 @@ void VisualizationSceneScalarData::Init()
    ruler_x = 0.5 * (x[0] + x[1]);
    ruler_y = 0.5 * (y[0] + y[1]);
    ruler_z = 0.5 * (z[0] + z[1]);
+   locator = NULL;
 
    autoscale = 1;
 }
@@ -1356,6 +1713,11 @@ void VisualizationSceneScalarData::Init()
 VisualizationSceneScalarData::~VisualizationSceneScalarData()
 {
    glDeleteLists (axeslist, 1);
+   for (int i = 0; i < arrow_lists.Size(); i++)
+   {
+      glDeleteLists (arrow_lists[i], 1);
+   }
+   delete locator;
    delete CuttingPlane;
 }
 
@@ -1414,6 +1776,9 @@ void VisualizationSceneScalarData::SetAxisLabels(const char * a_x,
 
 void VisualizationSceneScalarData::PrepareAxes()
 {
+   if (Deferred(LAYER_AXES)) { return; }
+   ProfileTimer timer("ScalarData::PrepareAxes");
+
    Set_Black_Material();
    GLfloat blk[4];
    glGetFloatv(GL_CURRENT_COLOR, blk);
@@ -1840,3 +2205,82 @@ void Plane::DecreaseDistance()
    eqn[3] -= rho_step;
    CartesianToSpherical();
 }
+
+bool ScreenSeeds::Update()
+{
+   GLdouble new_mv[16], new_pr[16];
+   GLint new_vp[4];
+   glGetDoublev(GL_MODELVIEW_MATRIX, new_mv);
+   glGetDoublev(GL_PROJECTION_MATRIX, new_pr);
+   glGetIntegerv(GL_VIEWPORT, new_vp);
+
+   if (valid)
+   {
+      bool same = true;
+      for (int i = 0; i < 16 && same; i++)
+      {
+         same = (new_mv[i] == mv[i] && new_pr[i] == pr[i]);
+      }
+      for (int i = 0; i < 4 && same; i++)
+      {
+         same = (new_vp[i] == vp[i]);
+      }
+      if (same)
+      {
+         return false;
+      }
+   }
+
+   for (int i = 0; i < 16; i++)
+   {
+      mv[i] = new_mv[i];
+      pr[i] = new_pr[i];
+   }
+   for (int i = 0; i < 4; i++)
+   {
+      vp[i] = new_vp[i];
+   }
+   valid = true;
+
+   // one seed per cell of the grid, moved randomly inside the middle 80% of
+   // the cell; the offsets depend only on the cell, not on the frame
+   const int nx = vp[2]/spacing, ny = vp[3]/spacing;
+   win.SetSize(0);
+   win.Reserve(2*nx*ny);
+   for (int j = 0; j < ny; j++)
+   {
+      for (int i = 0; i < nx; i++)
+      {
+         unsigned hash = (unsigned) i*73856093u ^ (unsigned) j*19349663u;
+         hash = (hash ^ (hash >> 13))*1274126177u;
+         const double rx = (hash & 0xffff)/65535.0;
+         const double ry = ((hash >> 16) & 0xffff)/65535.0;
+         win.Append(vp[0] + (i + 0.1 + 0.8*rx)*spacing);
+         win.Append(vp[1] + (j + 0.1 + 0.8*ry)*spacing);
+      }
+   }
+   return true;
+}
+
+void ScreenSeeds::UnProject(double wx, double wy, double wz, double *x) const
+{
+   gluUnProject(wx, wy, wz, mv, pr, vp, &x[0], &x[1], &x[2]);
+}
+
+bool ScreenSeeds::UnProjectToPlane(double wx, double wy, double zc,
+                                   double *x) const
+{
+   double p0[3], p1[3];
+   UnProject(wx, wy, 0.0, p0);
+   UnProject(wx, wy, 1.0, p1);
+   if (p1[2] == p0[2])
+   {
+      return false;
+   }
+   const double t = (zc - p0[2])/(p1[2] - p0[2]);
+   for (int d = 0; d < 3; d++)
+   {
+      x[d] = p0[d] + t*(p1[d] - p0[d]);
+   }
+   return true;
+}
@@ -13,6 +13,7 @@
 #define GLVIS_VSDATA
 
 #include "openglvis.hpp"
+#include "pointlocator.hpp"
 #include "mfem.hpp"
 using namespace mfem;
 
@@ -48,6 +49,38 @@ public:
    void DecreaseDistance();
 };
 
+// Window positions for glyphs on a jittered grid covering the viewport. The
+// positions are regenerated only when the view changes, so the glyphs stay in
+// place between frames and are reseeded when zooming or rotating.
+class ScreenSeeds
+{
+private:
+   GLdouble mv[16], pr[16];
+   GLint vp[4];
+   bool valid;
+
+public:
+   // spacing of the grid in pixels
+   int spacing;
+   // (x,y) window coordinates of the seeds
+   Array<double> win;
+
+   ScreenSeeds(int spacing_ = 32) : valid(false), spacing(spacing_) { }
+
+   // Read the current matrices and viewport. If they changed since the last
+   // call, or after Invalidate(), regenerate 'win' and return true.
+   bool Update();
+   void Invalidate() { valid = false; }
+
+   // Find the point with window coordinates (wx,wy) in the plane of constant
+   // z-coordinate 'zc' in object coordinates. Returns false if the view
+   // direction is parallel to the plane.
+   bool UnProjectToPlane(double wx, double wy, double zc, double *x) const;
+   // Object coordinates of the point with window coordinates (wx,wy,wz).
+   void UnProject(double wx, double wy, double wz, double *x) const;
+   const GLint *Viewport() const { return vp; }
+};
+
 
 class VisualizationSceneScalarData : public VisualizationScene
 {
@@ -60,18 +93,85 @@ protected:
    std::string a_label_x, a_label_y, a_label_z;
 
    int scaling, colorbar, drawaxes, axeslist;
+   // show the timing statistics, see DrawStats()
+   int drawstats;
    int auto_ref_max, auto_ref_max_surf_elem;
 
    void Init();
 
    int arrow_type, arrow_scaling_type;
 
+   // Display lists with the unit arrow drawn by Arrow() for each pair of
+   // (arrow_type, cone_scale) in arrow_list_keys, see ArrowInstance().
+   Array<int> arrow_lists;
+   Array<double> arrow_list_keys;
+   // Returns 0 if the list does not exist and another list is being compiled.
+   int GetArrowList(int type, double cone_scale);
+
    int nl;
    Array<double> level;
 
    int ruler_on;
    double ruler_x, ruler_y, ruler_z;
 
+   // Index for finding the elements containing given points, built on demand
+   // by GetPointLocator(). Call FreePointLocator() when the mesh changes.
+   PointLocator *locator;
+   PointLocator *GetPointLocator();
+   void FreePointLocator() { delete locator; locator = NULL; }
+
+   // The render layers, each built into its own display list by one of the
+   // Prepare*() methods. Calling that method only marks the layer as dirty;
+   // the dirty layers are rebuilt once, at the start of the next Draw().
+   enum
+   {
+      LAYER_SURFACE             = 1 << 0,  // Prepare()
+      LAYER_MESH                = 1 << 1,  // PrepareLines()
+      LAYER_BOUNDARY            = 1 << 2,
+      LAYER_LEVEL_LINES         = 1 << 3,
+      LAYER_NUMBERING           = 1 << 4,
+      LAYER_CUTTING_PLANE       = 1 << 5,
+      LAYER_CUTTING_PLANE_LINES = 1 << 6,
+      LAYER_LEVEL_SURF          = 1 << 7,
+      LAYER_ORDERING            = 1 << 8,
+      LAYER_VECTORS             = 1 << 9,
+      LAYER_DISPLACED_MESH      = 1 << 10,
+      LAYER_AXES                = 1 << 11,
+      LAYER_PROXY               = 1 << 12  // PrepareProxy()
+   };
+   bool updating_layers;
+   int dirty_layers;
+   // Called first in the Prepare*() methods: returns true if the layer was
+   // only marked as dirty, otherwise clears its dirty bit.
+   bool Deferred(int layer)
+   {
+      if (!updating_layers)
+      {
+         dirty_layers |= layer;
+         if (layer & (LAYER_SURFACE | LAYER_MESH))
+         {
+            dirty_layers |= LAYER_PROXY;
+         }
+         return true;
+      }
+      dirty_layers &= ~layer;
+      return false;
+   }
+   // Rebuild the dirty layers in the order of their dependencies. Hidden
+   // layers stay dirty until they are shown.
+   virtual void RebuildLayers();
+   // Called first in Draw().
+   void UpdateLayers();
+
+   // While the view is moving, i.e. while spinning or dragging with the mouse,
+   // a coarse proxy of the surface and the mesh lines is drawn instead of the
+   // full lists, if HasProxy(). The proxy lists are compiled by PrepareProxy()
+   // on the first frame that needs them.
+   virtual bool HasProxy() { return false; }
+   virtual void PrepareProxy() { }
+   bool ProxyActive()
+   { return ((spinning || moving) && !movie && !print && HasProxy()); }
+
    // autoscale controls the behavior when the mesh/solution are updated:
    // 0 - do not change the bounding box and the value range
    // 1 - recompute both the bounding box and the value range (default)
@@ -185,6 +285,7 @@ public:
                      Array<double> * level = NULL,
                      Array<double> * levels = NULL);
    void DrawCaption();
+   void DrawStats();
    void DrawCoordinateCross();
 
    double &GetMinV() { return minv; }
@@ -203,6 +304,14 @@ public:
                double vx, double vy, double vz,
                double length,
                double cone_scale = 0.075);
+   /// Same as Arrow(), but calls a shared display list of the unit arrow with
+   /// the transformation of this arrow. The arrows compiled into a display
+   /// list take a fraction of the memory of Arrow(). Call GetArrowList()
+   /// before compiling such a list, otherwise Arrow() is used.
+   void ArrowInstance(double px, double py, double pz,
+                      double vx, double vy, double vz,
+                      double length,
+                      double cone_scale = 0.075);
 
    void DrawPolygonLevelLines(double *point, int n, Array<double> &level,
                               bool log_vals);
@@ -239,12 +348,35 @@ public:
    void ToggleScaling()
    { scaling = !scaling; SetNewScalingFromBox(); }
 
+   void ToggleDrawStats() { drawstats = !drawstats; }
+
    virtual void ToggleLogscale(bool print);
 
    void ToggleRuler();
    void RulerPosition();
    void DrawRuler(bool log_z = false);
 
+   /// Evaluate the solution at the point 'x' with SpaceDimension() coordinates.
+   /// Returns the element containing the point and sets 'vals' to the value
+   /// (or the vector) there, or returns -1 if the point is outside the mesh or
+   /// the solution can not be evaluated at arbitrary points.
+   virtual int Probe(const double *x, Vector &vals) { return -1; }
+   /// Print the result of Probe() at the point 'x'.
+   void PrintProbe(const double *x);
+   virtual void ProbeWindowPoint(int wx, int wy);
+
+   /// Trace streamlines through the seeds 's' (3 coordinates per seed). Only
+   /// the vector field scenes support streamlines.
+   virtual void AddStreamlineSeeds(const Array<double> &s);
+   virtual void ClearStreamlines() { }
+   /// Read the seeds for AddStreamlineSeeds() from 'in', one of
+   ///    line x0 y0 [z0] x1 y1 [z1] n - n seeds on a segment
+   ///    plane px py pz nx ny nz n    - n x n seeds in a plane (3D only)
+   ///    bdr attr n                   - up to n seeds on a boundary attribute
+   ///    clear                        - remove all streamlines
+   /// Returns false if the command can not be parsed.
+   bool StreamlineCommand(std::istream &in);
+
    void ToggleTexture();
 
    void SetAutoscale(int _autoscale);
@@ -81,6 +81,7 @@ static void SolutionKeyHPressed()
         << "| y/Y  Rotate the clipping plane     |" << endl
         << "| z/Z  Move the clipping plane       |" << endl
         << "| \\ -  Set light source position     |" << endl
+        << "| % -  Show/hide timing statistics   |" << endl
         << "| Ctrl+p - Print to a PDF file       |" << endl
         << "| Ctrl+o - Element ordering curve    |" << endl
         << "+------------------------------------+" << endl
@@ -114,6 +115,7 @@ static void SolutionKeyHPressed()
         << "| right + Shift - Change light pos.  |" << endl
         << "| left  + Ctrl  - Spherical rotation |" << endl
         << "| middle+ Ctrl  - Object translation |" << endl
+        << "| middle+ Shift - Value at the point |" << endl
         << "| right + Ctrl  - Object scaling     |" << endl
         << "| left  + Ctrl + Shift - z-Spinning  |" << endl
         << "+------------------------------------+" << endl;
@@ -448,11 +450,13 @@ void VisualizationSceneSolution::Init()
 {
    rsol  = NULL;
    vssol = this;
+   surface_built = autoscale_pending = false;
 
    drawelems = shading = 1;
    drawmesh  = 0;
    draworder = 0;
    drawnums  = 0;
+   e_nums_markers = v_nums_markers = true;
 
    shrink = 1.0;
    shrinkmat = 1.0;
@@ -521,6 +525,8 @@ void VisualizationSceneSolution::Init()
 
    displlist  = glGenLists (1);
    linelist   = glGenLists (1);
+   proxylist  = glGenLists (1);
+   proxylinelist = glGenLists (1);
    lcurvelist = glGenLists (1);
    bdrlist    = glGenLists (1);
    cp_list    = glGenLists (1);
@@ -541,6 +547,8 @@ VisualizationSceneSolution::~VisualizationSceneSolution()
 {
    glDeleteLists (displlist, 1);
    glDeleteLists (linelist, 1);
+   glDeleteLists (proxylist, 1);
+   glDeleteLists (proxylinelist, 1);
    glDeleteLists (lcurvelist, 1);
    glDeleteLists (bdrlist, 1);
    glDeleteLists (cp_list, 1);
@@ -597,9 +605,11 @@ void VisualizationSceneSolution::NewMeshAndSolution(
          cout << "Subdivision factors = " << TimesToRefine << ", 1" << endl;
       }
    }
+   refined.Clear();
    mesh = new_m;
    sol = new_sol;
    rsol = new_u;
+   FreePointLocator();
 
    DoAutoscale(false);
 
@@ -670,7 +680,10 @@ void VisualizationSceneSolution::GetRefinedValues(
 {
    if (drawelems < 2)
    {
-      rsol->GetValues(i, ir, vals, tr);
+      if (!refined.Lookup(i, ir, vals, tr, NULL))
+      {
+         rsol->GetValues(i, ir, vals, tr);
+      }
    }
    else
    {
@@ -697,16 +710,19 @@ int VisualizationSceneSolution::GetRefinedValuesAndNormals(
 
    if (drawelems < 2)
    {
-      rsol->GetGradients(i, ir, tr);
-      normals.SetSize(3, tr.Width());
-      for (int j = 0; j < tr.Width(); j++)
+      if (!refined.Lookup(i, ir, vals, tr, &normals))
       {
-         normals(0, j) = -tr(0, j);
-         normals(1, j) = -tr(1, j);
-         normals(2, j) = 1.;
+         rsol->GetGradients(i, ir, tr);
+         normals.SetSize(3, tr.Width());
+         for (int j = 0; j < tr.Width(); j++)
+         {
+            normals(0, j) = -tr(0, j);
+            normals(1, j) = -tr(1, j);
+            normals(2, j) = 1.;
+         }
+         rsol->GetValues(i, ir, vals, tr);
       }
       have_normals = 1;
-      rsol->GetValues(i, ir, vals, tr);
    }
    else
    {
@@ -760,6 +776,10 @@ void VisualizationSceneSolution::SetShading(int s, bool print)
 
       if (s == 2 || shading == 2)
       {
+         if (s != 2)
+         {
+            refined.Cancel();
+         }
          shading = s;
          DoAutoscale(false);
          PrepareLines();
@@ -901,8 +921,11 @@ void VisualizationSceneSolution::FindNewBox(double rx[], double ry[],
 {
    int i, j;
 
-   if (shading != 2)
+   if (shading != 2 || WaitingForValues())
    {
+      // with background values, estimate the box until they are ready
+      autoscale_pending = (shading == 2);
+
       int nv = mesh -> GetNV();
 
       double *coord = mesh->GetVertex(0);
@@ -1039,34 +1062,24 @@ void VisualizationSceneSolution::EventUpdateBackground()
    PrepareNumbering();
 }
 
-void DrawNumberedMarker(const double x[3], double dx, int n)
+void DrawNumberedMarker(const double x[3], double dx, int n,
+                        BitmapTextBatch &labels)
 {
-   glBegin(GL_LINES);
-   // glColor4d(0, 0, 0, 0);
-   glVertex3d(x[0]-dx, x[1]-dx, x[2]);
-   glVertex3d(x[0]+dx, x[1]+dx, x[2]);
-   glVertex3d(x[0]+dx, x[1]-dx, x[2]);
-   glVertex3d(x[0]-dx, x[1]+dx, x[2]);
-   glEnd();
-
-#ifndef GLVIS_USE_FREETYPE
-   glPushAttrib (GL_LIST_BIT);
-   glListBase (fontbase);
-#endif
+   if (dx > 0.0)
+   {
+      glBegin(GL_LINES);
+      // glColor4d(0, 0, 0, 0);
+      glVertex3d(x[0]-dx, x[1]-dx, x[2]);
+      glVertex3d(x[0]+dx, x[1]+dx, x[2]);
+      glVertex3d(x[0]+dx, x[1]-dx, x[2]);
+      glVertex3d(x[0]-dx, x[1]+dx, x[2]);
+      glEnd();
+   }
 
    ostringstream buf;
    buf << n;
 
-   glRasterPos3d (x[0], x[1], x[2]);
-#ifndef GLVIS_USE_FREETYPE
-   glCallLists(buf.str().size(), GL_UNSIGNED_BYTE, buf.str().c_str());
-#else
-   DrawBitmapText(buf.str().c_str());
-#endif
-
-#ifndef GLVIS_USE_FREETYPE
-   glPopAttrib();
-#endif
+   labels.Add(x, buf.str().c_str());
 }
 
 void DrawTriangle(const double pts[][3], const double cv[],
@@ -1230,6 +1243,8 @@ void DrawPatch(const DenseMatrix &pts, Vector &vals, DenseMatrix &normals,
 
 void VisualizationSceneSolution::PrepareWithNormals()
 {
+   ProfileTimer timer("Solution::PrepareWithNormals");
+
    glNewList(displlist, GL_COMPILE);
 
    Array<int> vertices;
@@ -1275,6 +1290,8 @@ void VisualizationSceneSolution::PrepareWithNormals()
 
 void VisualizationSceneSolution::PrepareFlat()
 {
+   ProfileTimer timer("Solution::PrepareFlat");
+
    int i, j;
 
    glNewList (displlist, GL_COMPILE);
@@ -1319,6 +1336,8 @@ const int split_quads = 1;
 
 void VisualizationSceneSolution::PrepareFlat2()
 {
+   ProfileTimer timer("Solution::PrepareFlat2");
+
    int i, j, k;
 
    glNewList (displlist, GL_COMPILE);
@@ -1422,8 +1441,132 @@ void VisualizationSceneSolution::PrepareFlat2()
    glEndList();
 }
 
+static void RefinedValuesIdleFunc()
+{
+   vssol->PollRefinedValues();
+}
+
+bool VisualizationSceneSolution::WaitingForValues()
+{
+   if (!rsol || shading != 2 || drawelems >= 2 ||
+       !RefinedValues::Supported(rsol))
+   {
+      return false;
+   }
+   if (!refined.Matches(TimesToRefine, EdgeRefineFactor))
+   {
+      RefinedGeometry *RefG =
+         GLVisGeometryRefiner.Refine(mesh->GetElementBaseGeometry(0),
+                                     TimesToRefine, EdgeRefineFactor);
+      if (mesh->GetNE()*RefG->RefPts.GetNPoints() < MIN_BACKGROUND_POINTS)
+      {
+         refined.Clear();
+         return false;
+      }
+      // supersedes the computation for the previous refinement factors
+      refined.Start(rsol, GLVisGeometryRefiner, TimesToRefine,
+                    EdgeRefineFactor);
+   }
+   if (refined.Wait(0.0))
+   {
+      return false;
+   }
+   AddIdleFunc(RefinedValuesIdleFunc);
+   return true;
+}
+
+void VisualizationSceneSolution::PollRefinedValues()
+{
+   if (refined.Running() && !refined.Wait(0.005))
+   {
+      return;
+   }
+   RemoveIdleFunc(RefinedValuesIdleFunc);
+   if (autoscale_pending)
+   {
+      autoscale_pending = false;
+      DoAutoscale(true);
+   }
+   SendExposeEvent();
+}
+
+bool VisualizationSceneSolution::FinishPrepare()
+{
+   if (!refined.Running())
+   {
+      return false;
+   }
+   refined.Wait(-1.0);
+   PollRefinedValues();
+   return true;
+}
+
+void VisualizationSceneSolution::RebuildLayers()
+{
+   // the layers which need the refined values keep their old lists until the
+   // values are ready
+   int postponed = 0;
+   if (WaitingForValues())
+   {
+      postponed = dirty_layers & (LAYER_SURFACE | LAYER_MESH |
+                                  LAYER_LEVEL_LINES | LAYER_CUTTING_PLANE);
+      dirty_layers &= ~postponed;
+      if ((postponed & LAYER_SURFACE) && !surface_built)
+      {
+         // nothing to keep: show a flat preview from the vertex values
+         shading = 0;
+         Prepare();
+         shading = 2;
+      }
+   }
+
+   VisualizationSceneScalarData::RebuildLayers();
+   if ((dirty_layers & LAYER_MESH) && drawmesh == 1) { PrepareLines(); }
+   if ((dirty_layers & LAYER_BOUNDARY) && drawbdr) { PrepareBoundary(); }
+   if ((dirty_layers & LAYER_LEVEL_LINES) && drawmesh == 2)
+   {
+      PrepareLevelCurves();
+   }
+   if ((dirty_layers & LAYER_NUMBERING) && drawnums) { PrepareNumbering(); }
+   if (dirty_layers & LAYER_CUTTING_PLANE) { PrepareCP(); }
+   if ((dirty_layers & LAYER_ORDERING) && draworder)
+   {
+      PrepareOrderingCurve();
+   }
+   dirty_layers |= postponed;
+}
+
+void VisualizationSceneSolution::PrepareProxy()
+{
+   if (Deferred(LAYER_PROXY)) { return; }
+   ProfileTimer timer("Solution::PrepareProxy");
+
+   // compile the unrefined surface and mesh lines into the proxy lists,
+   // keeping the full lists and their dirty flags
+   int dirty = dirty_layers;
+   bool built = surface_built;
+   int tot = TimesToRefine, bdr = EdgeRefineFactor;
+   int dl = displlist, ll = linelist;
+   TimesToRefine = EdgeRefineFactor = 1;
+   displlist = proxylist;
+   linelist = proxylinelist;
+   Prepare();
+   PrepareLines();
+   displlist = dl;
+   linelist = ll;
+   TimesToRefine = tot;
+   EdgeRefineFactor = bdr;
+   surface_built = built;
+   dirty_layers = dirty;
+}
+
 void VisualizationSceneSolution::Prepare()
 {
+   if (Deferred(LAYER_SURFACE)) { return; }
+   ProfileTimer timer("Solution::Prepare");
+
+   surface_built = true;
+
    MySetColorLogscale = 0;
 
    switch (shading)
@@ -1534,6 +1677,9 @@ void VisualizationSceneSolution::Prepare()
 
 void VisualizationSceneSolution::PrepareLevelCurves()
 {
+   if (Deferred(LAYER_LEVEL_LINES)) { return; }
+   ProfileTimer timer("Solution::PrepareLevelCurves");
+
    if (shading == 2)
    {
       PrepareLevelCurves2();
@@ -1645,6 +1791,8 @@ void VisualizationSceneSolution::DrawLevelCurves(
 
 void VisualizationSceneSolution::PrepareLevelCurves2()
 {
+   ProfileTimer timer("Solution::PrepareLevelCurves2");
+
    int i, ne = mesh -> GetNE();
    Vector values;
    DenseMatrix pointmat;
@@ -1668,6 +1816,9 @@ void VisualizationSceneSolution::PrepareLevelCurves2()
 
 void VisualizationSceneSolution::PrepareLines()
 {
+   if (Deferred(LAYER_MESH)) { return; }
+   ProfileTimer timer("Solution::PrepareLines");
+
    if (shading == 2)
    {
       // PrepareLines2();
@@ -1731,14 +1882,16 @@ double VisualizationSceneSolution::GetElementLengthScale(int k)
 
 void VisualizationSceneSolution::PrepareElementNumbering()
 {
+   ProfileTimer timer("Solution::PrepareElementNumbering");
+
    int ne = mesh -> GetNE();
 
-   if (ne > MAX_RENDER_NUMBERING)
+   e_nums_text.Clear();
+   e_nums_markers = (ne <= MAX_RENDER_NUMBERING);
+   if (!e_nums_markers)
    {
-      cout << "Element numbering disabled when #elements > "
+      cout << "Element numbering markers disabled when #elements > "
            << MAX_RENDER_NUMBERING << endl;
-      cout << "Rendering the text would be very slow." << endl;
-      return;
    }
 
    if (2 == shading)
@@ -1753,6 +1906,8 @@ void VisualizationSceneSolution::PrepareElementNumbering()
 
 void VisualizationSceneSolution::PrepareElementNumbering1()
 {
+   ProfileTimer timer("Solution::PrepareElementNumbering1");
+
    glNewList(e_nums_list, GL_COMPILE);
 
    DenseMatrix pointmat;
@@ -1780,11 +1935,10 @@ void VisualizationSceneSolution::PrepareElementNumbering1()
       ys /= nv;
       us /= nv;
 
-      double ds = GetElementLengthScale(k);
-      double dx = 0.05*ds;
+      double dx = e_nums_markers ? 0.05*GetElementLengthScale(k) : 0.0;
 
       double xx[3] = {xs,ys,us};
-      DrawNumberedMarker(xx,dx,k);
+      DrawNumberedMarker(xx,dx,k,e_nums_text);
    }
 
    glEndList();
@@ -1792,6 +1946,8 @@ void VisualizationSceneSolution::PrepareElementNumbering1()
 
 void VisualizationSceneSolution::PrepareElementNumbering2()
 {
+   ProfileTimer timer("Solution::PrepareElementNumbering2");
+
    IntegrationRule center_ir(1);
    DenseMatrix pointmat;
    Vector values;
@@ -1811,11 +1967,10 @@ void VisualizationSceneSolution::PrepareElementNumbering2()
       double yc = pointmat(1,0);
       double uc = values(0);
 
-      double ds = GetElementLengthScale(i);
-      double dx = 0.05*ds;
+      double dx = e_nums_markers ? 0.05*GetElementLengthScale(i) : 0.0;
 
       double xx[3] = {xc,yc,uc};
-      DrawNumberedMarker(xx,dx,i);
+      DrawNumberedMarker(xx,dx,i,e_nums_text);
    }
 
    glEndList();
@@ -1823,14 +1978,16 @@ void VisualizationSceneSolution::PrepareElementNumbering2()
 
 void VisualizationSceneSolution::PrepareVertexNumbering()
 {
+   ProfileTimer timer("Solution::PrepareVertexNumbering");
+
    int nv = mesh->GetNV();
 
-   if (nv > MAX_RENDER_NUMBERING)
+   v_nums_text.Clear();
+   v_nums_markers = (nv <= MAX_RENDER_NUMBERING);
+   if (!v_nums_markers)
    {
-      cout << "Vertex numbering disabled when #vertices > "
+      cout << "Vertex numbering markers disabled when #vertices > "
            << MAX_RENDER_NUMBERING << endl;
-      cout << "Rendering the text would be very slow." << endl;
-      return;
    }
 
    if (2 == shading)
@@ -1845,6 +2002,8 @@ void VisualizationSceneSolution::PrepareVertexNumbering()
 
 void VisualizationSceneSolution::PrepareVertexNumbering1()
 {
+   ProfileTimer timer("Solution::PrepareVertexNumbering1");
+
    glNewList(v_nums_list, GL_COMPILE);
 
    DenseMatrix pointmat;
@@ -1862,8 +2021,7 @@ void VisualizationSceneSolution::PrepareVertexNumbering1()
 
       ShrinkPoints(pointmat, k, 0, 0);
 
-      double ds = GetElementLengthScale(k);
-      double xs = 0.05*ds;
+      double xs = v_nums_markers ? 0.05*GetElementLengthScale(k) : 0.0;
 
       for (int j = 0; j < nv; j++)
       {
@@ -1872,7 +2030,7 @@ void VisualizationSceneSolution::PrepareVertexNumbering1()
          double u = LogVal((*sol)(vertices[j]));
 
          double xx[3] = {x,y,u};
-         DrawNumberedMarker(xx,xs,vertices[j]);
+         DrawNumberedMarker(xx,xs,vertices[j],v_nums_text);
       }
    }
 
@@ -1881,6 +2039,8 @@ void VisualizationSceneSolution::PrepareVertexNumbering1()
 
 void VisualizationSceneSolution::PrepareVertexNumbering2()
 {
+   ProfileTimer timer("Solution::PrepareVertexNumbering2");
+
    DenseMatrix pointmat;
    Vector values;
    Array<int> vertices;
@@ -1899,8 +2059,7 @@ void VisualizationSceneSolution::PrepareVertexNumbering2()
 
       GetRefinedValues (i, vert_ir, values, pointmat);
 
-      double ds = GetElementLengthScale(i);
-      double xs = 0.05*ds;
+      double xs = v_nums_markers ? 0.05*GetElementLengthScale(i) : 0.0;
 
       for (int j = 0; j < values.Size(); j++)
       {
@@ -1910,7 +2069,7 @@ void VisualizationSceneSolution::PrepareVertexNumbering2()
          double u = values[j];
 
          double xx[3] = {xv,yv,u};
-         DrawNumberedMarker(xx,xs,vertices[j]);
+         DrawNumberedMarker(xx,xs,vertices[j],v_nums_text);
       }
    }
 
@@ -1919,6 +2078,9 @@ void VisualizationSceneSolution::PrepareVertexNumbering2()
 
 void VisualizationSceneSolution::PrepareOrderingCurve()
 {
+   if (Deferred(LAYER_ORDERING)) { return; }
+   ProfileTimer timer("Solution::PrepareOrderingCurve");
+
    bool color = draworder < 3;
    PrepareOrderingCurve1(order_list, true, color);
    PrepareOrderingCurve1(order_list_noarrow, false, color);
@@ -2004,12 +2166,17 @@ void VisualizationSceneSolution::PrepareOrderingCurve1(int list, bool arrows,
 
 void VisualizationSceneSolution::PrepareNumbering()
 {
+   if (Deferred(LAYER_NUMBERING)) { return; }
+   ProfileTimer timer("Solution::PrepareNumbering");
+
    PrepareElementNumbering();
    PrepareVertexNumbering();
 }
 
 void VisualizationSceneSolution::PrepareLines2()
 {
+   ProfileTimer timer("Solution::PrepareLines2");
+
    int i, j, k, ne = mesh -> GetNE();
    Vector values;
    DenseMatrix pointmat;
@@ -2044,6 +2211,8 @@ void VisualizationSceneSolution::PrepareLines2()
 
 void VisualizationSceneSolution::PrepareLines3()
 {
+   ProfileTimer timer("Solution::PrepareLines3");
+
    int i, k, ne = mesh -> GetNE();
    Vector values;
    DenseMatrix pointmat;
@@ -2101,6 +2270,9 @@ void VisualizationSceneSolution::UpdateValueRange(bool prepare)
 
 void VisualizationSceneSolution::PrepareBoundary()
 {
+   if (Deferred(LAYER_BOUNDARY)) { return; }
+   ProfileTimer timer("Solution::PrepareBoundary");
+
    int i, j, ne = mesh->GetNBE();
    Array<int> vertices;
    DenseMatrix pointmat;
@@ -2169,6 +2341,9 @@ void VisualizationSceneSolution::PrepareBoundary()
 
 void VisualizationSceneSolution::PrepareCP()
 {
+   if (Deferred(LAYER_CUTTING_PLANE)) { return; }
+   ProfileTimer timer("Solution::PrepareCP");
+
    Vector values;
    DenseMatrix pointmat;
    Array<int> ind;
@@ -2298,8 +2473,29 @@ void VisualizationSceneSolution::DrawCPLine(
    }
 }
 
+int VisualizationSceneSolution::Probe(const double *x, Vector &vals)
+{
+   if (rsol == NULL)
+   {
+      return -1;
+   }
+   IntegrationPoint ip;
+   int e = GetPointLocator()->FindPoint(x, ip);
+   if (e >= 0)
+   {
+      vals.SetSize(1);
+      vals(0) = rsol->GetValue(e, ip);
+   }
+   return e;
+}
+
 void VisualizationSceneSolution::Draw()
 {
+   ProfileTimer timer("Solution::Draw");
+
+   UpdateLayers();
+   bool proxy = ProxyActive();
+
    glEnable(GL_DEPTH_TEST);
 
    Set_Background();
@@ -2314,6 +2510,7 @@ void VisualizationSceneSolution::Draw()
 
    glDisable(GL_CLIP_PLANE0);
    glDisable(GL_LIGHTING);
+   MarkRenderState();
 
 #if 0
    // Testing: moved the drawing of the colorbar at the end. If there are no
@@ -2343,6 +2540,7 @@ void VisualizationSceneSolution::Draw()
    if (light)
    {
       glEnable(GL_LIGHTING);
+      MarkRenderState();
    }
 
    if (MatAlpha < 1.0)
@@ -2353,13 +2551,14 @@ void VisualizationSceneSolution::Draw()
    if (GetUseTexture())
    {
       glEnable (GL_TEXTURE_1D);
+      MarkRenderState();
       glColor4d(1, 1, 1, 1); // default color
    }
 
    // draw elements
    if (drawelems)
    {
-      glCallList(displlist);
+      glCallList(proxy ? proxylist : displlist);
    }
 
    // draw ordering -- color modes
@@ -2375,6 +2574,7 @@ void VisualizationSceneSolution::Draw()
    if (GetUseTexture())
    {
       glDisable (GL_TEXTURE_1D);
+      MarkRenderState();
    }
 
    if (MatAlpha < 1.0)
@@ -2385,6 +2585,7 @@ void VisualizationSceneSolution::Draw()
    if (light)
    {
       glDisable(GL_LIGHTING);
+      MarkRenderState();
    }
    Set_Black_Material(); // everything below will be drawn in "black"
 
@@ -2409,7 +2610,7 @@ void VisualizationSceneSolution::Draw()
    // draw lines
    if (drawmesh == 1)
    {
-      glCallList(linelist);
+      glCallList(proxy ? proxylinelist : linelist);
    }
    else if (drawmesh == 2)
    {
@@ -2422,10 +2623,12 @@ void VisualizationSceneSolution::Draw()
       if (1 == drawnums)
       {
          glCallList(e_nums_list);
+         e_nums_text.Draw();
       }
       else if (2 == drawnums)
       {
          glCallList(v_nums_list);
+         v_nums_text.Draw();
       }
    }
 
@@ -2470,6 +2673,8 @@ void VisualizationSceneSolution::Draw()
    }
 #endif
 
+   DrawStats();
+
    glFlush();
    auxSwapBuffers();
 }
@@ -25,12 +25,20 @@ protected:
 
    int drawmesh, drawelems, drawnums, draworder;
    int displlist, linelist, lcurvelist;
+   // the surface and the mesh lines without subdivision, see PrepareProxy()
+   int proxylist, proxylinelist;
    int bdrlist, drawbdr, draw_cp, cp_list;
    int e_nums_list, v_nums_list;
+   BitmapTextBatch e_nums_text, v_nums_text;
+   bool e_nums_markers, v_nums_markers; // draw the numbering 'x' markers
    int order_list, order_list_noarrow;
 
    void Init();
 
+   virtual void RebuildLayers();
+   virtual bool HasProxy() { return (shading == 2 && TimesToRefine > 1); }
+   virtual void PrepareProxy();
+
    void FindNewBox(double rx[], double ry[], double rval[]);
 
    void DrawCPLine(DenseMatrix &pointmat, Vector &values, Array<int> &ind);
@@ -54,9 +62,23 @@ protected:
    // Used for drawing markers for element and vertex numbering
    double GetElementLengthScale(int k);
 
-   // Rendering large numbers of text objects for element or vertex numbering is
-   // slow.  Turn it off above some entity count.
-   static const int MAX_RENDER_NUMBERING = 1000;
+   // With shading 2, the refined values of large solutions on triangle meshes
+   // are computed in the background, see RefinedValues::Supported().
+   // Meanwhile, the layers which need them keep their old display lists and
+   // the bounding box is estimated from the vertex values.
+   RefinedValues refined;
+   bool surface_built, autoscale_pending;
+   // Above this number of refined points the values are computed in the
+   // background.
+   static const int MIN_BACKGROUND_POINTS = 100000;
+   // Returns true while the refined values for the current refinement factors
+   // are computed in the background, starting the computation if needed.
+   bool WaitingForValues();
+
+   // The numbering labels are decimated in screen space when drawn, see
+   // BitmapTextBatch, but the 'x' markers are compiled for every entity.  Above
+   // this entity count only the labels are shown.
+   static const int MAX_RENDER_NUMBERING = 200000;
 
 public:
    int shading, TimesToRefine, EdgeRefineFactor;
@@ -69,7 +91,12 @@ public:
 
    virtual ~VisualizationSceneSolution();
 
-   void SetGridFunction(GridFunction & u) { rsol = &u; }
+   void SetGridFunction(GridFunction & u) { refined.Clear(); rsol = &u; }
+
+   // Called by an idle function while the refined values are computed in the
+   // background; redraws the scene when they are ready.
+   void PollRefinedValues();
+   virtual bool FinishPrepare();
 
    void NewMeshAndSolution(Mesh *new_m, Vector *new_sol,
                            GridFunction *new_u = NULL);
@@ -116,6 +143,8 @@ public:
 
    virtual void Draw();
 
+   virtual int Probe(const double *x, Vector &vals);
+
    void ToggleDrawBdr()
    { drawbdr = !drawbdr; }
 
@@ -140,7 +169,9 @@ public:
    virtual void ToggleAttributes(Array<int> &attr_list);
 };
 
-void DrawNumberedMarker(const double x[3], double dx, int n);
+// Draw an 'x' marker of size dx at x (none if dx is zero) and add the label n
+void DrawNumberedMarker(const double x[3], double dx, int n,
+                        BitmapTextBatch &labels);
 
 void DrawTriangle(const double pts[][3], const double cv[],
                   const double minv, const double maxv);
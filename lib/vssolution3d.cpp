@@ -26,6 +26,9 @@ using namespace std;
 VisualizationSceneSolution3d *vssol3d;
 extern GeometryRefiner GLVisGeometryRefiner;
 
+double VisualizationSceneSolution3d::lsurf_simplify = 1.0;
+double VisualizationSceneSolution3d::lsurf_simplify_error = 0.0;
+
 // Definitions of some more keys
 
 static void Solution3dKeyHPressed()
@@ -61,6 +64,7 @@ static void Solution3dKeyHPressed()
         << "| S -  Take snapshot/Record a movie  |" << endl
         << "| t -  Cycle materials and lights    |" << endl
         << "| \\ -  Set light source position     |" << endl
+        << "| % -  Show/hide timing statistics   |" << endl
         << "| u/U  Move the level surface        |" << endl
         << "| v/V  Add/Delete a level surface    |" << endl
         << "| w/W  Move bdr elements up/down     |" << endl
@@ -100,6 +104,7 @@ static void Solution3dKeyHPressed()
         << "| right + Shift - Change light pos.  |" << endl
         << "| left  + Ctrl  - Spherical rotation |" << endl
         << "| middle+ Ctrl  - Object translation |" << endl
+        << "| middle+ Shift - Value at the point |" << endl
         << "| right + Ctrl  - Object scaling     |" << endl
         << "| left  + Ctrl + Shift - z-Spinning  |" << endl
         << "+------------------------------------+" << endl;
@@ -119,6 +124,9 @@ static void KeyIPressed()
 
 void VisualizationSceneSolution3d::PrepareOrderingCurve()
 {
+   if (Deferred(LAYER_ORDERING)) { return; }
+   ProfileTimer timer("Solution3d::PrepareOrderingCurve");
+
    bool color = draworder < 3;
    PrepareOrderingCurve1(order_list, true, color);
    PrepareOrderingCurve1(order_list_noarrow, false, color);
@@ -829,6 +837,8 @@ void VisualizationSceneSolution3d::Init()
    }
    displlist  = glGenLists (1);
    linelist   = glGenLists (1);
+   proxylist  = glGenLists (1);
+   proxylinelist = glGenLists (1);
    cplanelist = glGenLists (1);
    cplanelineslist = glGenLists (1);
    lsurflist = glGenLists (1);
@@ -846,6 +856,8 @@ VisualizationSceneSolution3d::~VisualizationSceneSolution3d()
 {
    glDeleteLists (displlist, 1);
    glDeleteLists (linelist, 1);
+   glDeleteLists (proxylist, 1);
+   glDeleteLists (proxylinelist, 1);
    glDeleteLists (cplanelist, 1);
    glDeleteLists (cplanelineslist, 1);
    glDeleteLists (lsurflist, 1);
@@ -879,6 +891,7 @@ void VisualizationSceneSolution3d::NewMeshAndSolution(
    sol = new_sol;
    GridF = new_u;
    FindNodePos();
+   FreePointLocator();
 
    DoAutoscale(false);
 
@@ -1086,6 +1099,42 @@ void VisualizationSceneSolution3d::FindNewValueRange(bool prepare)
    UpdateValueRange(prepare);
 }
 
+void VisualizationSceneSolution3d::RebuildLayers()
+{
+   VisualizationSceneScalarData::RebuildLayers();
+   if ((dirty_layers & LAYER_MESH) && drawmesh) { PrepareLines(); }
+   if (dirty_layers & LAYER_CUTTING_PLANE) { PrepareCuttingPlane(); }
+   if ((dirty_layers & LAYER_CUTTING_PLANE_LINES) && cplane && cp_drawmesh)
+   {
+      PrepareCuttingPlaneLines();
+   }
+   if ((dirty_layers & LAYER_LEVEL_SURF) && drawlsurf) { PrepareLevelSurf(); }
+   if ((dirty_layers & LAYER_ORDERING) && draworder)
+   {
+      PrepareOrderingCurve();
+   }
+}
+
+void VisualizationSceneSolution3d::PrepareProxy()
+{
+   if (Deferred(LAYER_PROXY)) { return; }
+   ProfileTimer timer("Solution3d::PrepareProxy");
+
+   // compile the unrefined surface and mesh lines into the proxy lists,
+   // keeping the full lists and their dirty flags
+   int dirty = dirty_layers;
+   int ref = TimesToRefine, dl = displlist, ll = linelist;
+   TimesToRefine = 1;
+   displlist = proxylist;
+   linelist = proxylinelist;
+   Prepare();
+   PrepareLines();
+   displlist = dl;
+   linelist = ll;
+   TimesToRefine = ref;
+   dirty_layers = dirty;
+}
+
 void VisualizationSceneSolution3d::EventUpdateColors()
 {
    Prepare();
@@ -1478,6 +1527,8 @@ void VisualizationSceneSolution3d::DrawRefinedSurfLevelLines(
 
 void VisualizationSceneSolution3d::PrepareFlat()
 {
+   ProfileTimer timer("Solution3d::PrepareFlat");
+
    int i, j;
 
    glNewList(displlist, GL_COMPILE);
@@ -1546,6 +1597,8 @@ void VisualizationSceneSolution3d::PrepareFlat()
 
 void VisualizationSceneSolution3d::PrepareFlat2()
 {
+   ProfileTimer timer("Solution3d::PrepareFlat2");
+
    int i, k, fn, fo, di, have_normals;
    double bbox_diam, vmin, vmax;
 
@@ -1693,6 +1746,9 @@ void VisualizationSceneSolution3d::PrepareFlat2()
 
 void VisualizationSceneSolution3d::Prepare()
 {
+   if (Deferred(LAYER_SURFACE)) { return; }
+   ProfileTimer timer("Solution3d::Prepare");
+
    int i,j;
 
    if (!drawelems)
@@ -1870,6 +1926,9 @@ void VisualizationSceneSolution3d::Prepare()
 
 void VisualizationSceneSolution3d::PrepareLines()
 {
+   if (Deferred(LAYER_MESH)) { return; }
+   ProfileTimer timer("Solution3d::PrepareLines");
+
    if (!drawmesh)
    {
       glNewList(linelist, GL_COMPILE);
@@ -1961,6 +2020,8 @@ void VisualizationSceneSolution3d::PrepareLines()
 
 void VisualizationSceneSolution3d::PrepareLines2()
 {
+   ProfileTimer timer("Solution3d::PrepareLines2");
+
    int i, j, k, fn, fo, di = 0;
    double bbox_diam;
 
@@ -2299,6 +2360,8 @@ static void CutElement(const Geometry::Type geom, const int *vert_flags,
 
 void VisualizationSceneSolution3d::CuttingPlaneFunc(int func)
 {
+   ProfileTimer timer("Solution3d::CuttingPlaneFunc");
+
    int i, j, k, m, n, n2;
    int flag[8], cut_edges[6];
    const int *ev;
@@ -2654,6 +2717,9 @@ void VisualizationSceneSolution3d::CutRefinedFace(
 
 void VisualizationSceneSolution3d::PrepareCuttingPlane()
 {
+   if (Deferred(LAYER_CUTTING_PLANE)) { return; }
+   ProfileTimer timer("Solution3d::PrepareCuttingPlane");
+
    glNewList(cplanelist, GL_COMPILE);
 
    if (cp_drawelems && cplane && mesh->Dimension() == 3)
@@ -2695,6 +2761,8 @@ void VisualizationSceneSolution3d::PrepareCuttingPlane()
 
 void VisualizationSceneSolution3d::PrepareCuttingPlane2()
 {
+   ProfileTimer timer("Solution3d::PrepareCuttingPlane2");
+
    int i, j, n = 0;
    double p[4][3], c[4], *coord;
    DenseMatrix pointmat, normals;
@@ -2768,6 +2836,9 @@ void VisualizationSceneSolution3d::PrepareCuttingPlane2()
 
 void VisualizationSceneSolution3d::PrepareCuttingPlaneLines()
 {
+   if (Deferred(LAYER_CUTTING_PLANE_LINES)) { return; }
+   ProfileTimer timer("Solution3d::PrepareCuttingPlaneLines");
+
    glNewList(cplanelineslist, GL_COMPILE);
 
    if (cp_drawmesh && cplane && mesh->Dimension() == 3)
@@ -2857,6 +2928,8 @@ void VisualizationSceneSolution3d::PrepareCuttingPlaneLines()
 
 void VisualizationSceneSolution3d::PrepareCuttingPlaneLines2()
 {
+   ProfileTimer timer("Solution3d::PrepareCuttingPlaneLines2");
+
    int i, j, n = 0;
    double point[4][4], *coord;
    DenseMatrix pointmat;
@@ -2942,6 +3015,8 @@ void VisualizationSceneSolution3d::PrepareCuttingPlaneLines2()
 
 int triangle_counter;
 int quad_counter;
+// when set, DrawTetLevelSurf() collects the level surface for simplification
+static SurfaceSimplifier *lsurf_simplifier = NULL;
 
 void VisualizationSceneSolution3d::DrawTetLevelSurf(
    const DenseMatrix &verts, const Vector &vals, const int *ind,
@@ -3029,17 +3104,33 @@ void VisualizationSceneSolution3d::DrawTetLevelSurf(
          {
             if (!Compute3DUnitNormal(vert[0], vert[1], vert[2], normal))
             {
-               MySetColor(lvl, minv, maxv);
-               glNormal3dv(normal);
-               glBegin(GL_TRIANGLES);
-               for (int k = 0; k < 3; k++)
+               if (lsurf_simplifier)
+               {
+                  for (int k = 0; k < 3; k++)
+                  {
+                     for (int d = 0; d < 3; d++) { norm[k][d] = normal[d]; }
+                  }
+                  lsurf_simplifier->AddTriangle(vert, norm, lvl);
+               }
+               else
                {
-                  glVertex3dv(vert[k]);
+                  MySetColor(lvl, minv, maxv);
+                  glNormal3dv(normal);
+                  glBegin(GL_TRIANGLES);
+                  for (int k = 0; k < 3; k++)
+                  {
+                     glVertex3dv(vert[k]);
+                  }
+                  glEnd();
                }
-               glEnd();
                triangle_counter++;
             }
          }
+         else if (lsurf_simplifier)
+         {
+            lsurf_simplifier->AddTriangle(vert, norm, lvl);
+            triangle_counter++;
+         }
          else
          {
             MySetColor(lvl, minv, maxv);
@@ -3078,17 +3169,33 @@ void VisualizationSceneSolution3d::DrawTetLevelSurf(
             if (!Compute3DUnitNormal(vert[0], vert[1], vert[2], vert[3],
                                      normal))
             {
-               MySetColor(lvl, minv, maxv);
-               glNormal3dv(normal);
-               glBegin(GL_QUADS);
-               for (int k = 0; k < 4; k++)
+               if (lsurf_simplifier)
                {
-                  glVertex3dv(vert[k]);
+                  for (int k = 0; k < 4; k++)
+                  {
+                     for (int d = 0; d < 3; d++) { norm[k][d] = normal[d]; }
+                  }
+                  lsurf_simplifier->AddQuad(vert, norm, lvl);
+               }
+               else
+               {
+                  MySetColor(lvl, minv, maxv);
+                  glNormal3dv(normal);
+                  glBegin(GL_QUADS);
+                  for (int k = 0; k < 4; k++)
+                  {
+                     glVertex3dv(vert[k]);
+                  }
+                  glEnd();
                }
-               glEnd();
                quad_counter++;
             }
          }
+         else if (lsurf_simplifier)
+         {
+            lsurf_simplifier->AddQuad(vert, norm, lvl);
+            quad_counter++;
+         }
          else
          {
             MySetColor(lvl, minv, maxv);
@@ -3469,6 +3576,9 @@ void VisualizationSceneSolution3d::DrawRefinedHexLevelSurf(
 
 void VisualizationSceneSolution3d::PrepareLevelSurf()
 {
+   if (Deferred(LAYER_LEVEL_SURF)) { return; }
+   ProfileTimer timer("Solution3d::PrepareLevelSurf");
+
    static const int ident[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
 
    Vector vals;
@@ -3494,6 +3604,23 @@ void VisualizationSceneSolution3d::PrepareLevelSurf()
       levels[l] = ULogVal(lvl);
    }
 
+   SurfaceSimplifier simplifier;
+   if (lsurf_simplify < 1.0 || lsurf_simplify_error > 0.0)
+   {
+      // the error bound is given in pixels of the current view
+      GLint vp[4];
+      glGetIntegerv(GL_VIEWPORT, vp);
+      const double scale = max(xscale, max(yscale, zscale));
+      const double pixel = 1.0/(scale*ViewScale*max(min(vp[2], vp[3]), 1));
+      const double diam = sqrt((x[1]-x[0])*(x[1]-x[0]) +
+                               (y[1]-y[0])*(y[1]-y[0]) +
+                               (z[1]-z[0])*(z[1]-z[0]));
+      simplifier.SetTarget((lsurf_simplify < 1.0) ? lsurf_simplify : 0.0,
+                           lsurf_simplify_error*pixel);
+      simplifier.SetValueScale((maxv > minv) ? diam/(maxv-minv) : 0.0);
+      lsurf_simplifier = &simplifier;
+   }
+
    // For every quad face, choose the shorter diagonal to split the quad into
    // two triangles. Elements adjacent to that quad face (wedge or hex) will use
    // the same diagonal when subdividing the element.
@@ -3598,6 +3725,27 @@ void VisualizationSceneSolution3d::PrepareLevelSurf()
       }
    }
 
+   if (lsurf_simplifier)
+   {
+      lsurf_simplifier = NULL;
+      simplifier.Simplify();
+      triangle_counter = simplifier.GetNTriangles();
+      quad_counter = 0;
+
+      glBegin(GL_TRIANGLES);
+      for (int c = 0; c < simplifier.GetNChunks(); c++)
+      {
+         const SurfaceSimplifier::Triangles &tris = simplifier.GetChunk(c);
+         for (size_t i = 0; i < tris.size(); i += 7)
+         {
+            MySetColor(tris[i+6], minv, maxv);
+            glNormal3fv(&tris[i+3]);
+            glVertex3fv(&tris[i]);
+         }
+      }
+      glEnd();
+   }
+
    glEndList();
 
 #ifdef GLVIS_DEBUG
@@ -3607,8 +3755,29 @@ void VisualizationSceneSolution3d::PrepareLevelSurf()
 #endif
 }
 
+int VisualizationSceneSolution3d::Probe(const double *x, Vector &vals)
+{
+   if (GridF == NULL)
+   {
+      return -1;
+   }
+   IntegrationPoint ip;
+   int e = GetPointLocator()->FindPoint(x, ip);
+   if (e >= 0)
+   {
+      vals.SetSize(1);
+      vals(0) = GridF->GetValue(e, ip);
+   }
+   return e;
+}
+
 void VisualizationSceneSolution3d::Draw()
 {
+   ProfileTimer timer("Solution3d::Draw");
+
+   UpdateLayers();
+   bool proxy = ProxyActive();
+
    glEnable(GL_DEPTH_TEST);
 
    Set_Background();
@@ -3625,6 +3794,7 @@ void VisualizationSceneSolution3d::Draw()
    glDisable(GL_CLIP_PLANE0);
    // draw colorbar
    glDisable(GL_LIGHTING);
+   MarkRenderState();
    if (colorbar)
    {
       if (drawmesh == 2 || cp_drawmesh >= 2)
@@ -3671,6 +3841,7 @@ void VisualizationSceneSolution3d::Draw()
    if (light)
    {
       glEnable(GL_LIGHTING);
+      MarkRenderState();
    }
 
    if (MatAlpha < 1.0)
@@ -3681,6 +3852,7 @@ void VisualizationSceneSolution3d::Draw()
    if (GetUseTexture())
    {
       glEnable (GL_TEXTURE_1D);
+      MarkRenderState();
       glColor4d(1, 1, 1, 1); // default color
    }
 
@@ -3695,7 +3867,7 @@ void VisualizationSceneSolution3d::Draw()
    // draw elements
    if (drawelems)
    {
-      glCallList(displlist);
+      glCallList(proxy ? proxylist : displlist);
    }
 
    // draw ordering -- color modes
@@ -3718,6 +3890,7 @@ void VisualizationSceneSolution3d::Draw()
    if (GetUseTexture())
    {
       glDisable(GL_TEXTURE_1D);
+      MarkRenderState();
    }
 
    if (MatAlpha < 1.0)
@@ -3728,6 +3901,7 @@ void VisualizationSceneSolution3d::Draw()
    if (light)
    {
       glDisable(GL_LIGHTING);
+      MarkRenderState();
    }
    Set_Black_Material(); // everything below will be drawn in "black"
 
@@ -3750,7 +3924,7 @@ void VisualizationSceneSolution3d::Draw()
    // draw lines
    if (drawmesh)
    {
-      glCallList(linelist);
+      glCallList(proxy ? proxylinelist : linelist);
    }
 
    if (cplane)
@@ -3775,6 +3949,8 @@ void VisualizationSceneSolution3d::Draw()
       DrawCoordinateCross();
    }
 
+   DrawStats();
+
    glFlush();
    auxSwapBuffers();
 }
@@ -21,6 +21,8 @@ protected:
 
    int drawmesh, drawelems, shading, draworder;
    int displlist, linelist;
+   // the surface and the mesh lines without subdivision, see PrepareProxy()
+   int proxylist, proxylinelist;
    int order_list, order_list_noarrow;
    int cplane, cplanelist, cplanelineslist, lsurflist;
    int cp_drawmesh, cp_drawelems, drawlsurf;
@@ -38,6 +40,10 @@ protected:
 
    void Init();
 
+   virtual void RebuildLayers();
+   virtual bool HasProxy() { return (shading == 2 && TimesToRefine > 1); }
+   virtual void PrepareProxy();
+
    void GetFaceNormals(const int FaceNo, const int side,
                        const IntegrationRule &ir, DenseMatrix &normals);
 
@@ -86,6 +92,13 @@ public:
    int TimesToRefine;
    double FaceShiftScale;
 
+   // Simplify the level surfaces for display, keeping about 'lsurf_simplify'
+   // of their triangles (1 = all), but with a mean error of at most
+   // 'lsurf_simplify_error' pixels in the view at the time they are built (0 =
+   // no limit). Both at their defaults turn the simplification off. See
+   // SurfaceSimplifier.
+   static double lsurf_simplify, lsurf_simplify_error;
+
    Array<int> bdr_attr_to_show;
 
    VisualizationSceneSolution3d();
@@ -108,6 +121,8 @@ public:
    virtual void PrepareOrderingCurve1(int list, bool arrows, bool color);
    virtual void Draw();
 
+   virtual int Probe(const double *x, Vector &vals);
+
    void ToggleDrawElems()
    { drawelems = !drawelems; Prepare(); }
 
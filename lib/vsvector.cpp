@@ -13,6 +13,7 @@
 #include <iostream>
 #include <limits>
 #include <cmath>
+#include <X11/keysym.h>
 
 #include "mfem.hpp"
 using namespace mfem;
@@ -55,8 +56,11 @@ static void VectorKeyHPressed()
         << "| S -  Take snapshot/Record a movie  |" << endl
         << "| t -  Cycle materials and lights    |" << endl
         << "| \\ -  Set light source position     |" << endl
+        << "| % -  Show/hide timing statistics   |" << endl
         << "| v -  Cycle through vector fields   |" << endl
         << "| V -  Change the arrows scaling     |" << endl
+        << "| # -  Screen-space vector seeding   |" << endl
+        << "| $ -  Add streamlines (seeds)       |" << endl
         << "| Ctrl+p - Print to a PDF file       |" << endl
         << "+------------------------------------+" << endl
         << "| Function keys                      |" << endl
@@ -89,6 +93,7 @@ static void VectorKeyHPressed()
         << "| right + Shift - Change light pos.  |" << endl
         << "| left  + Ctrl  - Spherical rotation |" << endl
         << "| middle+ Ctrl  - Object translation |" << endl
+        << "| middle+ Shift - Value at the point |" << endl
         << "| right + Ctrl  - Object scaling     |" << endl
         << "| left  + Ctrl + Shift - z-Spinning  |" << endl
         << "+------------------------------------+" << endl;
@@ -139,6 +144,12 @@ void KeyvPressed()
    SendExposeEvent();
 }
 
+void KeyNumberSignPressed()
+{
+   vsvector -> ToggleVectorSeeding();
+   SendExposeEvent();
+}
+
 void KeyVPressed()
 {
    cout << "New arrow scale: " << flush;
@@ -241,6 +252,26 @@ void VisualizationSceneVector::ToggleVectorField()
    PrepareVectorField();
 }
 
+void VisualizationSceneVector::ToggleVectorSeeding()
+{
+   if (!seed_vectors)
+   {
+      if (VecGridF == NULL)
+      {
+         cout << "Vector seeding requires a vector GridFunction" << endl;
+         return;
+      }
+      if (!GetPointLocator()->Valid())
+      {
+         cout << "Vector seeding is not supported for this mesh" << endl;
+         return;
+      }
+   }
+   seed_vectors = !seed_vectors;
+   cout << "Vector seeding: " << (seed_vectors ? "on" : "off") << endl;
+   PrepareVectorField();
+}
+
 const char *Vec2ScalarNames[7] =
 {
    "magnitude", "direction", "x-component", "y-component", "divergence",
@@ -400,6 +431,15 @@ void VisualizationSceneVector::CycleVec2Scalar(int print)
 
 void VisualizationSceneVector::NewMeshAndSolution(GridFunction &vgf)
 {
+   // the streamlines are traced again from the same seeds
+   Array<double> sl_seeds;
+   if (streamlines)
+   {
+      streamlines->GetSeeds().Copy(sl_seeds);
+      delete streamlines;
+      streamlines = NULL;
+   }
+
    delete sol;
 
    if (VecGridF)
@@ -468,6 +508,11 @@ void VisualizationSceneVector::NewMeshAndSolution(GridFunction &vgf)
    }
 
    PrepareVectorField();
+
+   if (sl_seeds.Size() > 0)
+   {
+      AddStreamlineSeeds(sl_seeds);
+   }
 }
 
 void VisualizationSceneVector::Init()
@@ -476,6 +521,9 @@ void VisualizationSceneVector::Init()
    drawvector = 0;
    ArrowScale = 1.0;
    RefineFactor = 1;
+   seed_vectors = false;
+   seed_h = 0.0;
+   streamlines = NULL;
    Vec2Scalar = VecLength;
    extra_caption = Vec2ScalarNames[0];
 
@@ -510,6 +558,7 @@ void VisualizationSceneVector::Init()
       auxKeyFunc (AUX_V, KeyVPressed);
       auxKeyFunc (AUX_u, KeyuPressed);
       auxKeyFunc (AUX_U, KeyUPressed);
+      auxKeyFunc (XK_numbersign, KeyNumberSignPressed);
    }
 
    // Vec2Scalar is VecLength
@@ -518,6 +567,7 @@ void VisualizationSceneVector::Init()
 
 VisualizationSceneVector::~VisualizationSceneVector()
 {
+   delete streamlines;
    glDeleteLists (displinelist, 1);
    glDeleteLists (vectorlist, 1);
 
@@ -655,6 +705,9 @@ int VisualizationSceneVector::GetRefinedValuesAndNormals(
 
 void VisualizationSceneVector::PrepareDisplacedMesh()
 {
+   if (Deferred(LAYER_DISPLACED_MESH)) { return; }
+   ProfileTimer timer("Vector::PrepareDisplacedMesh");
+
    int i, j, ne = mesh -> GetNE();
    DenseMatrix pointmat;
    Array<int> vertices;
@@ -855,7 +908,8 @@ void VisualizationSceneVector::DrawVector(double px, double py, double vx,
    else if (drawvector > 0)
    {
       double area = (x[1]-x[0])*(y[1]-y[0]);
-      double h = sqrt(area/mesh->GetNV()) * ArrowScale;
+      double h = (seed_vectors ? seed_h : sqrt(area/mesh->GetNV())) *
+                 ArrowScale;
 
       arrow_type = 1;
       arrow_scaling_type = 1;
@@ -879,8 +933,21 @@ void VisualizationSceneVector::DrawVector(double px, double py, double vx,
    }
 }
 
+void VisualizationSceneVector::RebuildLayers()
+{
+   VisualizationSceneSolution::RebuildLayers();
+   if (dirty_layers & LAYER_VECTORS) { PrepareVectorField(); }
+   if ((dirty_layers & LAYER_DISPLACED_MESH) && drawdisp)
+   {
+      PrepareDisplacedMesh();
+   }
+}
+
 void VisualizationSceneVector::PrepareVectorField()
 {
+   if (Deferred(LAYER_VECTORS)) { return; }
+   ProfileTimer timer("Vector::PrepareVectorField");
+
    int rerun;
    do
    {
@@ -888,7 +955,9 @@ void VisualizationSceneVector::PrepareVectorField()
 
       glNewList(vectorlist, GL_COMPILE);
 
-      if (drawvector > 0)
+      // with seeding, the vectors are evaluated in Draw()
+      seeds.Invalidate();
+      if (drawvector > 0 && !seed_vectors)
       {
          int i;
 
@@ -953,8 +1022,131 @@ void VisualizationSceneVector::PrepareVectorField()
    while (rerun);
 }
 
+void VisualizationSceneVector::SeedVectors()
+{
+   if (!seeds.Update())
+   {
+      return;
+   }
+   PointLocator *loc = GetPointLocator();
+
+   // the arrows are drawn in the plane z = zc, see DrawVector()
+   const double zc = 0.5*(z[0]+z[1]);
+   const GLint *vp = seeds.Viewport();
+   double p0[3], p1[3];
+   seed_h = 0.0;
+   if (seeds.UnProjectToPlane(vp[0], vp[1], zc, p0) &&
+       seeds.UnProjectToPlane(vp[0] + seeds.spacing, vp[1], zc, p1))
+   {
+      seed_h = sqrt((p1[0]-p0[0])*(p1[0]-p0[0]) +
+                    (p1[1]-p0[1])*(p1[1]-p0[1]));
+   }
+
+   IntegrationPoint ip;
+   Vector v(2);
+   int e = -1;
+   seed_vals.SetSize(0);
+   for (int i = 0; i < seeds.win.Size(); i += 2)
+   {
+      double p[3];
+      if (!seeds.UnProjectToPlane(seeds.win[i], seeds.win[i+1], zc, p))
+      {
+         continue;
+      }
+      // neighboring seeds are often in the same element
+      e = loc->FindPoint(p, ip, e);
+      if (e < 0)
+      {
+         continue;
+      }
+      VecGridF->GetVectorValue(e, ip, v);
+      seed_vals.Append(p[0]);
+      seed_vals.Append(p[1]);
+      seed_vals.Append(v(0));
+      seed_vals.Append(v(1));
+      seed_vals.Append(Vec2Scalar(v(0), v(1)));
+   }
+}
+
+void VisualizationSceneVector::DrawSeededVectors()
+{
+   MySetColorLogscale = logscale;
+   for (int i = 0; i < seed_vals.Size(); i += 5)
+   {
+      const double *sv = &seed_vals[i];
+      DrawVector(sv[0], sv[1], sv[2], sv[3], sv[4]);
+   }
+}
+
+int VisualizationSceneVector::Probe(const double *x, Vector &vals)
+{
+   if (VecGridF == NULL)
+   {
+      return -1;
+   }
+   IntegrationPoint ip;
+   int e = GetPointLocator()->FindPoint(x, ip);
+   if (e >= 0)
+   {
+      VecGridF->GetVectorValue(e, ip, vals);
+   }
+   return e;
+}
+
+void VisualizationSceneVector::AddStreamlineSeeds(const Array<double> &s)
+{
+   if (VecGridF == NULL || mesh->NURBSext)
+   {
+      cout << "Streamlines require a vector GridFunction on a non-NURBS mesh"
+           << endl;
+      return;
+   }
+   if (!GetPointLocator()->Valid())
+   {
+      cout << "Streamlines are not supported for this mesh" << endl;
+      return;
+   }
+   if (streamlines == NULL)
+   {
+      streamlines = new Streamlines(VecGridF, GetPointLocator());
+   }
+   SetStreamlineColors();
+   streamlines->AddSeeds(s);
+}
+
+void VisualizationSceneVector::ClearStreamlines()
+{
+   delete streamlines;
+   streamlines = NULL;
+}
+
+void VisualizationSceneVector::PrepareStreamlines()
+{
+   ProfileTimer timer("Vector::PrepareStreamlines");
+
+   if (streamlines)
+   {
+      SetStreamlineColors();
+      streamlines->Prepare();
+   }
+}
+
+void VisualizationSceneVector::SetStreamlineColors()
+{
+   // the ribbons are drawn in the plane of the arrows, see DrawVector()
+   streamlines->zc = 0.5*(z[0]+z[1]);
+   streamlines->minv = minv;
+   streamlines->maxv = maxv;
+   MySetColorLogscale = logscale;
+}
+
 void VisualizationSceneVector::Draw()
 {
+   ProfileTimer timer("Vector::Draw");
+
+   UpdateLayers();
+   bool proxy = ProxyActive();
+
    glEnable(GL_DEPTH_TEST);
 
    Set_Background();
@@ -971,6 +1163,7 @@ void VisualizationSceneVector::Draw()
    glDisable(GL_CLIP_PLANE0);
    // draw colorbar
    glDisable(GL_LIGHTING);
+   MarkRenderState();
    if (colorbar)
    {
       if (drawmesh == 2)
@@ -993,18 +1186,30 @@ void VisualizationSceneVector::Draw()
    if (light)
    {
       glEnable(GL_LIGHTING);
+      MarkRenderState();
    }
 
    if (GetUseTexture())
    {
       glEnable (GL_TEXTURE_1D);
+      MarkRenderState();
       glColor4d(1, 1, 1, 1);
    }
 
+   if (seed_vectors && drawvector > 0)
+   {
+      SeedVectors();
+   }
+
    // draw vector field
    if (drawvector > 1)
    {
-      glCallList(vectorlist);
+      DrawVectorField();
+   }
+
+   if (streamlines)
+   {
+      streamlines->Draw();
    }
 
    if (MatAlpha < 1.0)
@@ -1015,7 +1220,7 @@ void VisualizationSceneVector::Draw()
    // draw elements
    if (drawelems)
    {
-      glCallList(displlist);
+      glCallList(proxy ? proxylist : displlist);
    }
 
    if (MatAlpha < 1.0)
@@ -1026,11 +1231,13 @@ void VisualizationSceneVector::Draw()
    if (GetUseTexture())
    {
       glDisable (GL_TEXTURE_1D);
+      MarkRenderState();
    }
 
    if (light)
    {
       glDisable(GL_LIGHTING);
+      MarkRenderState();
    }
    Set_Black_Material();
 
@@ -1055,7 +1262,7 @@ void VisualizationSceneVector::Draw()
    // draw lines
    if (drawmesh == 1)
    {
-      glCallList(linelist);
+      glCallList(proxy ? proxylinelist : linelist);
    }
    else if (drawmesh == 2)
    {
@@ -1068,16 +1275,18 @@ void VisualizationSceneVector::Draw()
       if (1 == drawnums)
       {
          glCallList(e_nums_list);
+         e_nums_text.Draw();
       }
       else if (2 == drawnums)
       {
          glCallList(v_nums_list);
+         v_nums_text.Draw();
       }
    }
 
    if (drawvector == 1)
    {
-      glCallList(vectorlist);
+      DrawVectorField();
    }
 
    if (drawdisp > 0)
@@ -1105,6 +1314,8 @@ void VisualizationSceneVector::Draw()
       DrawCoordinateCross();
    }
 
+   DrawStats();
+
    glFlush();
    auxSwapBuffers();
 }
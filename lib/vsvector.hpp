@@ -26,6 +26,8 @@ protected:
 
    void Init();
 
+   virtual void RebuildLayers();
+
    virtual void GetRefinedValues(int i, const IntegrationRule &ir,
                                  Vector &vals, DenseMatrix &tr);
    virtual int GetRefinedValuesAndNormals(int i, const IntegrationRule &ir,
@@ -41,6 +43,29 @@ protected:
    Vector vc0;
    IsoparametricTransformation T0;
 
+   // Screen-space seeding of the vectors: instead of the vertices, the arrows
+   // are placed on a jittered screen grid and the field is evaluated at the
+   // seeds, see ToggleVectorSeeding().
+   bool seed_vectors;
+   ScreenSeeds seeds;
+   // (x, y, vx, vy, scalar value) for each seed inside the mesh
+   Array<double> seed_vals;
+   // world-space size of the seed spacing, used as the arrow length
+   double seed_h;
+
+   void SeedVectors();
+   void DrawSeededVectors();
+   void DrawVectorField()
+   {
+      if (seed_vectors) { DrawSeededVectors(); }
+      else { glCallList(vectorlist); }
+   }
+
+   // Created by the first call to AddStreamlineSeeds()
+   Streamlines *streamlines;
+   void SetStreamlineColors();
+   void PrepareStreamlines();
+
 public:
    VisualizationSceneVector(Mesh &m, Vector &sx, Vector &sy);
    VisualizationSceneVector(GridFunction &vgf);
@@ -58,6 +83,7 @@ public:
 
    virtual void PrepareVectorField();
    void ToggleVectorField();
+   void ToggleVectorSeeding();
 
    void ToggleDisplacements()
    {
@@ -70,7 +96,13 @@ public:
 
    virtual void Draw();
 
-   virtual void EventUpdateColors() { Prepare(); PrepareVectorField(); }
+   virtual int Probe(const double *x, Vector &vals);
+
+   virtual void AddStreamlineSeeds(const Array<double> &s);
+   virtual void ClearStreamlines();
+
+   virtual void EventUpdateColors()
+   { Prepare(); PrepareVectorField(); PrepareStreamlines(); }
 
    // refinement factor for the vectors
    int RefineFactor;
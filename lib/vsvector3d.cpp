@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include <X11/keysym.h>
 #include <limits>
 
 #include "mfem.hpp"
@@ -56,9 +57,12 @@ static void VectorKeyHPressed()
         << "| S -  Take snapshot/Record a movie  |" << endl
         << "| t -  Cycle materials and lights    |" << endl
         << "| \\ -  Set light source position     |" << endl
+        << "| % -  Show/hide timing statistics   |" << endl
         << "| u/U  Move the level field vectors  |" << endl
         << "| v/V  Vector field                  |" << endl
         << "| w/W  Add/Delete level field vector |" << endl
+        << "| #    Screen-space vector seeding   |" << endl
+        << "| $    Add streamlines (seeds)       |" << endl
         << "| x/X  Rotate clipping plane (phi)   |" << endl
         << "| y/Y  Rotate clipping plane (theta) |" << endl
         << "| z/Z  Translate clipping plane      |" << endl
@@ -93,6 +97,7 @@ static void VectorKeyHPressed()
         << "| right + Shift - Change light pos.  |" << endl
         << "| left  + Ctrl  - Spherical rotation |" << endl
         << "| middle+ Ctrl  - Object translation |" << endl
+        << "| middle+ Shift - Value at the point |" << endl
         << "| right + Ctrl  - Object scaling     |" << endl
         << "| left  + Ctrl + Shift - z-Spinning  |" << endl
         << "+------------------------------------+" << endl;
@@ -243,6 +248,12 @@ static void KeyVPressed()
    SendExposeEvent();
 }
 
+static void KeyNumberSignPressed()
+{
+   vsvector3d -> ToggleVectorSeeding();
+   SendExposeEvent();
+}
+
 static void VectorKeyFPressed()
 {
    vsvector3d->ToggleScalarFunction();
@@ -255,6 +266,26 @@ void VisualizationSceneVector3d::ToggleVectorField(int i)
    PrepareVectorField();
 }
 
+void VisualizationSceneVector3d::ToggleVectorSeeding()
+{
+   if (!seed_vectors)
+   {
+      if (VecGridF == NULL)
+      {
+         cout << "Vector seeding requires a vector GridFunction" << endl;
+         return;
+      }
+      if (!GetPointLocator()->Valid())
+      {
+         cout << "Vector seeding is not supported for this mesh" << endl;
+         return;
+      }
+   }
+   seed_vectors = !seed_vectors;
+   cout << "Vector seeding: " << (seed_vectors ? "on" : "off") << endl;
+   PrepareVectorField();
+}
+
 static const char *scal_func_name[] =
 {"magnitude", "x-component", "y-component", "z-component"};
 
@@ -373,6 +404,8 @@ void VisualizationSceneVector3d::Init()
    drawdisp = 0;
    drawvector = 0;
    scal_func = 0;
+   seed_vectors = false;
+   streamlines = NULL;
 
    ianim = ianimd = 0;
    ianimmax = 10;
@@ -422,11 +455,14 @@ void VisualizationSceneVector3d::Init()
       auxKeyFuncReplace (AUX_V, KeyVPressed); // VisualizationSceneSolution3d
 
       auxKeyFunc(AUX_F, VectorKeyFPressed);
+
+      auxKeyFunc(XK_numbersign, KeyNumberSignPressed);
    }
 }
 
 VisualizationSceneVector3d::~VisualizationSceneVector3d()
 {
+   delete streamlines;
    glDeleteLists (vectorlist, 1);
    glDeleteLists (displinelist, 1);
 
@@ -445,6 +481,15 @@ VisualizationSceneVector3d::~VisualizationSceneVector3d()
 void VisualizationSceneVector3d::NewMeshAndSolution(
    Mesh *new_m, GridFunction *new_v)
 {
+   // the streamlines are traced again from the same seeds
+   Array<double> sl_seeds;
+   if (streamlines)
+   {
+      streamlines->GetSeeds().Copy(sl_seeds);
+      delete streamlines;
+      streamlines = NULL;
+   }
+
    delete sol;
    if (VecGridF)
    {
@@ -480,6 +525,8 @@ void VisualizationSceneVector3d::NewMeshAndSolution(
    mesh = new_m;
    FindNodePos();
 
+   FreePointLocator();
+
    sfes = new FiniteElementSpace(mesh, new_fes->FEColl(), 1,
                                  new_fes->GetOrdering());
    GridF = new GridFunction(sfes);
@@ -505,10 +552,17 @@ void VisualizationSceneVector3d::NewMeshAndSolution(
 
    PrepareVectorField();
    PrepareDisplacedMesh();
+
+   if (sl_seeds.Size() > 0)
+   {
+      AddStreamlineSeeds(sl_seeds);
+   }
 }
 
 void VisualizationSceneVector3d::PrepareFlat()
 {
+   ProfileTimer timer("Vector3d::PrepareFlat");
+
    int i, j;
 
    glNewList (displlist, GL_COMPILE);
@@ -564,6 +618,8 @@ void VisualizationSceneVector3d::PrepareFlat()
 
 void VisualizationSceneVector3d::PrepareFlat2()
 {
+   ProfileTimer timer("Vector3d::PrepareFlat2");
+
    int i, k, fn, fo, di = 0, have_normals;
    double bbox_diam, vmin, vmax;
    int dim = mesh->Dimension();
@@ -724,8 +780,14 @@ void VisualizationSceneVector3d::PrepareFlat2()
 
 void VisualizationSceneVector3d::Prepare()
 {
+   if (Deferred(LAYER_SURFACE)) { return; }
+   ProfileTimer timer("Vector3d::Prepare");
+
    int i,j;
 
+   // the visible surfaces may change
+   seeds.Invalidate();
+
    switch (shading)
    {
       case 0:
@@ -848,6 +910,9 @@ void VisualizationSceneVector3d::Prepare()
 
 void VisualizationSceneVector3d::PrepareLines()
 {
+   if (Deferred(LAYER_MESH)) { return; }
+   ProfileTimer timer("Vector3d::PrepareLines");
+
    if (!drawmesh) { return; }
 
    if (shading == 2)
@@ -929,6 +994,8 @@ void VisualizationSceneVector3d::PrepareLines()
 
 void VisualizationSceneVector3d::PrepareLines2()
 {
+   ProfileTimer timer("Vector3d::PrepareLines2");
+
    int i, j, k, fn, fo, di = 0;
    double bbox_diam;
 
@@ -1103,6 +1170,9 @@ void VisualizationSceneVector3d::PrepareLines2()
 
 void VisualizationSceneVector3d::PrepareDisplacedMesh()
 {
+   if (Deferred(LAYER_DISPLACED_MESH)) { return; }
+   ProfileTimer timer("Vector3d::PrepareDisplacedMesh");
+
    int dim = mesh->Dimension();
    int i, j, ne = (dim == 3) ? mesh->GetNBE() : mesh->GetNE();
    DenseMatrix pointmat;
@@ -1203,12 +1273,14 @@ int ArrowDrawOrNot (double v, int nl, Array<double> & level)
 
 void VisualizationSceneVector3d::DrawVector(int type, double v0, double v1,
                                             double v2, double sx, double sy,
-                                            double sz, double s)
+                                            double sz, double s, double size)
 {
    static int nv = mesh -> GetNV();
    static double volume = (x[1]-x[0])*(y[1]-y[0])*(z[1]-z[0]);
-   static double h      = pow(volume/nv, 0.333);
-   static double hh     = pow(volume, 0.333) / 10;
+   static double h0     = pow(volume/nv, 0.333);
+   static double hh0    = pow(volume, 0.333) / 10;
+   const double h  = (size > 0.0) ? size : h0;
+   const double hh = (size > 0.0) ? size : hh0;
 
    switch (type)
    {
@@ -1217,7 +1289,7 @@ void VisualizationSceneVector3d::DrawVector(int type, double v0, double v1,
          arrow_type = 0;
          arrow_scaling_type = 0;
          // glColor3f(0, 0, 0); // color is set in Draw()
-         Arrow(v0,v1,v2,sx,sy,sz,s);
+         ArrowInstance(v0,v1,v2,sx,sy,sz,s);
       }
       break;
 
@@ -1226,7 +1298,7 @@ void VisualizationSceneVector3d::DrawVector(int type, double v0, double v1,
          arrow_type = 1;
          arrow_scaling_type = 1;
          MySetColor(s, minv, maxv);
-         Arrow(v0,v1,v2,sx,sy,sz,h,0.125);
+         ArrowInstance(v0,v1,v2,sx,sy,sz,h,0.125);
       }
       break;
 
@@ -1236,7 +1308,7 @@ void VisualizationSceneVector3d::DrawVector(int type, double v0, double v1,
          arrow_scaling_type = 1;
          // MySetColor(s,maxv,minv);
          MySetColor(s, minv, maxv);
-         Arrow(v0,v1,v2,sx,sy,sz,h*s/maxv,0.125);
+         ArrowInstance(v0,v1,v2,sx,sy,sz,h*s/maxv,0.125);
       }
       break;
 
@@ -1246,80 +1318,68 @@ void VisualizationSceneVector3d::DrawVector(int type, double v0, double v1,
          arrow_type = 1;
          arrow_scaling_type = 1;
          glColor3f(0.3, 0.3, 0.3);
-         Arrow(v0,v1,v2,sx,sy,sz,hh*s/maxv,0.125);
+         ArrowInstance(v0,v1,v2,sx,sy,sz,hh*s/maxv,0.125);
       }
       break;
    }
 }
 
+void VisualizationSceneVector3d::PrepareArrowLists()
+{
+   ProfileTimer timer("Vector3d::PrepareArrowLists");
+
+   // the unit arrows used by DrawVector()
+   GetArrowList(0, 0.075);
+   GetArrowList(1, 0.125);
+}
+
+void VisualizationSceneVector3d::RebuildLayers()
+{
+   VisualizationSceneSolution3d::RebuildLayers();
+   if (dirty_layers & LAYER_VECTORS) { PrepareVectorField(); }
+   if ((dirty_layers & LAYER_DISPLACED_MESH) && drawdisp)
+   {
+      PrepareDisplacedMesh();
+   }
+}
+
 void VisualizationSceneVector3d::PrepareVectorField()
 {
+   if (Deferred(LAYER_VECTORS)) { return; }
+   ProfileTimer timer("Vector3d::PrepareVectorField");
+
    int i, nv = mesh -> GetNV();
    double *vertex;
 
-   glNewList(vectorlist, GL_COMPILE);
+   // the vertices with an arrow, in drawing order
+   Array<int> arrows;
 
-   switch (drawvector)
+   // with seeding, the vectors are evaluated in Draw()
+   seeds.Invalidate();
+   switch (Seeding() ? 0 : drawvector)
    {
       case 0:
          break;
 
       case 1:
-         for (i = 0; i < nv; i++)
-            if (drawmesh != 2 || ArrowDrawOrNot((*sol)(i), nl, level))
-            {
-               vertex = mesh->GetVertex(i);
-               DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
-                          (*solx)(i), (*soly)(i), (*solz)(i), (*sol)(i));
-            }
-         break;
-
       case 2:
-      {
-         arrow_type = 1;
-         arrow_scaling_type = 1;
-         for (i = 0; i < nv; i++)
-            if (drawmesh != 2 || ArrowDrawOrNot((*sol)(i), nl, level))
-            {
-               vertex = mesh->GetVertex(i);
-               DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
-                          (*solx)(i), (*soly)(i), (*solz)(i), (*sol)(i));
-            }
-      }
-      break;
-
       case 3:
-      {
-         arrow_type = 1;
-         arrow_scaling_type = 1;
-
+         arrows.Reserve(nv);
          for (i = 0; i < nv; i++)
             if (drawmesh != 2 || ArrowDrawOrNot((*sol)(i), nl, level))
             {
-               vertex = mesh->GetVertex(i);
-               DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
-                          (*solx)(i), (*soly)(i), (*solz)(i), (*sol)(i));
+               arrows.Append(i);
             }
-      }
-      break;
+         break;
 
       case 4:
       {
          Array<int> *l = new Array<int>[nl+1];
          ArrowsDrawOrNot(l, nv, *sol, nl, level);
 
-         int j,k;
-
-         for (k = 0; k < vflevel.Size(); k++)
+         for (int k = 0; k < vflevel.Size(); k++)
          {
-            i = vflevel[k];
-            for (j = 0; j < l[i].Size(); j++)
-            {
-               vertex = mesh->GetVertex( l[i][j] );
-               DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
-                          (*solx)(l[i][j]), (*soly)(l[i][j]), (*solz)(l[i][j]),
-                          (*sol)(l[i][j]));
-            }
+            arrows.Append(l[vflevel[k]]);
          }
 
          delete [] l;
@@ -1348,21 +1408,35 @@ void VisualizationSceneVector3d::PrepareVectorField()
             {
                i = vertices[j];
                if (vert_marker[i]) { continue; }
-               vertex = mesh->GetVertex(i);
-               DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
-                          (*solx)(i), (*soly)(i), (*solz)(i), (*sol)(i));
+               arrows.Append(i);
                vert_marker[i] = true;
             }
          }
       }
       break;
    }
-   glEndList();
 
+   PrepareArrowLists();
+
+   glNewList(vectorlist, GL_COMPILE);
+   for (int k = 0; k < arrows.Size(); k++)
+   {
+      i = arrows[k];
+      vertex = mesh->GetVertex(i);
+      DrawVector(drawvector, vertex[0], vertex[1], vertex[2],
+                 (*solx)(i), (*soly)(i), (*solz)(i), (*sol)(i));
+   }
+   glEndList();
 }
 
 void VisualizationSceneVector3d::PrepareCuttingPlane()
 {
+   if (Deferred(LAYER_CUTTING_PLANE)) { return; }
+   ProfileTimer timer("Vector3d::PrepareCuttingPlane");
+
+   // the visible surfaces may change
+   seeds.Invalidate();
+
    if (cp_drawelems == 0 || cplane != 1 || drawvector == 0 ||
        mesh->Dimension() != 3)
    {
@@ -1374,6 +1448,8 @@ void VisualizationSceneVector3d::PrepareCuttingPlane()
    int flag[4], ind[6][2]= {{0,3},{0,2},{0,1},{1,2},{1,3},{2,3}};
    double t, point[4][4], val[4][3];
 
+   PrepareArrowLists();
+
    glNewList(cplanelist, GL_COMPILE);
 
    DenseMatrix pointmat(3,4);
@@ -1502,8 +1578,172 @@ void VisualizationSceneVector3d::PrepareCuttingPlane()
    glEndList();
 }
 
+void VisualizationSceneVector3d::SeedVectors()
+{
+   if (!seeds.Update())
+   {
+      return;
+   }
+   PointLocator *loc = GetPointLocator();
+   seed_vals.SetSize(0);
+   if (!loc->Valid())
+   {
+      return;
+   }
+
+   const GLint *vp = seeds.Viewport();
+   if (vp[2] <= 0 || vp[3] <= 0)
+   {
+      return;
+   }
+   Array<GLfloat> depth(vp[2]*vp[3]);
+   glReadPixels(vp[0], vp[1], vp[2], vp[3], GL_DEPTH_COMPONENT, GL_FLOAT,
+                depth.GetData());
+
+   // The points read from the depth buffer are on the boundary of the mesh (or
+   // on the cutting plane), so move them slightly along the view direction to
+   // get them inside the elements.
+   const double eps = 1e-4*sqrt((x[1]-x[0])*(x[1]-x[0]) +
+                                (y[1]-y[0])*(y[1]-y[0]) +
+                                (z[1]-z[0])*(z[1]-z[0]));
+   IntegrationPoint ip;
+   Vector v(3);
+   int e = -1;
+   for (int i = 0; i < seeds.win.Size(); i += 2)
+   {
+      const double wx = seeds.win[i], wy = seeds.win[i+1];
+      const int px = (int) (wx - vp[0]), py = (int) (wy - vp[1]);
+      const double wz = depth[py*vp[2] + px];
+      if (wz >= 1.0)
+      {
+         continue;
+      }
+
+      double p[3], p0[3], p1[3], dir[3], q[3];
+      seeds.UnProject(wx, wy, wz, p);
+      seeds.UnProject(wx, wy, 0.0, p0);
+      seeds.UnProject(wx, wy, 1.0, p1);
+      double len = 0.0;
+      for (int d = 0; d < 3; d++)
+      {
+         dir[d] = p1[d] - p0[d];
+         len += dir[d]*dir[d];
+      }
+      len = sqrt(len);
+      if (len == 0.0)
+      {
+         continue;
+      }
+      for (int d = 0; d < 3; d++)
+      {
+         p[d] += eps*dir[d]/len;
+      }
+
+      // neighboring seeds are often in the same element
+      e = loc->FindPoint(p, ip, e);
+      if (e < 0)
+      {
+         continue;
+      }
+      VecGridF->GetVectorValue(e, ip, v);
+
+      // see SetScalarFunction()
+      const double s = (scal_func == 0) ? v.Norml2() : v(scal_func-1);
+
+      // the arrows span about one grid spacing on the screen
+      seeds.UnProject(wx + seeds.spacing, wy, wz, q);
+      const double size = sqrt((q[0]-p[0])*(q[0]-p[0]) +
+                               (q[1]-p[1])*(q[1]-p[1]) +
+                               (q[2]-p[2])*(q[2]-p[2]));
+
+      seed_vals.Append(p[0]);
+      seed_vals.Append(p[1]);
+      seed_vals.Append(p[2]);
+      seed_vals.Append(v(0));
+      seed_vals.Append(v(1));
+      seed_vals.Append(v(2));
+      seed_vals.Append(s);
+      seed_vals.Append(size);
+   }
+}
+
+void VisualizationSceneVector3d::DrawSeededVectors()
+{
+   for (int i = 0; i < seed_vals.Size(); i += 8)
+   {
+      const double *sv = &seed_vals[i];
+      DrawVector(drawvector, sv[0], sv[1], sv[2], sv[3], sv[4], sv[5], sv[6],
+                 sv[7]);
+   }
+}
+
+int VisualizationSceneVector3d::Probe(const double *x, Vector &vals)
+{
+   if (VecGridF == NULL)
+   {
+      return -1;
+   }
+   IntegrationPoint ip;
+   int e = GetPointLocator()->FindPoint(x, ip);
+   if (e >= 0)
+   {
+      VecGridF->GetVectorValue(e, ip, vals);
+   }
+   return e;
+}
+
+void VisualizationSceneVector3d::AddStreamlineSeeds(const Array<double> &s)
+{
+   if (VecGridF == NULL || mesh->NURBSext)
+   {
+      cout << "Streamlines require a vector GridFunction on a non-NURBS mesh"
+           << endl;
+      return;
+   }
+   if (!GetPointLocator()->Valid())
+   {
+      cout << "Streamlines are not supported for this mesh" << endl;
+      return;
+   }
+   if (streamlines == NULL)
+   {
+      streamlines = new Streamlines(VecGridF, GetPointLocator());
+   }
+   SetStreamlineColors();
+   streamlines->AddSeeds(s);
+}
+
+void VisualizationSceneVector3d::ClearStreamlines()
+{
+   delete streamlines;
+   streamlines = NULL;
+}
+
+void VisualizationSceneVector3d::PrepareStreamlines()
+{
+   ProfileTimer timer("Vector3d::PrepareStreamlines");
+
+   if (streamlines)
+   {
+      SetStreamlineColors();
+      streamlines->Prepare();
+   }
+}
+
+void VisualizationSceneVector3d::SetStreamlineColors()
+{
+   streamlines->minv = minv;
+   streamlines->maxv = maxv;
+   MySetColorLogscale = logscale;
+}
+
 void VisualizationSceneVector3d::Draw()
 {
+   ProfileTimer timer("Vector3d::Draw");
+
+   UpdateLayers();
+   bool proxy = ProxyActive();
+
    glEnable(GL_DEPTH_TEST);
 
    Set_Background();
@@ -1520,6 +1760,7 @@ void VisualizationSceneVector3d::Draw()
    glDisable(GL_CLIP_PLANE0);
    // draw colorbar
    glDisable(GL_LIGHTING);
+   MarkRenderState();
    if (colorbar)
    {
       if (drawvector == 4)
@@ -1551,6 +1792,7 @@ void VisualizationSceneVector3d::Draw()
    if (GetUseTexture())
    {
       glEnable (GL_TEXTURE_1D);
+      MarkRenderState();
       glColor4d(1, 1, 1, 1);
    }
 
@@ -1558,10 +1800,11 @@ void VisualizationSceneVector3d::Draw()
    if (light)
    {
       glEnable(GL_LIGHTING);
+      MarkRenderState();
    }
 
    // draw vector field
-   if (drawvector == 2 || drawvector == 3)
+   if ((drawvector == 2 || drawvector == 3) && !Seeding())
    {
       glCallList(vectorlist);
    }
@@ -1569,7 +1812,7 @@ void VisualizationSceneVector3d::Draw()
    // draw elements
    if (drawelems)
    {
-      glCallList(displlist);
+      glCallList(proxy ? proxylist : displlist);
    }
 
    if (cplane && cp_drawelems)
@@ -1579,9 +1822,25 @@ void VisualizationSceneVector3d::Draw()
       glEnable(GL_CLIP_PLANE0);
    }
 
+   // the seeds are on the surfaces drawn so far
+   if (Seeding())
+   {
+      SeedVectors();
+      if (drawvector == 2 || drawvector == 3)
+      {
+         DrawSeededVectors();
+      }
+   }
+
+   if (streamlines)
+   {
+      streamlines->Draw();
+   }
+
    if (GetUseTexture())
    {
       glDisable(GL_TEXTURE_1D);
+      MarkRenderState();
    }
 
    if (MatAlpha < 1.0)
@@ -1592,18 +1851,19 @@ void VisualizationSceneVector3d::Draw()
    if (light)
    {
       glDisable(GL_LIGHTING);
+      MarkRenderState();
    }
 
    if (drawvector > 3)
    {
-      glCallList(vectorlist);
+      DrawVectorField();
    }
 
    Set_Black_Material();
 
    if (drawvector == 1)
    {
-      glCallList(vectorlist);
+      DrawVectorField();
    }
 
    // ruler may have mixture of polygons and lines
@@ -1625,7 +1885,7 @@ void VisualizationSceneVector3d::Draw()
    // draw lines
    if (drawmesh)
    {
-      glCallList(linelist);
+      glCallList(proxy ? proxylinelist : linelist);
    }
 
    // draw displacement
@@ -1648,6 +1908,8 @@ void VisualizationSceneVector3d::Draw()
       DrawCoordinateCross();
    }
 
+   DrawStats();
+
    glFlush();
    auxSwapBuffers();
 }
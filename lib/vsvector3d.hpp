@@ -27,9 +27,36 @@ protected:
 
    void Init();
 
+   virtual void RebuildLayers();
+
    Array<int> vflevel;
    Array<double> dvflevel;
 
+   // Screen-space seeding of the vectors: the arrows are placed on the visible
+   // surfaces at the points of a jittered screen grid, see
+   // ToggleVectorSeeding(). Not used for the level vectors (drawvector == 4).
+   bool seed_vectors;
+   ScreenSeeds seeds;
+   // (x, y, z, vx, vy, vz, scalar value, arrow size) for each seed
+   Array<double> seed_vals;
+
+   bool Seeding() const
+   { return (seed_vectors && drawvector > 0 && drawvector != 4); }
+   // Must be called after drawing the surfaces: the seeds are found by reading
+   // back the depth buffer.
+   void SeedVectors();
+   void DrawSeededVectors();
+   void DrawVectorField()
+   {
+      if (Seeding()) { DrawSeededVectors(); }
+      else { glCallList(vectorlist); }
+   }
+
+   // Created by the first call to AddStreamlineSeeds()
+   Streamlines *streamlines;
+   void SetStreamlineColors();
+   void PrepareStreamlines();
+
 public:
    int ianim, ianimd, ianimmax, drawdisp;
 
@@ -48,11 +75,16 @@ public:
    void PrepareFlat2();
    void PrepareLines2();
 
+   // If 'size' is positive, it replaces the default size of the arrows.
    void DrawVector (int type, double v0, double v1, double v2,
-                    double sx, double sy, double sz, double s);
+                    double sx, double sy, double sz, double s,
+                    double size = 0.0);
+   // Compile the unit arrows used by DrawVector(); call before glNewList()
+   void PrepareArrowLists();
    virtual void PrepareVectorField();
    void PrepareDisplacedMesh();
    void ToggleVectorField(int i);
+   void ToggleVectorSeeding();
 
    void SetScalarFunction();
    void ToggleScalarFunction();
@@ -63,8 +95,16 @@ public:
 
    virtual void Draw();
 
+   virtual int Probe(const double *x, Vector &vals);
+
+   virtual void AddStreamlineSeeds(const Array<double> &s);
+   virtual void ClearStreamlines();
+
    virtual void EventUpdateColors()
-   { Prepare(); PrepareVectorField(); PrepareCuttingPlane(); };
+   {
+      Prepare(); PrepareVectorField(); PrepareCuttingPlane();
+      PrepareStreamlines();
+   };
 
    void ToggleVectorFieldLevel(int v);
    void AddVectorFieldLevel();
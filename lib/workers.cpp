@@ -0,0 +1,97 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+
+#include "workers.hpp"
+#include <vector>
+
+using namespace std;
+
+int WorkCounter::Next()
+{
+   pthread_mutex_lock(&mutex);
+   const int i = (next < size) ? next++ : -1;
+   pthread_mutex_unlock(&mutex);
+   return i;
+}
+
+struct ThreadStart
+{
+   void (*work)(void *arg, int id, int n);
+   void *arg;
+   int id;
+   // the number of threads, 0 until all of them have been created
+   int *n;
+   pthread_mutex_t *mutex;
+   pthread_cond_t *cond;
+};
+
+static void *StartThread(void *p)
+{
+   ThreadStart *s = (ThreadStart *)p;
+   pthread_mutex_lock(s->mutex);
+   while (*s->n == 0)
+   {
+      pthread_cond_wait(s->cond, s->mutex);
+   }
+   const int n = *s->n;
+   pthread_mutex_unlock(s->mutex);
+   s->work(s->arg, s->id, n);
+   return NULL;
+}
+
+int RunThreads(void (*work)(void *arg, int id, int n), void *arg,
+               int nthreads)
+{
+   if (nthreads <= 1)
+   {
+      work(arg, 0, 1);
+      return 1;
+   }
+
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&cond, NULL);
+   int n = 0;
+
+   vector<pthread_t> tid(nthreads);
+   vector<ThreadStart> start(nthreads);
+   int started = 1;
+   for ( ; started < nthreads; started++)
+   {
+      ThreadStart &s = start[started];
+      s.work = work;
+      s.arg = arg;
+      s.id = started;
+      s.n = &n;
+      s.mutex = &mutex;
+      s.cond = &cond;
+      if (pthread_create(&tid[started], NULL, StartThread, &s))
+      {
+         break;
+      }
+   }
+
+   pthread_mutex_lock(&mutex);
+   n = started;
+   pthread_cond_broadcast(&cond);
+   pthread_mutex_unlock(&mutex);
+
+   work(arg, 0, n);
+   for (int t = 1; t < n; t++)
+   {
+      pthread_join(tid[t], NULL);
+   }
+   pthread_cond_destroy(&cond);
+   pthread_mutex_destroy(&mutex);
+   return n;
+}
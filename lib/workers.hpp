@@ -0,0 +1,46 @@
+// Copyright (c) 2010, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-443271. All Rights
+// reserved. See file COPYRIGHT for details.
+//
+// This file is part of the GLVis visualization tool and library. For more
+// information and source code availability see http://glvis.org.
+//
+// GLVis is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License (as published by the Free
+// Software Foundation) version 2.1 dated February 1999.
+
+
+#ifndef GLVIS_WORKERS
+#define GLVIS_WORKERS
+
+#include <pthread.h>
+
+// Hands out the indices 0, 1, ..., size-1 to the threads of RunThreads, each
+// index to exactly one of them.
+class WorkCounter
+{
+private:
+   pthread_mutex_t mutex;
+   int next, size;
+
+public:
+   WorkCounter(int size_ = 0) : next(0), size(size_)
+   { pthread_mutex_init(&mutex, NULL); }
+   ~WorkCounter() { pthread_mutex_destroy(&mutex); }
+
+   // Start again from index 0; not to be called while the threads run.
+   void Reset(int size_) { next = 0; size = size_; }
+
+   // Returns the next index, or -1 when all of them have been handed out.
+   int Next();
+};
+
+// Calls 'work(arg, id, n)' for id = 0, ..., n-1, each on its own thread, and
+// waits for all of them to return; the calling thread runs id = 0. Up to
+// 'nthreads' threads are used: if a thread can not be created, the work is
+// shared by the ones that were, so 'n' may be smaller than 'nthreads'. None
+// of the calls starts before 'n' is known. Returns 'n'.
+int RunThreads(void (*work)(void *arg, int id, int n), void *arg,
+               int nthreads);
+
+#endif